@@ -0,0 +1,569 @@
+#include "lldk/base/allocator.h"
+#include "lldk/base/time.h"
+#include "lldk/common/error_code.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+using namespace lldk::base;
+
+/**
+ * @brief The allocator under test, malloc and the lldk allocators behind the same virtual calls
+ */
+class BenchAllocator
+{
+public:
+    virtual ~BenchAllocator() = default;
+    virtual const char *getName() const = 0;
+    virtual void *allocate(uint64_t uSize) = 0;
+    virtual void free(void *pMemory) = 0;
+    virtual void *reAllocate(void *pMemory, uint64_t uSize) = 0;
+};
+
+class MallocAllocator : public BenchAllocator
+{
+public:
+    const char *getName() const override
+    {
+        return "malloc";
+    }
+
+    void *allocate(uint64_t uSize) override
+    {
+        return ::malloc(uSize);
+    }
+
+    void free(void *pMemory) override
+    {
+        ::free(pMemory);
+    }
+
+    void *reAllocate(void *pMemory, uint64_t uSize) override
+    {
+        return ::realloc(pMemory, uSize);
+    }
+};
+
+class LldkAllocator : public BenchAllocator
+{
+public:
+    LldkAllocator(IAllocator *pAllocator) : m_pAllocator(pAllocator) {}
+
+    ~LldkAllocator() override
+    {
+        lldkDestroyAllocator(m_pAllocator);
+    }
+
+    const char *getName() const override
+    {
+        return "lldk";
+    }
+
+    void *allocate(uint64_t uSize) override
+    {
+        return m_pAllocator->allocate(uSize);
+    }
+
+    void free(void *pMemory) override
+    {
+        m_pAllocator->free(pMemory);
+    }
+
+    void *reAllocate(void *pMemory, uint64_t uSize) override
+    {
+        return m_pAllocator->reAllocate(pMemory, uSize);
+    }
+
+private:
+    IAllocator *m_pAllocator;
+};
+
+/**
+ * @brief The per thread output of a run, the latencies are in tsc ticks
+ */
+struct ThreadResult
+{
+    uint64_t uOps{0};
+    uint64_t uStartNs{0};
+    uint64_t uEndNs{0};
+    std::vector<uint32_t> vecTicks;
+
+    LLDK_INLINE void record(uint64_t uStartTsc)
+    {
+        uint64_t uTicks = lldkGetTsc() - uStartTsc;
+        vecTicks.push_back(uTicks < UINT32_MAX ? (uint32_t)uTicks : UINT32_MAX);
+        uOps++;
+    }
+};
+
+/**
+ * @brief The single producer single consumer ring between a producer and its consumer thread
+ */
+struct alignas(LLDK_CACHELINE_SIZE) BlockQueue
+{
+    static constexpr uint32_t kCapacity = 4096;
+
+    alignas(LLDK_CACHELINE_SIZE) std::atomic<uint64_t> uHead{0}; // Written by the consumer
+    alignas(LLDK_CACHELINE_SIZE) std::atomic<uint64_t> uTail{0}; // Written by the producer
+    void *arrBlocks[kCapacity];
+
+    void push(void *pBlock)
+    {
+        uint64_t uTail = this->uTail.load(std::memory_order_relaxed);
+        while (uTail - uHead.load(std::memory_order_acquire) >= kCapacity)
+        {
+            std::this_thread::yield();
+        }
+        arrBlocks[uTail % kCapacity] = pBlock;
+        this->uTail.store(uTail + 1, std::memory_order_release);
+    }
+
+    void *pop()
+    {
+        uint64_t uHead = this->uHead.load(std::memory_order_relaxed);
+        while (uHead == uTail.load(std::memory_order_acquire))
+        {
+            std::this_thread::yield();
+        }
+        void *pBlock = arrBlocks[uHead % kCapacity];
+        this->uHead.store(uHead + 1, std::memory_order_release);
+        return pBlock;
+    }
+};
+
+struct BenchContext
+{
+    BenchAllocator *pAllocator;
+    uint32_t uThreadIndex;
+    uint32_t uThreadCount;
+    uint64_t uOps;     // The timed allocator calls of the thread
+    BlockQueue *pQueues; // One per producer and consumer pair
+};
+
+static LLDK_INLINE uint64_t nextRandom(uint64_t &uState)
+{
+    uState ^= uState << 13;
+    uState ^= uState >> 7;
+    uState ^= uState << 17;
+    return uState;
+}
+
+static LLDK_INLINE uint64_t getSeed(uint32_t uThreadIndex)
+{
+    // fixed seeds, every run replays the same sizes
+    return 0x9E3779B97F4A7C15ULL * (uThreadIndex + 1);
+}
+
+static LLDK_INLINE void touch(void *pMemory, uint64_t uSize)
+{
+    if (likely(pMemory != nullptr && uSize > 0))
+    {
+        ((volatile uint8_t *)pMemory)[0] = 1;
+        ((volatile uint8_t *)pMemory)[uSize - 1] = 1;
+    }
+}
+
+// same thread churn: a ring of live blocks of small sizes, each step frees one and allocates one
+static void runChurn(const BenchContext &context, ThreadResult *pResult)
+{
+    static const uint64_t arrSizes[] = {16, 32, 48, 64, 96, 128, 256, 512};
+    static constexpr uint32_t kSlotCount = 256;
+    void *arrSlots[kSlotCount] = {};
+    uint64_t uState = getSeed(context.uThreadIndex);
+    auto pAllocator = context.pAllocator;
+
+    while (pResult->uOps < context.uOps)
+    {
+        uint64_t uRandom = nextRandom(uState);
+        auto &pSlot = arrSlots[uRandom % kSlotCount];
+        if (pSlot != nullptr)
+        {
+            uint64_t uStartTsc = lldkGetTsc();
+            pAllocator->free(pSlot);
+            pResult->record(uStartTsc);
+        }
+
+        uint64_t uSize = arrSizes[(uRandom >> 8) % (sizeof(arrSizes) / sizeof(arrSizes[0]))];
+        uint64_t uStartTsc = lldkGetTsc();
+        pSlot = pAllocator->allocate(uSize);
+        pResult->record(uStartTsc);
+        touch(pSlot, uSize);
+    }
+
+    for (auto pSlot : arrSlots)
+    {
+        pAllocator->free(pSlot);
+    }
+}
+
+// the even threads allocate and hand the blocks to the next odd thread, which frees them
+static void runProducerConsumer(const BenchContext &context, ThreadResult *pResult)
+{
+    static const uint64_t arrSizes[] = {64, 128, 256, 1024};
+    auto &queue = context.pQueues[context.uThreadIndex / 2];
+    auto pAllocator = context.pAllocator;
+    uint64_t uBlockCount = context.uOps;
+
+    if (context.uThreadIndex % 2 == 0)
+    {
+        uint64_t uState = getSeed(context.uThreadIndex);
+        for (uint64_t i = 0; i < uBlockCount; i++)
+        {
+            uint64_t uSize = arrSizes[nextRandom(uState) % (sizeof(arrSizes) / sizeof(arrSizes[0]))];
+            uint64_t uStartTsc = lldkGetTsc();
+            void *pBlock = pAllocator->allocate(uSize);
+            pResult->record(uStartTsc);
+            touch(pBlock, uSize);
+            queue.push(pBlock);
+        }
+        return;
+    }
+
+    for (uint64_t i = 0; i < uBlockCount; i++)
+    {
+        void *pBlock = queue.pop();
+        uint64_t uStartTsc = lldkGetTsc();
+        pAllocator->free(pBlock);
+        pResult->record(uStartTsc);
+    }
+}
+
+// bursts of mixed sizes, 90% up to 1KB, 9% up to 32KB and 1% up to 1MB, freed in a shuffled order
+static void runMixedBurst(const BenchContext &context, ThreadResult *pResult)
+{
+    static constexpr uint32_t kBurstCount = 128;
+    void *arrBlocks[kBurstCount];
+    uint64_t uState = getSeed(context.uThreadIndex);
+    auto pAllocator = context.pAllocator;
+
+    while (pResult->uOps < context.uOps)
+    {
+        for (uint32_t i = 0; i < kBurstCount; i++)
+        {
+            uint64_t uRandom = nextRandom(uState);
+            uint64_t uPercent = uRandom % 100;
+            uint64_t uMaxSize = uPercent < 90 ? 1024 : (uPercent < 99 ? 32 * 1024 : 1024 * 1024);
+            uint64_t uSize = (uRandom >> 16) % uMaxSize + 1;
+
+            uint64_t uStartTsc = lldkGetTsc();
+            arrBlocks[i] = pAllocator->allocate(uSize);
+            pResult->record(uStartTsc);
+            touch(arrBlocks[i], uSize);
+        }
+
+        for (uint32_t i = kBurstCount - 1; i > 0; i--)
+        {
+            std::swap(arrBlocks[i], arrBlocks[nextRandom(uState) % (i + 1)]);
+        }
+
+        for (auto pBlock : arrBlocks)
+        {
+            uint64_t uStartTsc = lldkGetTsc();
+            pAllocator->free(pBlock);
+            pResult->record(uStartTsc);
+        }
+    }
+}
+
+// a buffer grown by 1.5x from 16 bytes to 256KB, the way a message or a log line buffer grows
+static void runReallocGrowth(const BenchContext &context, ThreadResult *pResult)
+{
+    static constexpr uint64_t kMaxSize = 256 * 1024;
+    auto pAllocator = context.pAllocator;
+
+    while (pResult->uOps < context.uOps)
+    {
+        uint64_t uSize = 16;
+        uint64_t uStartTsc = lldkGetTsc();
+        void *pBuffer = pAllocator->allocate(uSize);
+        pResult->record(uStartTsc);
+        touch(pBuffer, uSize);
+
+        while (uSize < kMaxSize)
+        {
+            uSize = uSize * 3 / 2 + 16;
+            uStartTsc = lldkGetTsc();
+            pBuffer = pAllocator->reAllocate(pBuffer, uSize);
+            pResult->record(uStartTsc);
+            touch(pBuffer, uSize);
+        }
+
+        uStartTsc = lldkGetTsc();
+        pAllocator->free(pBuffer);
+        pResult->record(uStartTsc);
+    }
+}
+
+struct Scenario
+{
+    const char *pName;
+    void (*pRun)(const BenchContext &context, ThreadResult *pResult);
+    bool bPaired; // The threads work in producer and consumer pairs, the thread count is even
+};
+
+static const Scenario s_arrScenarios[] = {
+    {"churn", runChurn, false},
+    {"producer_consumer", runProducerConsumer, true},
+    {"mixed_burst", runMixedBurst, false},
+    {"realloc_growth", runReallocGrowth, false},
+};
+
+struct Options
+{
+    std::vector<uint32_t> vecThreadCounts;
+    uint64_t uOps{1000000};
+    uint64_t uBudgetMB{0};
+    std::vector<std::string> vecScenarios;
+    std::vector<std::string> vecAllocators;
+    bool bCsv{false};
+};
+
+static double calibrateTicksPerNs()
+{
+    uint64_t uStartNs = lldkGetClockMonotonicNs();
+    uint64_t uStartTsc = lldkGetTsc();
+    usleep(50 * 1000);
+    uint64_t uEndTsc = lldkGetTsc();
+    uint64_t uEndNs = lldkGetClockMonotonicNs();
+    return (double)(uEndTsc - uStartTsc) / (double)(uEndNs - uStartNs);
+}
+
+static std::unique_ptr<BenchAllocator> createAllocator(const std::string &sName, const Options &options)
+{
+    if (sName == "malloc")
+    {
+        return std::unique_ptr<BenchAllocator>(new MallocAllocator());
+    }
+
+    if (sName == "lldk")
+    {
+        // a fresh allocator per run, the page heap of the previous run does not warm this one
+        static uint32_t s_uRun = 0;
+        std::string sAllocatorName = "bench.allocator." + std::to_string(s_uRun++);
+        IAllocator::Config config {options.uBudgetMB, 0, 0};
+        auto pAllocator = lldkCreateAllocatorWithConfig(sAllocatorName.c_str(), &config);
+        if (pAllocator == nullptr)
+        {
+            fprintf(stderr, "create allocator failed, error %d\n", (int)lldkGetErrorCode());
+            return nullptr;
+        }
+        return std::unique_ptr<BenchAllocator>(new LldkAllocator(pAllocator));
+    }
+
+    fprintf(stderr, "unknown allocator %s\n", sName.c_str());
+    return nullptr;
+}
+
+static void runOnce(const Scenario &scenario, BenchAllocator *pAllocator, uint32_t uThreadCount,
+                    const Options &options, double dTicksPerNs)
+{
+    std::vector<ThreadResult> vecResults(uThreadCount);
+    std::unique_ptr<BlockQueue[]> pQueues(new BlockQueue[(uThreadCount + 1) / 2]);
+    std::atomic<uint32_t> uReadyCount {0};
+    std::atomic<bool> bStart {false};
+
+    std::vector<std::thread> vecThreads;
+    for (uint32_t i = 0; i < uThreadCount; i++)
+    {
+        vecThreads.emplace_back([&, i]() {
+            BenchContext context {pAllocator, i, uThreadCount, options.uOps, pQueues.get()};
+            auto &result = vecResults[i];
+            result.vecTicks.reserve(options.uOps + 1024);
+
+            uReadyCount.fetch_add(1, std::memory_order_release);
+            while (!bStart.load(std::memory_order_acquire))
+            {
+            }
+
+            result.uStartNs = lldkGetClockMonotonicNs();
+            scenario.pRun(context, &result);
+            result.uEndNs = lldkGetClockMonotonicNs();
+        });
+    }
+
+    while (uReadyCount.load(std::memory_order_acquire) < uThreadCount)
+    {
+        std::this_thread::yield();
+    }
+    bStart.store(true, std::memory_order_release);
+    for (auto &thread : vecThreads)
+    {
+        thread.join();
+    }
+
+    uint64_t uStartNs = UINT64_MAX;
+    uint64_t uEndNs = 0;
+    uint64_t uTotalOps = 0;
+    std::vector<uint32_t> vecTicks;
+    for (auto &result : vecResults)
+    {
+        uStartNs = std::min(uStartNs, result.uStartNs);
+        uEndNs = std::max(uEndNs, result.uEndNs);
+        uTotalOps += result.uOps;
+        vecTicks.insert(vecTicks.end(), result.vecTicks.begin(), result.vecTicks.end());
+        std::vector<uint32_t>().swap(result.vecTicks);
+    }
+    std::sort(vecTicks.begin(), vecTicks.end());
+
+    auto getPercentile = [&vecTicks, dTicksPerNs](double dPercent) {
+        if (vecTicks.empty())
+        {
+            return 0.0;
+        }
+        size_t uIndex = (size_t)(dPercent / 100.0 * (double)(vecTicks.size() - 1));
+        return (double)vecTicks[uIndex] / dTicksPerNs;
+    };
+
+    double dOpsPerSec = uEndNs > uStartNs ? (double)uTotalOps * 1e9 / (double)(uEndNs - uStartNs) : 0.0;
+    const char *pFormat = options.bCsv ? "%s,%s,%u,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f\n"
+                                       : "%-18s %-8s %7u %14.0f %8.0f %8.0f %8.0f %8.0f %10.0f\n";
+    printf(pFormat, scenario.pName, pAllocator->getName(), uThreadCount, dOpsPerSec, getPercentile(50),
+           getPercentile(90), getPercentile(99), getPercentile(99.9), getPercentile(100));
+    fflush(stdout);
+}
+
+static std::vector<std::string> splitList(const char *pList)
+{
+    std::vector<std::string> vecItems;
+    std::string sItem;
+    for (const char *p = pList; ; p++)
+    {
+        if (*p == ',' || *p == '\0')
+        {
+            if (!sItem.empty())
+            {
+                vecItems.push_back(sItem);
+            }
+            sItem.clear();
+            if (*p == '\0')
+            {
+                break;
+            }
+            continue;
+        }
+        sItem.push_back(*p);
+    }
+    return vecItems;
+}
+
+static void printUsage(const char *pProgram)
+{
+    printf("Usage: %s [options]\n"
+           "  --threads LIST     thread counts, default 1,2,4,... up to the cpu count\n"
+           "  --ops N            timed allocator calls per thread, default 1000000\n"
+           "  --scenario LIST    churn,producer_consumer,mixed_burst,realloc_growth, default all\n"
+           "  --allocator LIST   malloc,lldk, default both\n"
+           "  --budget-mb N      create the lldk allocator with a budget of N MB, default 0\n"
+           "  --csv              print comma separated values\n"
+           "The latencies are in nanoseconds, measured per allocator call.\n",
+           pProgram);
+}
+
+static bool parseOptions(int argc, char **argv, Options *pOptions)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string sArg = argv[i];
+        bool bHasValue = i + 1 < argc;
+        if (sArg == "--threads" && bHasValue)
+        {
+            for (auto &sCount : splitList(argv[++i]))
+            {
+                pOptions->vecThreadCounts.push_back((uint32_t)strtoul(sCount.c_str(), nullptr, 10));
+            }
+        }
+        else if (sArg == "--ops" && bHasValue)
+        {
+            pOptions->uOps = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (sArg == "--scenario" && bHasValue)
+        {
+            pOptions->vecScenarios = splitList(argv[++i]);
+        }
+        else if (sArg == "--allocator" && bHasValue)
+        {
+            pOptions->vecAllocators = splitList(argv[++i]);
+        }
+        else if (sArg == "--budget-mb" && bHasValue)
+        {
+            pOptions->uBudgetMB = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (sArg == "--csv")
+        {
+            pOptions->bCsv = true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (pOptions->vecThreadCounts.empty())
+    {
+        uint32_t uCpuCount = std::max(1u, std::thread::hardware_concurrency());
+        for (uint32_t uCount = 1; uCount < uCpuCount; uCount *= 2)
+        {
+            pOptions->vecThreadCounts.push_back(uCount);
+        }
+        pOptions->vecThreadCounts.push_back(uCpuCount);
+    }
+    if (pOptions->vecAllocators.empty())
+    {
+        pOptions->vecAllocators = {"malloc", "lldk"};
+    }
+    return pOptions->uOps > 0 &&
+           std::find(pOptions->vecThreadCounts.begin(), pOptions->vecThreadCounts.end(), 0u) == pOptions->vecThreadCounts.end();
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, &options))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    double dTicksPerNs = calibrateTicksPerNs();
+    if (options.bCsv)
+    {
+        printf("scenario,allocator,threads,ops_per_sec,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n");
+    }
+    else
+    {
+        printf("%-18s %-8s %7s %14s %8s %8s %8s %8s %10s\n", "scenario", "alloc", "threads", "ops/s", "p50", "p90",
+               "p99", "p99.9", "max");
+    }
+
+    for (auto &scenario : s_arrScenarios)
+    {
+        if (!options.vecScenarios.empty() &&
+            std::find(options.vecScenarios.begin(), options.vecScenarios.end(), scenario.pName) == options.vecScenarios.end())
+        {
+            continue;
+        }
+
+        for (auto uThreadCount : options.vecThreadCounts)
+        {
+            // a pair needs two threads, an odd count gets one more
+            uint32_t uRunThreadCount = scenario.bPaired ? std::max(2u, (uThreadCount + 1) / 2 * 2) : uThreadCount;
+            for (auto &sAllocator : options.vecAllocators)
+            {
+                auto pAllocator = createAllocator(sAllocator, options);
+                if (pAllocator == nullptr)
+                {
+                    return 1;
+                }
+                runOnce(scenario, pAllocator.get(), uRunThreadCount, options, dTicksPerNs);
+            }
+        }
+    }
+    return 0;
+}
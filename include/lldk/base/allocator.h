@@ -2,6 +2,7 @@
 #define LLDK_MEMORY_ALLOCATOR_H
 
 #include "lldk/common/common.h"
+#include <type_traits>
 
 namespace lldk
 {
@@ -23,6 +24,61 @@ public:
         uint64_t uFreedCount;     // The total count of the freed memory
     };
 
+    enum ConfigFlag : uint32_t
+    {
+        kConfigPrefault = 1 << 0, // Pre-fault the reserved memory when the allocator is created
+        kConfigLock = 1 << 1,     // Lock the reserved memory in RAM with mlock
+        kConfigHugePage = 1 << 2, // Back the memory with 2MB pages, MAP_HUGETLB first then madvise(MADV_HUGEPAGE)
+        kConfigHistogram = 1 << 3, // Keep the size and lifetime histograms of getAllocateHistogram
+    };
+
+    enum NumaNode : int32_t
+    {
+        kNumaNodeAny = -1,   // No binding, the pages come from the node of the first toucher
+        kNumaNodeLocal = -2, // Every page comes from the node of the thread touching it first, MPOL_LOCAL
+    };
+
+    enum : uint64_t
+    {
+        kDefaultAlignment = 16,  // The alignment of the memory returned by allocate
+        kMaxAlignment = 1 << 16, // The maximum alignment of allocateAligned
+    };
+
+    enum : uint32_t
+    {
+        kHistogramBucketCount = 64,
+    };
+
+    struct AllocateHistogram
+    {
+        // the bucket i counts the values in [2^(i-1), 2^i), the bucket 0 counts the value 0
+        uint64_t arrSizeCounts[kHistogramBucketCount];     // The requested bytes sizes
+        uint64_t arrLifetimeCounts[kHistogramBucketCount]; // The lldkGetTsc ticks from allocate to free
+    };
+
+    enum ProfileFormat : uint32_t
+    {
+        kProfilePprof = 0,     // The legacy text heap profile of gperftools, read by pprof
+        kProfileCollapsed = 1, // The collapsed stacks of flamegraph.pl, one "frame;frame weight" line per stack
+    };
+
+    struct MemoryStats
+    {
+        uint64_t uReservedSize;        // The bytes size reserved up front for the budget
+        uint64_t uMappedSize;          // The bytes size mapped for the allocated memory
+        uint64_t uHugeTlbSize;         // The bytes size of the mapped memory backed by MAP_HUGETLB pages
+        uint64_t uTransparentHugeSize; // The bytes size of the mapped memory backed by transparent huge pages
+        uint64_t uScavengedSize;       // The bytes size of the free pages of the mapped memory returned to the OS
+        uint64_t uTotalScavengedSize;  // The bytes size returned to the OS by the scavenger since creation
+    };
+
+    struct Config
+    {
+        uint64_t uMaxSizeMB; // The maximum size, in MB, reserved up front and never exceeded, 0 means no limit
+        uint32_t uFlags;     // The ConfigFlag bits, kConfigPrefault and kConfigLock need uMaxSizeMB
+        uint32_t uScavengeIdleMs; // The free pages idle longer are returned to the OS in the background, 0 means never
+    };
+
     /**
      * @brief Allocate memory
      * @param uSize The size of the memory to allocate
@@ -36,14 +92,76 @@ public:
      */
     virtual void free(void *pMemory) = 0;
 
+    /**
+     * @brief Allocate memory aligned to a boundary
+     * @param uSize The size of the memory to allocate
+     * @param uAlign The alignment, a power of 2 not greater than 64KB
+     * @return The pointer to the allocated memory, NULL if failed
+     * @note allocate is already aligned to 16 bytes. free the memory with free(pMemory), or with the
+     *       sized free when uAlign is not greater than 16.
+     */
+    virtual void *allocateAligned(uint64_t uSize, uint64_t uAlign) = 0;
+
+    /**
+     * @brief Free memory of a known size
+     * @param pMemory The pointer to the memory to free
+     * @param uSize The size passed to allocate when the memory was allocated
+     * @note the size is a hint for the allocators keeping no metadata of a block, AllocatorImpl reads
+     *       the size class from the span of the block as free(pMemory) does.
+     */
+    virtual void free(void *pMemory, uint64_t uSize) = 0;
+
+    /**
+     * @brief Allocate many blocks of the same size
+     * @param uSize The size of every block
+     * @param uCount The count of the blocks
+     * @param ppMemory The pointers to the allocated blocks, uCount slots, output parameter
+     * @return The count of the blocks allocated, less than uCount if failed
+     * @note the blocks are taken from the thread cache batch by batch with one stats update, the
+     *       allocated blocks are kept on a partial failure, ppMemory[0, return) must be freed.
+     */
+    virtual uint64_t allocateBatch(uint64_t uSize, uint64_t uCount, void **ppMemory) = 0;
+
+    /**
+     * @brief Free many blocks
+     * @param ppMemory The pointers to the blocks, of any sizes
+     * @param uCount The count of the blocks
+     */
+    virtual void freeBatch(void **ppMemory, uint64_t uCount) = 0;
+
     /**
      * @brief Reallocate memory
      * @param pMemory The pointer to the memory to reallocate
      * @param uSize The size of the memory to reallocate
      * @return The pointer to the reallocated memory, NULL if failed
+     * @note the block stays in place while it fits its size class, a large block grows into the free
+     *       pages next to it, and a huge block is grown with mremap. only the rest is copied.
      */
     virtual void *reAllocate(void *pMemory, uint64_t uSize) = 0;
 
+    /**
+     * @brief Get the usable size of an allocated block
+     * @param pMemory The pointer to the allocated memory
+     * @return The bytes the caller may use from pMemory on, at least the size allocated, 0 if the
+     *         memory is not a block of the allocator
+     * @note the size of the slot or of the pages of the block, less the bytes the allocator keeps in
+     *       the block for itself, e.g. the allocation time of the histogram.
+     */
+    virtual uint64_t getUsableSize(void *pMemory) const = 0;
+
+    /**
+     * @brief Warm up the allocator for the allocations of a size before going live
+     * @param uSize The size of the allocations
+     * @param uCount The count of the allocations to warm up
+     * @return 0 if success, -1 if failed
+     * @note call it at startup on the thread that allocates on the hot path, the next uCount
+     *       allocations of uSize then neither fault a page nor take a lock. a small size fills the
+     *       thread cache, which grows to keep the objects. a large size keeps enough empty chunks
+     *       mapped and faulted in. a huge block has its own mapping and fails with kInvalidParam.
+     *       with a scavenger the reserved pages idle longer than uScavengeIdleMs are returned again.
+     */
+    virtual int32_t reserve(uint64_t uSize, uint64_t uCount) = 0;
+
     /**
      * @brief Get the name of the allocator
      * @return The name of the allocator
@@ -55,9 +173,46 @@ public:
      * @param pAllocateStats The allocate stats of the allocator, output parameter
      * @param pThreadCount The count of the threads, output parameter
      * @return The allocate stats of the allocator, NULL if failed
+     * @note the threads which have exited are summed in one entry with the uTid 0
      */
     virtual int32_t getAllocateStats(IAllocator::AllocateStats *pAllocateStats, uint32_t *pThreadCount) const = 0;
 
+    /**
+     * @brief Get the memory stats of the allocator
+     * @param pMemoryStats The memory stats of the allocator, output parameter
+     * @return 0 if success, -1 if failed
+     * @note uTransparentHugeSize is read from /proc/self/smaps, do not call it on the hot path.
+     */
+    virtual int32_t getMemoryStats(IAllocator::MemoryStats *pMemoryStats) const = 0;
+
+    /**
+     * @brief Get the allocate histogram of the allocator, merged across the threads
+     * @param pHistogram The allocate histogram of the allocator, output parameter
+     * @return 0 if success, -1 if failed
+     * @note the allocator must be created with kConfigHistogram, otherwise it fails with kInvalidState.
+     *       a small block then keeps its allocation time in the last 8 bytes of its slot.
+     */
+    virtual int32_t getAllocateHistogram(IAllocator::AllocateHistogram *pHistogram) const = 0;
+
+    /**
+     * @brief Set the sample interval of the heap profiler
+     * @param uSampleInterval The mean allocated bytes between two sampled stack traces, 0 to stop
+     * @return 0 if success, -1 if failed
+     * @note the sampled points are geometric distributed, so an allocation is sampled with the
+     *       probability 1 - exp(-size / interval). changing the interval drops the samples taken.
+     */
+    virtual int32_t setSampleInterval(uint64_t uSampleInterval) = 0;
+
+    /**
+     * @brief Dump the sampled stack traces of the allocations
+     * @param pFileName The file name to write
+     * @param eFormat The format of the file
+     * @return 0 if success, -1 if failed
+     * @note the frees of sampled objects are not tracked, the profile shows where the bytes were
+     *       allocated, e.g. pprof -sample_index=alloc_space, not what is still in use.
+     */
+    virtual int32_t dumpHeapProfile(const char *pFileName, IAllocator::ProfileFormat eFormat) const = 0;
+
     /**
      * @brief Create a new object
      * @tparam T The type of the object
@@ -68,7 +223,7 @@ public:
     template <typename T, typename... Args>
     T *newObject(Args&&... args)
     {
-        void *pMemory = allocate(sizeof(T));
+        void *pMemory = alignof(T) > kDefaultAlignment ? allocateAligned(sizeof(T), alignof(T)) : allocate(sizeof(T));
         if (pMemory == NULL)
         {
             return NULL;
@@ -92,12 +247,20 @@ public:
      * @brief Delete an object
      * @tparam T The type of the object
      * @param pObject The pointer to the object
+     * @note a type with a virtual destructor may be a base of the object, sizeof(T) is not its size
      */
     template <typename T>
     void deleteObject(T *pObject)
     {
         pObject->~T();
-        free(pObject);
+        if (alignof(T) > kDefaultAlignment || std::has_virtual_destructor<T>::value)
+        {
+            free(pObject);
+        }
+        else
+        {
+            free(pObject, sizeof(T));
+        }
     }
 };
 
@@ -116,6 +279,30 @@ extern "C" {
  */
 LLDK_EXPORT lldk::base::IAllocator *lldkCreateAllocator(const char *pName, uint64_t uMaxSizeMB);
 
+/**
+ * @brief Create a allocator with the config
+ * @param pName The name of the allocator
+ * @param pConfig The config of the allocator
+ * @return The allocator pointer, NULL if failed
+ * @note when uMaxSizeMB is not 0, the whole budget is reserved with mmap on creation and every
+ *       allocation is served from it, an allocation past the budget fails with kNoMemory.
+ *       uScavengeIdleMs starts a scavenger thread, it can not be combined with kConfigPrefault or
+ *       kConfigLock, whose memory is meant to stay resident.
+ */
+LLDK_EXPORT lldk::base::IAllocator *lldkCreateAllocatorWithConfig(const char *pName, const lldk::base::IAllocator::Config *pConfig);
+
+/**
+ * @brief Create a allocator with the memory bound to a NUMA node
+ * @param pName The name of the allocator
+ * @param pConfig The config of the allocator
+ * @param iNumaNode The node id, or kNumaNodeAny, or kNumaNodeLocal
+ * @return The allocator pointer, NULL if failed
+ * @note the binding is skipped on a single node host or when the kernel refuses it, an unknown node
+ *       fails with kInvalidParam. kNumaNodeLocal overrides an inherited policy such as interleave,
+ *       a pre-faulted budget is faulted in by the creating thread and so lands on its node.
+ */
+LLDK_EXPORT lldk::base::IAllocator *lldkCreateNumaAllocator(const char *pName, const lldk::base::IAllocator::Config *pConfig, int32_t iNumaNode);
+
 /**
  * @brief Destroy a allocator
  * @param pAllocator The allocator pointer
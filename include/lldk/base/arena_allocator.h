@@ -0,0 +1,74 @@
+#ifndef LLDK_BASE_ARENA_ALLOCATOR_H
+#define LLDK_BASE_ARENA_ALLOCATOR_H
+
+#include "lldk/base/allocator.h"
+
+namespace lldk
+{
+namespace base
+{
+
+/**
+ * @brief An allocator bumping a pointer inside large blocks, the memory is released all at once
+ * @note free is a no-op, the memory is given back by reset or rewind. the blocks are kept for reuse
+ *       until the allocator is destroyed. the arena allocator is not thread safe.
+ */
+class IArenaAllocator : public IAllocator
+{
+protected:
+    virtual ~IArenaAllocator() = default;
+
+public:
+    struct Marker
+    {
+        void *pBlock;          // The current block when the marker was taken
+        uint64_t uOffset;      // The used bytes of the block
+        uint64_t uLiveSize;    // The allocated bytes not yet released
+        uint64_t uLiveCount;   // The allocated count not yet released
+    };
+
+    /**
+     * @brief Release all the memory allocated
+     */
+    virtual void reset() = 0;
+
+    /**
+     * @brief Get a marker of the current position
+     * @return The marker
+     */
+    virtual Marker getMarker() const = 0;
+
+    /**
+     * @brief Release the memory allocated after the marker was taken
+     * @param marker The marker got from getMarker, not invalidated by an earlier rewind or reset
+     */
+    virtual void rewind(const Marker &marker) = 0;
+};
+
+}
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Create an arena allocator
+ * @param pName The name of the arena allocator
+ * @param pAllocator The allocator to get blocks from, NULL means the allocator singleton
+ * @param uBlockSize The bytes size of a block, a larger allocation gets a block of its own
+ * @return The arena allocator pointer, NULL if failed
+ */
+LLDK_EXPORT lldk::base::IArenaAllocator *lldkCreateArenaAllocator(const char *pName, lldk::base::IAllocator *pAllocator, uint64_t uBlockSize);
+
+/**
+ * @brief Destroy an arena allocator
+ * @param pArenaAllocator The arena allocator pointer
+ */
+LLDK_EXPORT void lldkDestroyArenaAllocator(lldk::base::IArenaAllocator *pArenaAllocator);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LLDK_BASE_ARENA_ALLOCATOR_H
@@ -0,0 +1,202 @@
+#ifndef LLDK_BASE_OBJECT_POOL_H
+#define LLDK_BASE_OBJECT_POOL_H
+
+#include "lldk/common/common.h"
+#include "lldk/common/error_code.h"
+#include "lldk/base/allocator.h"
+#include <utility>
+
+namespace lldk
+{
+namespace base
+{
+
+/**
+ * @brief A pool of objects of one type
+ * @tparam T The type of the objects
+ * @note the slots are carved from chunks got from an IAllocator and recycled through an intrusive
+ *       free list, so newObject and deleteObject cost no virtual call once the pool is warm. the pool
+ *       is not thread safe, and the chunks are only given back when the pool is destroyed.
+ */
+template <typename T>
+class LldkObjectPool
+{
+public:
+    /**
+     * @brief Construct the pool
+     * @param pAllocator The allocator to get chunks from, NULL means the allocator singleton
+     * @param uChunkObjectCount The object count of a chunk
+     * @param uMaxObjectCount The maximum object count of the pool, 0 means no limit
+     */
+    explicit LldkObjectPool(IAllocator *pAllocator = nullptr, uint32_t uChunkObjectCount = 64, uint64_t uMaxObjectCount = 0)
+        : m_pAllocator(pAllocator != nullptr ? pAllocator : lldkGetAllocatorSingleton())
+        , m_uChunkObjectCount(uChunkObjectCount > 0 ? uChunkObjectCount : 1)
+        , m_uMaxObjectCount(uMaxObjectCount)
+    {
+    }
+
+    /**
+     * @brief Destroy the pool
+     * @note the objects still alive are not destructed, their memory is released with the chunks
+     */
+    ~LldkObjectPool()
+    {
+        while (m_pChunks != nullptr)
+        {
+            auto pNext = m_pChunks->pNext;
+            m_pAllocator->free(m_pChunks);
+            m_pChunks = pNext;
+        }
+    }
+
+    LldkObjectPool(const LldkObjectPool &) = delete;
+    LldkObjectPool &operator=(const LldkObjectPool &) = delete;
+
+    /**
+     * @brief Allocate the memory of an object
+     * @return The pointer to the memory, NULL if failed
+     */
+    LLDK_INLINE void *allocate()
+    {
+        void *pMemory = m_pFreeList;
+        if (likely(pMemory != nullptr))
+        {
+            m_pFreeList = *(void **)pMemory;
+        }
+        else if (likely(m_pCursor < m_pEnd))
+        {
+            pMemory = m_pCursor;
+            m_pCursor += kSlotSize;
+        }
+        else if (unlikely((pMemory = grow()) == nullptr))
+        {
+            return nullptr;
+        }
+
+        m_uUsedCount++;
+        return pMemory;
+    }
+
+    /**
+     * @brief Free the memory of an object
+     * @param pMemory The pointer to the memory, got from allocate of this pool
+     */
+    LLDK_INLINE void free(void *pMemory)
+    {
+        *(void **)pMemory = m_pFreeList;
+        m_pFreeList = pMemory;
+        m_uUsedCount--;
+    }
+
+    /**
+     * @brief Create a new object
+     * @tparam Args The types of the arguments
+     * @param args The arguments
+     * @return The pointer to the new object, NULL if failed
+     */
+    template <typename... Args>
+    T *newObject(Args&&... args)
+    {
+        void *pMemory = allocate();
+        if (pMemory == NULL)
+        {
+            return NULL;
+        }
+
+        try
+        {
+            T *pObject = new(pMemory) T(std::forward<Args&&>(args)...);
+            return pObject;
+        }
+        catch (...)
+        {
+            free(pMemory);
+            throw;
+        }
+
+        return NULL;
+    }
+
+    /**
+     * @brief Delete an object
+     * @param pObject The pointer to the object, created by newObject of this pool
+     */
+    void deleteObject(T *pObject)
+    {
+        pObject->~T();
+        free(pObject);
+    }
+
+    /**
+     * @brief Get the count of the objects in use
+     * @return The object count
+     */
+    uint64_t getUsedCount() const
+    {
+        return m_uUsedCount;
+    }
+
+    /**
+     * @brief Get the count of the slots carved from the chunks
+     * @return The slot count
+     */
+    uint64_t getCapacity() const
+    {
+        return m_uCapacity;
+    }
+
+private:
+    struct Chunk
+    {
+        Chunk *pNext;
+    };
+
+    static constexpr uint64_t kSlotAlignment = alignof(T) > sizeof(void *) ? alignof(T) : sizeof(void *);
+    static constexpr uint64_t kSlotSize = LLDK_ALIGN_BASE(sizeof(T) > sizeof(void *) ? sizeof(T) : sizeof(void *), kSlotAlignment);
+    static constexpr uint64_t kChunkHeaderSize = LLDK_ALIGN_BASE(sizeof(Chunk), kSlotAlignment);
+
+    void *grow()
+    {
+        uint64_t uSlotCount = m_uChunkObjectCount;
+        if (m_uMaxObjectCount > 0 && m_uCapacity + uSlotCount > m_uMaxObjectCount)
+        {
+            uSlotCount = m_uMaxObjectCount - m_uCapacity;
+            if (uSlotCount == 0)
+            {
+                lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+                return nullptr;
+            }
+        }
+
+        auto pChunk = (Chunk *)m_pAllocator->allocateAligned(kChunkHeaderSize + uSlotCount * kSlotSize, kSlotAlignment);
+        if (unlikely(pChunk == nullptr))
+        {
+            return nullptr;
+        }
+
+        pChunk->pNext = m_pChunks;
+        m_pChunks = pChunk;
+        m_uCapacity += uSlotCount;
+
+        uint8_t *pMemory = (uint8_t *)pChunk + kChunkHeaderSize;
+        m_pCursor = pMemory + kSlotSize;
+        m_pEnd = pMemory + uSlotCount * kSlotSize;
+        return pMemory;
+    }
+
+private:
+    void *m_pFreeList{nullptr}; // The freed slots linked by their first word
+    uint8_t *m_pCursor{nullptr}; // The next never used slot of the newest chunk
+    uint8_t *m_pEnd{nullptr};
+    uint64_t m_uUsedCount{0};
+    uint64_t m_uCapacity{0};
+    Chunk *m_pChunks{nullptr};
+    IAllocator *m_pAllocator;
+    uint32_t m_uChunkObjectCount;
+    uint64_t m_uMaxObjectCount;
+};
+
+}
+}
+
+#endif // LLDK_BASE_OBJECT_POOL_H
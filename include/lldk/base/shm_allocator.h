@@ -0,0 +1,99 @@
+#ifndef LLDK_BASE_SHM_ALLOCATOR_H
+#define LLDK_BASE_SHM_ALLOCATOR_H
+
+#include "lldk/base/allocator.h"
+
+namespace lldk
+{
+namespace base
+{
+
+/**
+ * @brief An allocator over a named shared memory region, attached by several processes at once
+ * @note the metadata and the free lists live inside the region and link each other by offsets, so
+ *       a block allocated by one process is read in place by another one at a different address.
+ *       pass offsets, not pointers, between the processes. the allocator is thread and process safe,
+ *       every call takes a robust process shared lock. the spans of the small sizes are kept by their
+ *       size class once carved, the pages of the large blocks go back to the region on free.
+ */
+class IShmAllocator : public IAllocator
+{
+protected:
+    virtual ~IShmAllocator() = default;
+
+public:
+    enum : uint64_t
+    {
+        kNullOffset = 0, // The offset of no block, the region header is at offset 0
+    };
+
+    /**
+     * @brief Get the offset of a block in the region
+     * @param pMemory The pointer to the block in the mapping of this process
+     * @return The offset, kNullOffset if the pointer is not in the region
+     */
+    virtual uint64_t toOffset(const void *pMemory) const = 0;
+
+    /**
+     * @brief Get the pointer of an offset in the mapping of this process
+     * @param uOffset The offset got from toOffset in any process
+     * @return The pointer, NULL if the offset is not in the region
+     */
+    virtual void *fromOffset(uint64_t uOffset) const = 0;
+
+    /**
+     * @brief Set the root offset, the well known entry an attaching process starts from
+     * @param uOffset The offset, kNullOffset to clear it
+     */
+    virtual void setRootOffset(uint64_t uOffset) = 0;
+
+    /**
+     * @brief Get the root offset
+     * @return The offset, kNullOffset if not set
+     */
+    virtual uint64_t getRootOffset() const = 0;
+};
+
+}
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Create a shared memory region and an allocator over it
+ * @param pName The name of the region, a leading '/' is added for shm_open if missing
+ * @param uSizeMB The size of the region, in MB
+ * @return The shared memory allocator pointer, NULL if failed
+ * @note the creation fails with kInvalidParam if the region exists, attach to it instead. the
+ *       region outlives the processes until lldkUnlinkShmAllocator.
+ */
+LLDK_EXPORT lldk::base::IShmAllocator *lldkCreateShmAllocator(const char *pName, uint64_t uSizeMB);
+
+/**
+ * @brief Attach an allocator to an existing shared memory region
+ * @param pName The name of the region
+ * @return The shared memory allocator pointer, NULL if failed
+ * @note a region still being created fails with kInvalidState, try again later.
+ */
+LLDK_EXPORT lldk::base::IShmAllocator *lldkAttachShmAllocator(const char *pName);
+
+/**
+ * @brief Detach a shared memory allocator, the region and its blocks are kept
+ * @param pShmAllocator The shared memory allocator pointer
+ */
+LLDK_EXPORT void lldkDestroyShmAllocator(lldk::base::IShmAllocator *pShmAllocator);
+
+/**
+ * @brief Remove the name of a shared memory region, the memory is released after the last detach
+ * @param pName The name of the region
+ * @return 0 if success, -1 if failed
+ */
+LLDK_EXPORT int32_t lldkUnlinkShmAllocator(const char *pName);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LLDK_BASE_SHM_ALLOCATOR_H
@@ -0,0 +1,127 @@
+#ifndef LLDK_BASE_STL_ALLOCATOR_H
+#define LLDK_BASE_STL_ALLOCATOR_H
+
+#include "lldk/common/common.h"
+#include "lldk/base/allocator.h"
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+namespace lldk
+{
+namespace base
+{
+
+/**
+ * @brief The allocator of the standard containers, forwarding to an IAllocator
+ * @tparam T The type of the elements
+ * @note a node of a list, map or unordered_map is one element, it maps to a size class of the
+ *       allocator and is given back with the sized free.
+ *       the copies and rebinds share the IAllocator, which must outlive the containers.
+ */
+template <typename T>
+class LldkStlAllocator
+{
+public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = LldkStlAllocator<U>;
+    };
+
+    /**
+     * @brief Construct the allocator on the allocator singleton
+     */
+    LldkStlAllocator() noexcept : m_pAllocator(lldkGetAllocatorSingleton()) {}
+
+    /**
+     * @brief Construct the allocator
+     * @param pAllocator The allocator to forward to, NULL means the allocator singleton
+     */
+    explicit LldkStlAllocator(IAllocator *pAllocator) noexcept
+        : m_pAllocator(pAllocator != nullptr ? pAllocator : lldkGetAllocatorSingleton())
+    {
+    }
+
+    template <typename U>
+    LldkStlAllocator(const LldkStlAllocator<U> &other) noexcept : m_pAllocator(other.getAllocator())
+    {
+    }
+
+    /**
+     * @brief Allocate the memory of elements
+     * @param uCount The element count
+     * @return The pointer to the memory
+     * @throw std::bad_alloc if failed
+     */
+    T *allocate(size_type uCount)
+    {
+        if (unlikely(uCount > max_size() || m_pAllocator == nullptr))
+        {
+            throw std::bad_alloc();
+        }
+
+        void *pMemory = alignof(T) > IAllocator::kDefaultAlignment
+                            ? m_pAllocator->allocateAligned(uCount * sizeof(T), alignof(T))
+                            : m_pAllocator->allocate(uCount * sizeof(T));
+        if (unlikely(pMemory == nullptr))
+        {
+            throw std::bad_alloc();
+        }
+        return static_cast<T *>(pMemory);
+    }
+
+    /**
+     * @brief Deallocate the memory of elements
+     * @param pMemory The pointer to the memory
+     * @param uCount The element count passed to allocate
+     */
+    void deallocate(T *pMemory, size_type uCount) noexcept
+    {
+        if (alignof(T) > IAllocator::kDefaultAlignment)
+        {
+            m_pAllocator->free(pMemory);
+        }
+        else
+        {
+            m_pAllocator->free(pMemory, uCount * sizeof(T));
+        }
+    }
+
+    size_type max_size() const noexcept
+    {
+        return (size_type)-1 / sizeof(T);
+    }
+
+    IAllocator *getAllocator() const noexcept
+    {
+        return m_pAllocator;
+    }
+
+private:
+    IAllocator *m_pAllocator;
+};
+
+template <typename T, typename U>
+bool operator==(const LldkStlAllocator<T> &lhs, const LldkStlAllocator<U> &rhs) noexcept
+{
+    return lhs.getAllocator() == rhs.getAllocator();
+}
+
+template <typename T, typename U>
+bool operator!=(const LldkStlAllocator<T> &lhs, const LldkStlAllocator<U> &rhs) noexcept
+{
+    return lhs.getAllocator() != rhs.getAllocator();
+}
+
+}
+}
+
+#endif // LLDK_BASE_STL_ALLOCATOR_H
@@ -117,6 +117,25 @@ LLDK_INLINE uint64_t lldkGetClockMonotonicNs()
     return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
 }
 
+/**
+ * @brief Get the time stamp counter of the cpu
+ * @return The counter ticks, the clock monotonic nanoseconds where the cpu has no counter
+ */
+LLDK_INLINE uint64_t lldkGetTsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    uint32_t uLow, uHigh;
+    __asm__ __volatile__("rdtsc" : "=a"(uLow), "=d"(uHigh));
+    return ((uint64_t)uHigh << 32) | uLow;
+#elif defined(__aarch64__)
+    uint64_t uTicks;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(uTicks));
+    return uTicks;
+#else
+    return lldkGetClockMonotonicNs();
+#endif
+}
+
 /**
  * @brief Get the clock monotonic microseconds
  * @return The clock monotonic microseconds
@@ -1,61 +1,299 @@
 #include "allocator_impl.h"
 #include "lldk/base/allocator.h"
+#include <atomic>
 #include <cstdint>
 #include <memory>
 #include <unordered_map>
 #include "lldk/common/common.h"
 #include "lldk/common/error_code.h"
+#include "lldk/base/time.h"
 
 namespace lldk
 {
 namespace base
 {
 
-AllocatorImpl::AllocatorImpl(const char *pName) : m_sName(pName) {}
+AllocatorImpl::AllocatorImpl(const char *pName)
+    : m_sName(pName),
+      m_allocatorThreadLocal(CreateThreadCacheFunc{this}, DeleteThreadCacheFunc{this}, RetireThreadCacheFunc{this})
+{
+}
+
+AllocatorImpl::~AllocatorImpl()
+{
+    // release the caches of the running threads to the free list while the central free lists live
+    {
+        AllocatorThreadLocal allocatorThreadLocal(std::move(m_allocatorThreadLocal));
+    }
+
+    while (m_pFreeThreadCaches != nullptr)
+    {
+        auto pThreadCache = m_pFreeThreadCaches;
+        m_pFreeThreadCaches = pThreadCache->getNextFree();
+        delete pThreadCache;
+    }
+}
 
-AllocatorImpl::~AllocatorImpl() = default;
+static LLDK_INLINE uint32_t getHistogramBucket(uint64_t uValue)
+{
+    uint32_t uBucket = uValue == 0 ? 0 : (uint32_t)(64 - __builtin_clzll(uValue));
+    return uBucket < IAllocator::kHistogramBucketCount ? uBucket : IAllocator::kHistogramBucketCount - 1;
+}
 
 void *AllocatorImpl::allocate(uint64_t uSize)
 {
-    auto pData = malloc(uSize + sizeof(uint64_t));
-    if (unlikely(pData == nullptr))
+    if (unlikely(uSize > kMaxAllocateSize))
     {
         lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
         return nullptr;
     }
 
-    *((uint64_t *)pData) = uSize;
-    pData = (void *)((uint8_t *)pData + sizeof(uint64_t));
+    // with the histogram a small block gets room for its allocation time in its slot, a size that
+    // leaves no room in the largest slot becomes a large block, which keeps the time in its span
+    uint64_t uBlockSize = uSize + m_uTrailerSize;
+    return allocate(uSize, uSize <= kMaxSmallSize ? uBlockSize : uSize);
+}
 
-    auto pAllocateStats = m_allocatorThreadLocal.get();
-    if (likely(pAllocateStats != nullptr))
+void *AllocatorImpl::allocate(uint64_t uSize, uint64_t uBlockSize)
+{
+    auto pThreadCache = m_allocatorThreadLocal.get();
+    void *pData = nullptr;
+    uint64_t uAllocatedSize = uBlockSize;
+    if (likely(uBlockSize <= kMaxSmallSize))
+    {
+        uint32_t uSizeClass = SizeClass::getSizeClass(uBlockSize);
+        pData = likely(pThreadCache != nullptr) ? pThreadCache->allocate(uSizeClass, m_arrCentralFreeLists)
+                                                : m_arrCentralFreeLists[uSizeClass].allocate();
+        uAllocatedSize = SizeClass::getClassSize(uSizeClass);
+    }
+    else
+    {
+        pData = m_pageHeap.allocateLarge(uBlockSize);
+    }
+
+    if (unlikely(pData == nullptr))
     {
-        pAllocateStats->uAllocatedSize += uSize;
-        pAllocateStats->uAllocatedCount++;
+        lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+        return nullptr;
+    }
+
+    if (likely(pThreadCache != nullptr))
+    {
+        auto &allocateStats = pThreadCache->getStats();
+        allocateStats.uAllocatedSize += uAllocatedSize;
+        allocateStats.uAllocatedCount++;
+
+        if (unlikely(m_uTrailerSize != 0))
+        {
+            pThreadCache->getHistogram().arrSizeCounts[getHistogramBucket(uSize)]++;
+            if (uBlockSize <= kMaxSmallSize)
+            {
+                *(uint64_t *)((uint8_t *)pData + uAllocatedSize - m_uTrailerSize) = lldkGetTsc();
+            }
+            else
+            {
+                PageHeap::getSpan(pData)->uAllocateTsc = lldkGetTsc();
+            }
+        }
+
+        uint64_t uSampleInterval = m_heapProfiler.getSampleInterval();
+        if (unlikely(uSampleInterval != 0) && pThreadCache->sample(uSize, uSampleInterval))
+        {
+            m_heapProfiler.record(uSize);
+        }
     }
 
     return pData;
 }
 
+void AllocatorImpl::recordLifetime(ThreadCache *pThreadCache, uint64_t uAllocateTsc)
+{
+    uint64_t uNowTsc = lldkGetTsc();
+    uint64_t uLifetime = uNowTsc > uAllocateTsc ? uNowTsc - uAllocateTsc : 0;
+    pThreadCache->getHistogram().arrLifetimeCounts[getHistogramBucket(uLifetime)]++;
+}
+
 void AllocatorImpl::free(void *pMemory)
 {
-    if (unlikely(pMemory == nullptr))
+    if (unlikely(pMemory == nullptr || !m_pageHeap.owns(pMemory)))
     {
         lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
         return;
     }
 
-    void *pOriginalMemory = (void *)((uint8_t *)pMemory - sizeof(uint64_t));
-    uint64_t uSize = *((uint64_t *)pOriginalMemory);
+    auto pThreadCache = m_allocatorThreadLocal.get();
+    auto pSpan = PageHeap::getSpan(pMemory);
+    uint64_t uSize = 0;
+    if (likely(pSpan->uSizeClass < kSizeClassCount))
+    {
+        uSize = pSpan->uObjectSize;
+        if (likely(pThreadCache != nullptr))
+        {
+            if (unlikely(m_uTrailerSize != 0))
+            {
+                recordLifetime(pThreadCache, *(uint64_t *)((uint8_t *)pMemory + uSize - m_uTrailerSize));
+            }
+            pThreadCache->free(pMemory, pSpan, m_arrCentralFreeLists);
+        }
+        else
+        {
+            m_arrCentralFreeLists[pSpan->uSizeClass].free(pMemory, pSpan);
+        }
+    }
+    else
+    {
+        uSize = pSpan->uLargeSize;
+        if (unlikely(m_uTrailerSize != 0 && pThreadCache != nullptr))
+        {
+            recordLifetime(pThreadCache, pSpan->uAllocateTsc);
+        }
+        m_pageHeap.freeLarge(pSpan);
+    }
 
-    auto pAllocateStats = m_allocatorThreadLocal.get();
-    if (likely(pAllocateStats != nullptr))
+    if (likely(pThreadCache != nullptr))
     {
-        pAllocateStats->uFreedSize += uSize;
-        pAllocateStats->uFreedCount++;
+        auto &allocateStats = pThreadCache->getStats();
+        allocateStats.uFreedSize += uSize;
+        allocateStats.uFreedCount++;
     }
+}
 
-    ::free(pOriginalMemory);
+void *AllocatorImpl::allocateAligned(uint64_t uSize, uint64_t uAlign)
+{
+    if (unlikely(uAlign == 0 || (uAlign & (uAlign - 1)) != 0 || uAlign > kMaxAlignment))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return nullptr;
+    }
+
+    if (uAlign <= kDefaultAlignment)
+    {
+        return allocate(uSize);
+    }
+
+    if (unlikely(uSize > kMaxAllocateSize))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+        return nullptr;
+    }
+
+    // spans start on a page boundary, so a size class that is a multiple of the alignment keeps
+    // every object aligned, and the large and huge blocks are always page aligned
+    uint64_t uBlockSize = LLDK_ALIGN_BASE((uSize > 0 ? uSize : 1) + m_uTrailerSize, uAlign);
+    if (uBlockSize <= kMaxSmallSize)
+    {
+        uint32_t uSizeClass = SizeClass::getSizeClass(uBlockSize);
+        while (SizeClass::getClassSize(uSizeClass) % uAlign != 0)
+        {
+            uSizeClass++;
+        }
+        uBlockSize = SizeClass::getClassSize(uSizeClass);
+    }
+
+    return allocate(uSize, uBlockSize);
+}
+
+void AllocatorImpl::free(void *pMemory, uint64_t uSize)
+{
+    // the span is looked up all the same, it tells a foreign pointer apart and routes the object of a
+    // span owned by another thread to its remote free list, and it knows the size class already
+    unused(uSize);
+    free(pMemory);
+}
+
+uint64_t AllocatorImpl::allocateBatch(uint64_t uSize, uint64_t uCount, void **ppMemory)
+{
+    if (unlikely(ppMemory == nullptr && uCount > 0))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return 0;
+    }
+
+    // the large blocks and the allocation time of the histogram are handled one by one
+    auto pThreadCache = m_allocatorThreadLocal.get();
+    if (unlikely(uSize > kMaxSmallSize || m_uTrailerSize != 0 || pThreadCache == nullptr))
+    {
+        for (uint64_t i = 0; i < uCount; i++)
+        {
+            if (unlikely((ppMemory[i] = allocate(uSize)) == nullptr))
+            {
+                return i;
+            }
+        }
+        return uCount;
+    }
+
+    uint32_t uSizeClass = SizeClass::getSizeClass(uSize);
+    uint64_t uAllocated = pThreadCache->allocateBatch(uSizeClass, uCount, ppMemory, m_arrCentralFreeLists);
+    if (unlikely(uAllocated < uCount))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+    }
+
+    auto &allocateStats = pThreadCache->getStats();
+    allocateStats.uAllocatedSize += uAllocated * SizeClass::getClassSize(uSizeClass);
+    allocateStats.uAllocatedCount += uAllocated;
+
+    uint64_t uSampleInterval = m_heapProfiler.getSampleInterval();
+    if (unlikely(uSampleInterval != 0))
+    {
+        for (uint64_t i = 0; i < uAllocated; i++)
+        {
+            if (pThreadCache->sample(uSize, uSampleInterval))
+            {
+                m_heapProfiler.record(uSize);
+            }
+        }
+    }
+    return uAllocated;
+}
+
+void AllocatorImpl::freeBatch(void **ppMemory, uint64_t uCount)
+{
+    if (unlikely(ppMemory == nullptr && uCount > 0))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return;
+    }
+
+    auto pThreadCache = m_allocatorThreadLocal.get();
+    if (unlikely(m_uTrailerSize != 0 || pThreadCache == nullptr))
+    {
+        for (uint64_t i = 0; i < uCount; i++)
+        {
+            free(ppMemory[i]);
+        }
+        return;
+    }
+
+    uint64_t uFreedSize = 0;
+    uint64_t uFreedCount = 0;
+    for (uint64_t i = 0; i < uCount; i++)
+    {
+        void *pMemory = ppMemory[i];
+        if (unlikely(pMemory == nullptr || !m_pageHeap.owns(pMemory)))
+        {
+            lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+            continue;
+        }
+
+        auto pSpan = PageHeap::getSpan(pMemory);
+        if (likely(pSpan->uSizeClass < kSizeClassCount))
+        {
+            uFreedSize += pSpan->uObjectSize;
+            pThreadCache->free(pMemory, pSpan, m_arrCentralFreeLists);
+        }
+        else
+        {
+            uFreedSize += pSpan->uLargeSize;
+            m_pageHeap.freeLarge(pSpan);
+        }
+        uFreedCount++;
+    }
+
+    auto &allocateStats = pThreadCache->getStats();
+    allocateStats.uFreedSize += uFreedSize;
+    allocateStats.uFreedCount += uFreedCount;
 }
 
 void *AllocatorImpl::reAllocate(void *pMemory, uint64_t uSize)
@@ -65,29 +303,113 @@ void *AllocatorImpl::reAllocate(void *pMemory, uint64_t uSize)
         return allocate(uSize);
     }
 
-    void *pOriginalMemory = (void *)((uint8_t *)pMemory - sizeof(uint64_t));
-    uint64_t uOldSize = *((uint64_t *)pOriginalMemory);
+    if (unlikely(!m_pageHeap.owns(pMemory)))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return nullptr;
+    }
 
-    void *pNewMemory = realloc(pOriginalMemory, uSize + sizeof(uint64_t));
-    if (unlikely(pNewMemory == nullptr))
+    if (unlikely(uSize > kMaxAllocateSize))
     {
         lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
         return nullptr;
     }
 
-    *((uint64_t *)pNewMemory) = uSize;
-    void *pResult = (void *)((uint8_t *)pNewMemory + sizeof(uint64_t));
+    auto pSpan = PageHeap::getSpan(pMemory);
+    uint64_t uBlockSize = uSize + m_uTrailerSize;
+    uint64_t uOldSize = 0;
+    if (likely(pSpan->uSizeClass < kSizeClassCount))
+    {
+        // the slot of the size class is kept while the block fills at least half of it, the
+        // allocation time of the histogram stays in the last bytes of the slot
+        if (uBlockSize <= pSpan->uObjectSize && uBlockSize * 2 >= pSpan->uObjectSize)
+        {
+            return pMemory;
+        }
+        uOldSize = pSpan->uObjectSize - m_uTrailerSize;
+    }
+    else
+    {
+        uOldSize = pSpan->uLargeSize;
+        void *pResizedMemory = uBlockSize > kMaxSmallSize ? m_pageHeap.reAllocateLarge(pSpan, uSize) : nullptr;
+        if (pResizedMemory != nullptr)
+        {
+            // the block keeps its count, only the size difference is accounted
+            auto pThreadCache = m_allocatorThreadLocal.get();
+            if (likely(pThreadCache != nullptr))
+            {
+                auto &allocateStats = pThreadCache->getStats();
+                if (uSize > uOldSize)
+                {
+                    allocateStats.uAllocatedSize += uSize - uOldSize;
+                }
+                else
+                {
+                    allocateStats.uFreedSize += uOldSize - uSize;
+                }
+            }
+            return pResizedMemory;
+        }
+    }
+
+    void *pNewMemory = allocate(uSize);
+    if (unlikely(pNewMemory == nullptr))
+    {
+        return nullptr;
+    }
+
+    memcpy(pNewMemory, pMemory, uOldSize < uSize ? uOldSize : uSize);
+    free(pMemory);
+    return pNewMemory;
+}
+
+uint64_t AllocatorImpl::getUsableSize(void *pMemory) const
+{
+    if (unlikely(pMemory == nullptr || !m_pageHeap.owns(pMemory)))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return 0;
+    }
+
+    // the allocation time of the histogram is kept in the last bytes of a small slot
+    auto pSpan = PageHeap::getSpan(pMemory);
+    return pSpan->uSizeClass < kSizeClassCount ? pSpan->uObjectSize - m_uTrailerSize : pSpan->uLargeSize;
+}
+
+int32_t AllocatorImpl::reserve(uint64_t uSize, uint64_t uCount)
+{
+    if (unlikely(uSize > kMaxAllocateSize))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return -1;
+    }
+
+    uint64_t uBlockSize = uSize + m_uTrailerSize;
+    if (uBlockSize > kMaxSmallSize)
+    {
+        return m_pageHeap.reserve(uSize, uCount);
+    }
+
+    if (unlikely(uCount > UINT32_MAX / 2))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return -1;
+    }
 
-    auto pAllocateStats = m_allocatorThreadLocal.get();
-    if (likely(pAllocateStats != nullptr))
+    auto pThreadCache = m_allocatorThreadLocal.get();
+    if (unlikely(pThreadCache == nullptr))
     {
-        pAllocateStats->uFreedSize += uOldSize;
-        pAllocateStats->uFreedCount++;
-        pAllocateStats->uAllocatedSize += uSize;
-        pAllocateStats->uAllocatedCount++;
+        lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+        return -1;
     }
 
-    return pResult;
+    uint32_t uSizeClass = SizeClass::getSizeClass(uBlockSize);
+    if (unlikely(pThreadCache->reserve(uSizeClass, (uint32_t)uCount, m_arrCentralFreeLists) < uCount))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+        return -1;
+    }
+    return 0;
 }
 
 const char *AllocatorImpl::getName() const
@@ -95,30 +417,73 @@ const char *AllocatorImpl::getName() const
     return m_sName.c_str();
 }
 
-int32_t AllocatorImpl::init(uint64_t uMaxSizeMB)
+int32_t AllocatorImpl::init(const IAllocator::Config *pConfig, int32_t iNumaNode)
 {
-    m_uMaxSizeMB = uMaxSizeMB;
-    return 0;
+    m_config = *pConfig;
+    m_uTrailerSize = (m_config.uFlags & IAllocator::kConfigHistogram) != 0 ? sizeof(uint64_t) : 0;
+    if (unlikely(m_pageHeap.init(&m_config, iNumaNode) != 0))
+    {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < kSizeClassCount; i++)
+    {
+        m_arrCentralFreeLists[i].init(i, &m_pageHeap);
+    }
+    return m_pageHeap.startScavenger(m_config.uScavengeIdleMs);
 }
 
-AllocatorImpl::AllocateStats *AllocatorImpl::createAllocateStats()
+ThreadCache *AllocatorImpl::createThreadCache()
 {
-    auto pStats = new AllocateStats();
-    if (unlikely(pStats == nullptr))
+    // a cache left by an exited thread keeps the spans it owns in use
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto pThreadCache = m_pFreeThreadCaches;
+        if (pThreadCache != nullptr)
+        {
+            m_pFreeThreadCaches = pThreadCache->getNextFree();
+            pThreadCache->setNextFree(nullptr);
+            pThreadCache->reset();
+            return pThreadCache;
+        }
+    }
+
+    auto pThreadCache = LLDK_NEW ThreadCache();
+    if (unlikely(pThreadCache == nullptr))
     {
         lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
         return nullptr;
     }
-    memset(pStats, 0, sizeof(AllocateStats));
-    pStats->uTid = lldkGetTid();
-    return pStats;
+    return pThreadCache;
+}
+
+void AllocatorImpl::deleteThreadCache(ThreadCache *pThreadCache)
+{
+    if (unlikely(pThreadCache == nullptr))
+    {
+        return;
+    }
+
+    // the spans keep pointing to the cache, so it is kept for the next thread rather than deleted
+    pThreadCache->retire(m_arrCentralFreeLists);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    pThreadCache->setNextFree(m_pFreeThreadCaches);
+    m_pFreeThreadCaches = pThreadCache;
 }
 
-void AllocatorImpl::deleteAllocateStats(AllocateStats *pAllocateStats)
+void AllocatorImpl::retireThreadCache(ThreadCache *pThreadCache)
 {
-    if (likely(pAllocateStats != nullptr))
+    auto &stats = pThreadCache->getStats();
+    auto &histogram = pThreadCache->getHistogram();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_retiredStats.uAllocatedSize += stats.uAllocatedSize;
+    m_retiredStats.uAllocatedCount += stats.uAllocatedCount;
+    m_retiredStats.uFreedSize += stats.uFreedSize;
+    m_retiredStats.uFreedCount += stats.uFreedCount;
+    for (uint32_t i = 0; i < kHistogramBucketCount; i++)
     {
-        delete pAllocateStats;
+        m_retiredHistogram.arrSizeCounts[i] += histogram.arrSizeCounts[i];
+        m_retiredHistogram.arrLifetimeCounts[i] += histogram.arrLifetimeCounts[i];
     }
 }
 
@@ -132,19 +497,74 @@ int32_t AllocatorImpl::getAllocateStats(IAllocator::AllocateStats *pAllocateStat
 
     uint32_t uThreadCount = 0;
     uint32_t uThreadMaxSize = *pThreadCount;
-    auto func = [&uThreadCount, uThreadMaxSize, pAllocateStats](AllocateStats *pStats) {
+    m_allocatorThreadLocal.combineEach([&uThreadCount, uThreadMaxSize, pAllocateStats](const ThreadCache &threadCache) {
         if (likely(uThreadCount < uThreadMaxSize))
         {
-            pAllocateStats[uThreadCount++] = *pStats;
+            pAllocateStats[uThreadCount++] = threadCache.getStats();
         }
-        return 0;
-    };
+    });
 
-    m_allocatorThreadLocal.foreach(func);
+    // the exited threads are summed in one entry with the tid 0
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if ((m_retiredStats.uAllocatedCount != 0 || m_retiredStats.uFreedCount != 0) && uThreadCount < uThreadMaxSize)
+    {
+        pAllocateStats[uThreadCount++] = m_retiredStats;
+    }
     *pThreadCount = uThreadCount;
     return 0;
 }
 
+int32_t AllocatorImpl::getAllocateHistogram(IAllocator::AllocateHistogram *pHistogram) const
+{
+    if (unlikely(pHistogram == nullptr))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return -1;
+    }
+
+    if (unlikely(m_uTrailerSize == 0))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidState);
+        return -1;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        *pHistogram = m_retiredHistogram;
+    }
+    m_allocatorThreadLocal.combineEach([pHistogram](const ThreadCache &threadCache) {
+        auto &histogram = threadCache.getHistogram();
+        for (uint32_t i = 0; i < kHistogramBucketCount; i++)
+        {
+            pHistogram->arrSizeCounts[i] += histogram.arrSizeCounts[i];
+            pHistogram->arrLifetimeCounts[i] += histogram.arrLifetimeCounts[i];
+        }
+    });
+    return 0;
+}
+
+int32_t AllocatorImpl::setSampleInterval(uint64_t uSampleInterval)
+{
+    return m_heapProfiler.setSampleInterval(uSampleInterval);
+}
+
+int32_t AllocatorImpl::dumpHeapProfile(const char *pFileName, IAllocator::ProfileFormat eFormat) const
+{
+    return m_heapProfiler.dump(pFileName, eFormat);
+}
+
+int32_t AllocatorImpl::getMemoryStats(IAllocator::MemoryStats *pMemoryStats) const
+{
+    if (unlikely(pMemoryStats == nullptr))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return -1;
+    }
+
+    m_pageHeap.getMemoryStats(pMemoryStats);
+    return 0;
+}
+
 }
 }
 
@@ -164,11 +584,45 @@ static void deleteAllocatorImpl(lldk::base::AllocatorImpl *pAllocator)
 using AllocatorUniqueptr = std::unique_ptr<lldk::base::AllocatorImpl, decltype(&deleteAllocatorImpl)>;
 static std::mutex s_mutex;
 static std::unordered_map<std::string, AllocatorUniqueptr> s_pAllocatorMap;
-static lldk::base::AllocatorImpl::AllocateStats s_allocateStats {0, 0, 0, 0, 0};
+
+// the stats of __lldkAllocate are sharded by thread, a shard per cacheline, and summed on query
+struct alignas(LLDK_CACHELINE_SIZE) AllocateStatsShard
+{
+    std::atomic<uint64_t> uAllocatedSize;
+    std::atomic<uint64_t> uAllocatedCount;
+    std::atomic<uint64_t> uFreedSize;
+    std::atomic<uint64_t> uFreedCount;
+};
+
+static constexpr uint32_t kAllocateStatsShardCount = 64;
+static AllocateStatsShard s_arrAllocateStatsShards[kAllocateStatsShardCount];
+static std::atomic<uint32_t> s_uNextAllocateStatsShard {0};
+static thread_local AllocateStatsShard *s_pAllocateStatsShard = nullptr;
+
+static AllocateStatsShard *getAllocateStatsShard()
+{
+    if (unlikely(s_pAllocateStatsShard == nullptr))
+    {
+        uint32_t uIndex = s_uNextAllocateStatsShard.fetch_add(1, std::memory_order_relaxed);
+        s_pAllocateStatsShard = &s_arrAllocateStatsShards[uIndex % kAllocateStatsShardCount];
+    }
+    return s_pAllocateStatsShard;
+}
 
 lldk::base::IAllocator *lldkCreateAllocator(const char *pName, uint64_t uMaxSizeMB)
 {
-    if (unlikely(pName == nullptr))
+    lldk::base::IAllocator::Config config {uMaxSizeMB, 0, 0};
+    return lldkCreateAllocatorWithConfig(pName, &config);
+}
+
+lldk::base::IAllocator *lldkCreateAllocatorWithConfig(const char *pName, const lldk::base::IAllocator::Config *pConfig)
+{
+    return lldkCreateNumaAllocator(pName, pConfig, lldk::base::IAllocator::kNumaNodeAny);
+}
+
+lldk::base::IAllocator *lldkCreateNumaAllocator(const char *pName, const lldk::base::IAllocator::Config *pConfig, int32_t iNumaNode)
+{
+    if (unlikely(pName == nullptr || pConfig == nullptr))
     {
         lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
         return nullptr;
@@ -195,9 +649,8 @@ lldk::base::IAllocator *lldkCreateAllocator(const char *pName, uint64_t uMaxSize
             return nullptr;
         }
 
-        if (unlikely(pAllocator->init(uMaxSizeMB) != 0))
+        if (unlikely(pAllocator->init(pConfig, iNumaNode) != 0))
         {
-            lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
             return nullptr;
         }
 
@@ -224,12 +677,22 @@ void lldkDestroyAllocator(lldk::base::IAllocator *pAllocator)
     auto pAllocatorImpl = dynamic_cast<lldk::base::AllocatorImpl *>(pAllocator);
     if (likely(pAllocatorImpl != nullptr))
     {
-        std::lock_guard<std::mutex> lock(s_mutex);
-        auto pName = pAllocatorImpl->getName();
-        auto iter = s_pAllocatorMap.find(pName);
-        if (likely(iter != s_pAllocatorMap.end() && pAllocatorImpl == iter->second.get()))
+        // the allocator is destroyed out of the lock, its destructor frees through __lldkFree
+        AllocatorUniqueptr allocatorUniqueptr(nullptr, deleteAllocatorImpl);
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            auto pName = pAllocatorImpl->getName();
+            auto iter = s_pAllocatorMap.find(pName);
+            if (likely(iter != s_pAllocatorMap.end() && pAllocatorImpl == iter->second.get()))
+            {
+                allocatorUniqueptr = std::move(iter->second);
+                s_pAllocatorMap.erase(iter);
+            }
+        }
+
+        if (likely(allocatorUniqueptr != nullptr))
         {
-            s_pAllocatorMap.erase(iter);
+            return;
         }
     }
 
@@ -259,7 +722,8 @@ lldk::base::IAllocator *lldkGetAllocatorSingleton()
             return nullptr;
         }
 
-        if (unlikely(s_pAllocator->init(0) != 0))
+        lldk::base::IAllocator::Config config {0, 0, 0};
+        if (unlikely(s_pAllocator->init(&config, lldk::base::IAllocator::kNumaNodeAny) != 0))
         {
             delete s_pAllocator;
             lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
@@ -285,9 +749,9 @@ LLDK_EXPORT void *__lldkAllocate(uint64_t uSize)
     *((uint64_t *)pData) = uSize;
     pData = (void *)((uint8_t *)pData + sizeof(uint64_t));
 
-    std::lock_guard<std::mutex> lock(s_mutex);
-    s_allocateStats.uAllocatedSize += uSize;
-    s_allocateStats.uAllocatedCount++;
+    auto pShard = getAllocateStatsShard();
+    pShard->uAllocatedSize.fetch_add(uSize, std::memory_order_relaxed);
+    pShard->uAllocatedCount.fetch_add(1, std::memory_order_relaxed);
 
     return pData;
 }
@@ -303,11 +767,9 @@ LLDK_EXPORT void __lldkFree(void *pMemory)
     void *pOriginalMemory = (void *)((uint8_t *)pMemory - sizeof(uint64_t));
     uint64_t uSize = *((uint64_t *)pOriginalMemory);
 
-    {
-        std::lock_guard<std::mutex> lock(s_mutex);
-        s_allocateStats.uFreedSize += uSize;
-        s_allocateStats.uFreedCount++;
-    }
+    auto pShard = getAllocateStatsShard();
+    pShard->uFreedSize.fetch_add(uSize, std::memory_order_relaxed);
+    pShard->uFreedCount.fetch_add(1, std::memory_order_relaxed);
 
     ::free(pOriginalMemory);
 }
@@ -320,8 +782,14 @@ LLDK_EXPORT int32_t __lldkGetAllocateStats(lldk::base::IAllocator::AllocateStats
         return -1;
     }
 
-    std::lock_guard<std::mutex> lock(s_mutex);
-    *pAllocateStats = s_allocateStats;
+    memset(pAllocateStats, 0, sizeof(*pAllocateStats));
+    for (auto &shard : s_arrAllocateStatsShards)
+    {
+        pAllocateStats->uAllocatedSize += shard.uAllocatedSize.load(std::memory_order_relaxed);
+        pAllocateStats->uAllocatedCount += shard.uAllocatedCount.load(std::memory_order_relaxed);
+        pAllocateStats->uFreedSize += shard.uFreedSize.load(std::memory_order_relaxed);
+        pAllocateStats->uFreedCount += shard.uFreedCount.load(std::memory_order_relaxed);
+    }
     return 0;
 }
 #ifdef __cplusplus
@@ -5,6 +5,10 @@
 #include <mutex>
 #include <string>
 #include "../utilities/lldk_thread_local.h"
+#include "central_free_list.h"
+#include "heap_profiler.h"
+#include "page_heap.h"
+#include "thread_cache.h"
 
 namespace lldk
 {
@@ -19,40 +23,76 @@ public:
 
     void *allocate(uint64_t uSize) override;
     void free(void *pMemory) override;
+    void *allocateAligned(uint64_t uSize, uint64_t uAlign) override;
+    void free(void *pMemory, uint64_t uSize) override;
+    uint64_t allocateBatch(uint64_t uSize, uint64_t uCount, void **ppMemory) override;
+    void freeBatch(void **ppMemory, uint64_t uCount) override;
     void *reAllocate(void *pMemory, uint64_t uSize) override;
+    uint64_t getUsableSize(void *pMemory) const override;
+    int32_t reserve(uint64_t uSize, uint64_t uCount) override;
     const char *getName() const override;
     int32_t getAllocateStats(IAllocator::AllocateStats *pAllocateStats, uint32_t *pThreadCount) const override;
+    int32_t getMemoryStats(IAllocator::MemoryStats *pMemoryStats) const override;
+    int32_t getAllocateHistogram(IAllocator::AllocateHistogram *pHistogram) const override;
+    int32_t setSampleInterval(uint64_t uSampleInterval) override;
+    int32_t dumpHeapProfile(const char *pFileName, IAllocator::ProfileFormat eFormat) const override;
 
-    int32_t init(uint64_t uMaxSizeMB);
+    int32_t init(const IAllocator::Config *pConfig, int32_t iNumaNode);
 
 private:
-    static AllocateStats *createAllocateStats();
-    static void deleteAllocateStats(AllocateStats *pAllocateStats);
-    
-    // 函数对象类型，用于 LldkThreadLocal 模板
-    struct CreateAllocateStatsFunc
+    void *allocate(uint64_t uSize, uint64_t uBlockSize);
+    void recordLifetime(ThreadCache *pThreadCache, uint64_t uAllocateTsc);
+
+    ThreadCache *createThreadCache();
+    void deleteThreadCache(ThreadCache *pThreadCache);
+    void retireThreadCache(ThreadCache *pThreadCache);
+
+    // 函数对象类型，用于 LldkThreadLocal 模板，线程第一次分配时创建该线程的 ThreadCache
+    struct CreateThreadCacheFunc
+    {
+        AllocatorImpl *pAllocator;
+
+        ThreadCache *operator()() const
+        {
+            return pAllocator->createThreadCache();
+        }
+    };
+
+    struct DeleteThreadCacheFunc
     {
-        AllocateStats *operator()() const
+        AllocatorImpl *pAllocator;
+
+        void operator()(ThreadCache *pThreadCache) const
         {
-            return AllocatorImpl::createAllocateStats();
+            pAllocator->deleteThreadCache(pThreadCache);
         }
     };
-    
-    struct DeleteAllocateStatsFunc
+
+    // 线程退出时把该线程的统计合并到已退出线程的汇总中
+    struct RetireThreadCacheFunc
     {
-        void operator()(AllocateStats *pStats) const
+        AllocatorImpl *pAllocator;
+
+        void operator()(ThreadCache *pThreadCache) const
         {
-            AllocatorImpl::deleteAllocateStats(pStats);
+            pAllocator->retireThreadCache(pThreadCache);
         }
     };
-    
-    using AllocatorThreadLocal = utilities::LldkThreadLocal<AllocateStats>;
+
+    using AllocatorThreadLocal = utilities::LldkThreadLocal<ThreadCache, CreateThreadCacheFunc, DeleteThreadCacheFunc, RetireThreadCacheFunc>;
 
 private:
     std::string m_sName;
-    uint64_t m_uMaxSizeMB{0};
-    mutable std::mutex m_mutex;
+    IAllocator::Config m_config{0, 0, 0};
+    uint64_t m_uTrailerSize{0}; // The bytes at the end of a small slot keeping its allocation time
+    mutable std::mutex m_mutex; // The lock of the free thread caches and the stats of the exited threads
+    ThreadCache *m_pFreeThreadCaches{nullptr};
+    IAllocator::AllocateStats m_retiredStats{0, 0, 0, 0, 0};
+    IAllocator::AllocateHistogram m_retiredHistogram{};
     AllocatorThreadLocal m_allocatorThreadLocal;
+    PageHeap m_pageHeap;
+    CentralFreeList m_arrCentralFreeLists[kSizeClassCount];
+    HeapProfiler m_heapProfiler;
 };
 
 }
@@ -0,0 +1,477 @@
+#include "arena_allocator_impl.h"
+#include "lldk/common/error_code.h"
+
+namespace lldk
+{
+namespace base
+{
+
+ArenaAllocatorImpl::ArenaAllocatorImpl(const char *pName, IAllocator *pAllocator, uint64_t uBlockSize)
+    : m_sName(pName), m_pAllocator(pAllocator), m_uBlockSize(uBlockSize)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_stats.uTid = lldkGetTid();
+}
+
+ArenaAllocatorImpl::~ArenaAllocatorImpl()
+{
+    while (m_pFirstBlock != nullptr)
+    {
+        auto pNext = m_pFirstBlock->pNext;
+        m_pAllocator->free(m_pFirstBlock);
+        m_pFirstBlock = pNext;
+    }
+}
+
+void *ArenaAllocatorImpl::allocate(uint64_t uSize)
+{
+    if (unlikely(uSize > UINT64_MAX - kBlockHeaderSize - kHeaderSize - 16))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+        return nullptr;
+    }
+
+    uint64_t uAlignedSize = getAlignedSize(uSize);
+    uint64_t uStride = kHeaderSize + uAlignedSize;
+    uint8_t *pCursor = nullptr;
+    if (likely(m_pCurrentBlock != nullptr && m_pCurrentBlock->uSize - m_uOffset >= uStride))
+    {
+        pCursor = getBlockData(m_pCurrentBlock) + m_uOffset;
+        m_uOffset += uStride;
+    }
+    else if (unlikely((pCursor = (uint8_t *)allocateSlow(uStride)) == nullptr))
+    {
+        return nullptr;
+    }
+
+    void *pMemory = setHeader(pCursor + kHeaderSize, uAlignedSize);
+    m_pLastMemory = pMemory;
+    m_stats.uAllocatedSize += uAlignedSize;
+    m_stats.uAllocatedCount++;
+    return pMemory;
+}
+
+void *ArenaAllocatorImpl::allocateSlow(uint64_t uSize)
+{
+    auto pNextBlock = m_pCurrentBlock != nullptr ? m_pCurrentBlock->pNext : m_pFirstBlock;
+    if (pNextBlock == nullptr || pNextBlock->uSize < uSize)
+    {
+        // a spare block too small is left in place for the smaller allocations after a rewind
+        uint64_t uBlockSize = uSize > m_uBlockSize ? uSize : m_uBlockSize;
+        auto pBlock = (Block *)m_pAllocator->allocate(kBlockHeaderSize + uBlockSize);
+        if (unlikely(pBlock == nullptr))
+        {
+            lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+            return nullptr;
+        }
+
+        pBlock->pNext = pNextBlock;
+        pBlock->uSize = uBlockSize;
+        if (m_pCurrentBlock != nullptr)
+        {
+            m_pCurrentBlock->pNext = pBlock;
+        }
+        else
+        {
+            m_pFirstBlock = pBlock;
+        }
+        m_uMappedSize += kBlockHeaderSize + uBlockSize;
+        pNextBlock = pBlock;
+    }
+
+    m_pCurrentBlock = pNextBlock;
+    m_uOffset = uSize;
+    return getBlockData(pNextBlock);
+}
+
+void *ArenaAllocatorImpl::allocateAligned(uint64_t uSize, uint64_t uAlign)
+{
+    if (unlikely(uAlign == 0 || (uAlign & (uAlign - 1)) != 0 || uAlign > kMaxAlignment))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return nullptr;
+    }
+
+    if (uAlign <= kDefaultAlignment)
+    {
+        return allocate(uSize);
+    }
+
+    if (unlikely(uSize > UINT64_MAX - kBlockHeaderSize - kHeaderSize - uAlign))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+        return nullptr;
+    }
+
+    uint64_t uAlignedSize = getAlignedSize(uSize);
+    if (m_pCurrentBlock != nullptr)
+    {
+        auto uCursor = (uintptr_t)(getBlockData(m_pCurrentBlock) + m_uOffset) + kHeaderSize;
+        uint64_t uPadding = LLDK_ALIGN_BASE(uCursor, uAlign) - uCursor;
+        if (m_pCurrentBlock->uSize - m_uOffset >= uPadding + kHeaderSize + uAlignedSize)
+        {
+            m_uOffset += uPadding;
+            return allocate(uSize);
+        }
+    }
+
+    // the block data is only 16 bytes aligned, take enough room to align inside it, the header
+    // of the aligned address lies inside the allocation unless no padding was needed
+    auto pMemory = (uint8_t *)allocate(uAlignedSize + uAlign - 16);
+    if (unlikely(pMemory == nullptr))
+    {
+        return nullptr;
+    }
+
+    m_pLastMemory = setHeader((void *)LLDK_ALIGN_BASE((uintptr_t)pMemory, uAlign), uAlignedSize);
+    return m_pLastMemory;
+}
+
+void ArenaAllocatorImpl::free(void *pMemory)
+{
+    (void)pMemory;
+}
+
+void ArenaAllocatorImpl::free(void *pMemory, uint64_t uSize)
+{
+    (void)pMemory;
+    (void)uSize;
+}
+
+uint64_t ArenaAllocatorImpl::allocateBatch(uint64_t uSize, uint64_t uCount, void **ppMemory)
+{
+    if (unlikely(ppMemory == nullptr && uCount > 0))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return 0;
+    }
+
+    if (unlikely(uSize > UINT64_MAX - kBlockHeaderSize - kHeaderSize - 16))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+        return 0;
+    }
+
+    uint64_t uAlignedSize = getAlignedSize(uSize);
+    uint64_t uStride = kHeaderSize + uAlignedSize;
+    uint64_t uAllocated = 0;
+    while (uAllocated < uCount)
+    {
+        // carve every block fitting in the rest of the current block with one bounds check
+        uint64_t uFitCount = m_pCurrentBlock != nullptr ? (m_pCurrentBlock->uSize - m_uOffset) / uStride : 0;
+        uFitCount = uFitCount < uCount - uAllocated ? uFitCount : uCount - uAllocated;
+        if (uFitCount == 0)
+        {
+            if (unlikely((ppMemory[uAllocated] = allocate(uSize)) == nullptr))
+            {
+                break;
+            }
+            uAllocated++;
+            continue;
+        }
+
+        uint8_t *pCursor = getBlockData(m_pCurrentBlock) + m_uOffset + kHeaderSize;
+        for (uint64_t i = 0; i < uFitCount; i++)
+        {
+            ppMemory[uAllocated++] = setHeader(pCursor + i * uStride, uAlignedSize);
+        }
+        m_uOffset += uFitCount * uStride;
+        m_pLastMemory = ppMemory[uAllocated - 1];
+        m_stats.uAllocatedSize += uFitCount * uAlignedSize;
+        m_stats.uAllocatedCount += uFitCount;
+    }
+    return uAllocated;
+}
+
+void ArenaAllocatorImpl::freeBatch(void **ppMemory, uint64_t uCount)
+{
+    (void)ppMemory;
+    (void)uCount;
+}
+
+bool ArenaAllocatorImpl::owns(void *pMemory) const
+{
+    if (m_pCurrentBlock == nullptr)
+    {
+        return false;
+    }
+
+    // the memory reallocated is mostly in the current block, the blocks before it are walked otherwise
+    auto pInBlock = [pMemory](Block *pBlock) {
+        auto pData = getBlockData(pBlock);
+        return (uint8_t *)pMemory >= pData + kHeaderSize && (uint8_t *)pMemory < pData + pBlock->uSize;
+    };
+    if (likely(pInBlock(m_pCurrentBlock)))
+    {
+        return true;
+    }
+
+    for (auto pBlock = m_pFirstBlock; pBlock != m_pCurrentBlock; pBlock = pBlock->pNext)
+    {
+        if (pInBlock(pBlock))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void *ArenaAllocatorImpl::reAllocate(void *pMemory, uint64_t uSize)
+{
+    if (unlikely(pMemory == nullptr))
+    {
+        return allocate(uSize);
+    }
+
+    if (unlikely(!owns(pMemory)))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return nullptr;
+    }
+
+    auto pHeader = getHeader(pMemory);
+
+    uint64_t uOldSize = pHeader->uSize;
+    if (likely(uSize <= UINT64_MAX - kBlockHeaderSize - kHeaderSize - 16))
+    {
+        uint64_t uAlignedSize = getAlignedSize(uSize);
+        if (uAlignedSize <= uOldSize)
+        {
+            return pMemory;
+        }
+
+        // the latest allocation lies in the current block and grows into its free bytes
+        if (pMemory == m_pLastMemory)
+        {
+            uint64_t uEnd = (uint64_t)((uint8_t *)pMemory - getBlockData(m_pCurrentBlock)) + uAlignedSize;
+            if (uEnd <= m_pCurrentBlock->uSize)
+            {
+                if (uEnd > m_uOffset)
+                {
+                    m_stats.uAllocatedSize += uEnd - m_uOffset;
+                    m_uOffset = uEnd;
+                }
+                pHeader->uSize = uAlignedSize;
+                return pMemory;
+            }
+        }
+    }
+
+    void *pNewMemory = allocate(uSize);
+    if (unlikely(pNewMemory == nullptr))
+    {
+        return nullptr;
+    }
+
+    memcpy(pNewMemory, pMemory, uOldSize < uSize ? uOldSize : uSize);
+    return pNewMemory;
+}
+
+uint64_t ArenaAllocatorImpl::getUsableSize(void *pMemory) const
+{
+    if (unlikely(pMemory == nullptr || !owns(pMemory)))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return 0;
+    }
+
+    // the size in the header is the aligned size, the padding is already the caller's
+    return getHeader(pMemory)->uSize;
+}
+
+int32_t ArenaAllocatorImpl::reserve(uint64_t uSize, uint64_t uCount)
+{
+    if (unlikely(uSize > UINT64_MAX - kBlockHeaderSize - kHeaderSize - 16))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return -1;
+    }
+
+    // the reserved room counts the header of every allocation
+    uint64_t uAlignedSize = kHeaderSize + getAlignedSize(uSize);
+    uint64_t uLeft = uCount;
+    if (m_pCurrentBlock != nullptr)
+    {
+        uint64_t uFreeSize = m_pCurrentBlock->uSize - m_uOffset;
+        memset(getBlockData(m_pCurrentBlock) + m_uOffset, 0, uFreeSize);
+        uLeft -= uLeft < uFreeSize / uAlignedSize ? uLeft : uFreeSize / uAlignedSize;
+    }
+
+    // the spare blocks are used in order until one is too small, a new block goes in front of it
+    Block *pPrev = m_pCurrentBlock;
+    Block *pBlock = m_pCurrentBlock != nullptr ? m_pCurrentBlock->pNext : m_pFirstBlock;
+    for (; uLeft > 0 && pBlock != nullptr && pBlock->uSize >= uAlignedSize; pPrev = pBlock, pBlock = pBlock->pNext)
+    {
+        memset(getBlockData(pBlock), 0, pBlock->uSize);
+        uLeft -= uLeft < pBlock->uSize / uAlignedSize ? uLeft : pBlock->uSize / uAlignedSize;
+    }
+
+    if (uLeft == 0)
+    {
+        return 0;
+    }
+
+    if (unlikely(uLeft > (UINT64_MAX - kBlockHeaderSize) / uAlignedSize))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return -1;
+    }
+
+    uint64_t uBlockSize = uLeft * uAlignedSize > m_uBlockSize ? uLeft * uAlignedSize : m_uBlockSize;
+    auto pNewBlock = (Block *)m_pAllocator->allocate(kBlockHeaderSize + uBlockSize);
+    if (unlikely(pNewBlock == nullptr))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+        return -1;
+    }
+
+    memset(getBlockData(pNewBlock), 0, uBlockSize);
+    pNewBlock->pNext = pBlock;
+    pNewBlock->uSize = uBlockSize;
+    if (pPrev != nullptr)
+    {
+        pPrev->pNext = pNewBlock;
+    }
+    else
+    {
+        m_pFirstBlock = pNewBlock;
+    }
+    m_uMappedSize += kBlockHeaderSize + uBlockSize;
+    return 0;
+}
+
+const char *ArenaAllocatorImpl::getName() const
+{
+    return m_sName.c_str();
+}
+
+int32_t ArenaAllocatorImpl::getAllocateStats(IAllocator::AllocateStats *pAllocateStats, uint32_t *pThreadCount) const
+{
+    if (unlikely(pAllocateStats == nullptr || pThreadCount == nullptr))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return -1;
+    }
+
+    if (likely(*pThreadCount > 0))
+    {
+        pAllocateStats[0] = m_stats;
+        *pThreadCount = 1;
+    }
+    return 0;
+}
+
+int32_t ArenaAllocatorImpl::getMemoryStats(IAllocator::MemoryStats *pMemoryStats) const
+{
+    if (unlikely(pMemoryStats == nullptr))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return -1;
+    }
+
+    memset(pMemoryStats, 0, sizeof(*pMemoryStats));
+    pMemoryStats->uMappedSize = m_uMappedSize;
+    return 0;
+}
+
+int32_t ArenaAllocatorImpl::getAllocateHistogram(IAllocator::AllocateHistogram *pHistogram) const
+{
+    // the blocks of an arena are never freed one by one, there is no lifetime to record
+    (void)pHistogram;
+    lldkSetErrorCode(lldk::ErrorCode::kInvalidState);
+    return -1;
+}
+
+int32_t ArenaAllocatorImpl::setSampleInterval(uint64_t uSampleInterval)
+{
+    // the scratch allocations of an arena are cheap to find by its name, no stack is sampled
+    (void)uSampleInterval;
+    lldkSetErrorCode(lldk::ErrorCode::kInvalidCall);
+    return -1;
+}
+
+int32_t ArenaAllocatorImpl::dumpHeapProfile(const char *pFileName, IAllocator::ProfileFormat eFormat) const
+{
+    (void)pFileName;
+    (void)eFormat;
+    lldkSetErrorCode(lldk::ErrorCode::kInvalidCall);
+    return -1;
+}
+
+void ArenaAllocatorImpl::reset()
+{
+    m_pCurrentBlock = nullptr;
+    m_uOffset = 0;
+    m_pLastMemory = nullptr;
+    m_stats.uFreedSize = m_stats.uAllocatedSize;
+    m_stats.uFreedCount = m_stats.uAllocatedCount;
+}
+
+IArenaAllocator::Marker ArenaAllocatorImpl::getMarker() const
+{
+    IArenaAllocator::Marker marker;
+    marker.pBlock = m_pCurrentBlock;
+    marker.uOffset = m_uOffset;
+    marker.uLiveSize = m_stats.uAllocatedSize - m_stats.uFreedSize;
+    marker.uLiveCount = m_stats.uAllocatedCount - m_stats.uFreedCount;
+    return marker;
+}
+
+void ArenaAllocatorImpl::rewind(const IArenaAllocator::Marker &marker)
+{
+    m_pCurrentBlock = (Block *)marker.pBlock;
+    m_uOffset = marker.uOffset;
+    m_pLastMemory = nullptr;
+    m_stats.uFreedSize = m_stats.uAllocatedSize - marker.uLiveSize;
+    m_stats.uFreedCount = m_stats.uAllocatedCount - marker.uLiveCount;
+}
+
+}
+}
+
+lldk::base::IArenaAllocator *lldkCreateArenaAllocator(const char *pName, lldk::base::IAllocator *pAllocator, uint64_t uBlockSize)
+{
+    if (unlikely(pName == nullptr || uBlockSize == 0))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return nullptr;
+    }
+
+    if (pAllocator == nullptr)
+    {
+        pAllocator = lldkGetAllocatorSingleton();
+        if (unlikely(pAllocator == nullptr))
+        {
+            lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+            return nullptr;
+        }
+    }
+
+    try
+    {
+        auto pArenaAllocator = pAllocator->newObject<lldk::base::ArenaAllocatorImpl>(pName, pAllocator, LLDK_ALIGN_BASE(uBlockSize, 16));
+        if (unlikely(pArenaAllocator == nullptr))
+        {
+            lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+            return nullptr;
+        }
+        return pArenaAllocator;
+    }
+    catch (...)
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kThrowException);
+        return nullptr;
+    }
+}
+
+void lldkDestroyArenaAllocator(lldk::base::IArenaAllocator *pArenaAllocator)
+{
+    if (unlikely(pArenaAllocator == nullptr))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return;
+    }
+
+    auto pArenaAllocatorImpl = static_cast<lldk::base::ArenaAllocatorImpl *>(pArenaAllocator);
+    pArenaAllocatorImpl->getAllocator()->deleteObject(pArenaAllocatorImpl);
+}
@@ -0,0 +1,102 @@
+#ifndef LLDK_BASE_ARENA_ALLOCATOR_IMPL_H
+#define LLDK_BASE_ARENA_ALLOCATOR_IMPL_H
+
+#include "lldk/base/arena_allocator.h"
+#include <string>
+
+namespace lldk
+{
+namespace base
+{
+
+class ArenaAllocatorImpl : public IArenaAllocator
+{
+public:
+    ArenaAllocatorImpl(const char *pName, IAllocator *pAllocator, uint64_t uBlockSize);
+    ~ArenaAllocatorImpl() override;
+
+    void *allocate(uint64_t uSize) override;
+    void free(void *pMemory) override;
+    void *allocateAligned(uint64_t uSize, uint64_t uAlign) override;
+    void free(void *pMemory, uint64_t uSize) override;
+    uint64_t allocateBatch(uint64_t uSize, uint64_t uCount, void **ppMemory) override;
+    void freeBatch(void **ppMemory, uint64_t uCount) override;
+    void *reAllocate(void *pMemory, uint64_t uSize) override;
+    uint64_t getUsableSize(void *pMemory) const override;
+    int32_t reserve(uint64_t uSize, uint64_t uCount) override;
+    const char *getName() const override;
+    int32_t getAllocateStats(IAllocator::AllocateStats *pAllocateStats, uint32_t *pThreadCount) const override;
+    int32_t getMemoryStats(IAllocator::MemoryStats *pMemoryStats) const override;
+    int32_t getAllocateHistogram(IAllocator::AllocateHistogram *pHistogram) const override;
+    int32_t setSampleInterval(uint64_t uSampleInterval) override;
+    int32_t dumpHeapProfile(const char *pFileName, IAllocator::ProfileFormat eFormat) const override;
+
+    void reset() override;
+    IArenaAllocator::Marker getMarker() const override;
+    void rewind(const IArenaAllocator::Marker &marker) override;
+
+    IAllocator *getAllocator() const
+    {
+        return m_pAllocator;
+    }
+
+private:
+    // the blocks are linked in the order they are used, the ones after the current block are spare
+    struct Block
+    {
+        Block *pNext;
+        uint64_t uSize; // The bytes size of the data
+    };
+
+    // every allocation is preceded by its size, so reAllocate copies only the bytes of the old allocation
+    struct Header
+    {
+        uint64_t uSize; // The bytes size of the allocation, a multiple of 16
+        uint64_t uReserved;
+    };
+
+    static constexpr uint64_t kBlockHeaderSize = LLDK_ALIGN_BASE(sizeof(Block), 16);
+    static constexpr uint64_t kHeaderSize = sizeof(Header);
+
+    static_assert(kHeaderSize % 16 == 0, "the header must keep the allocations 16 bytes aligned");
+
+    static uint8_t *getBlockData(Block *pBlock)
+    {
+        return (uint8_t *)pBlock + kBlockHeaderSize;
+    }
+
+    static Header *getHeader(void *pMemory)
+    {
+        return (Header *)((uint8_t *)pMemory - kHeaderSize);
+    }
+
+    static uint64_t getAlignedSize(uint64_t uSize)
+    {
+        return uSize > 0 ? LLDK_ALIGN_BASE(uSize, 16) : 16;
+    }
+
+    static void *setHeader(void *pMemory, uint64_t uAlignedSize)
+    {
+        getHeader(pMemory)->uSize = uAlignedSize;
+        return pMemory;
+    }
+
+    void *allocateSlow(uint64_t uSize);
+    bool owns(void *pMemory) const;
+
+private:
+    std::string m_sName;
+    IAllocator *m_pAllocator;
+    uint64_t m_uBlockSize;
+    Block *m_pFirstBlock{nullptr};
+    Block *m_pCurrentBlock{nullptr};
+    uint64_t m_uOffset{0};       // The used bytes of the current block
+    void *m_pLastMemory{nullptr}; // The latest allocation, grown in place by reAllocate
+    uint64_t m_uMappedSize{0};
+    IAllocator::AllocateStats m_stats;
+};
+
+}
+}
+
+#endif // LLDK_BASE_ARENA_ALLOCATOR_IMPL_H
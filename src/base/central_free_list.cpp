@@ -0,0 +1,167 @@
+#include "central_free_list.h"
+#include "lldk/common/error_code.h"
+
+namespace lldk
+{
+namespace base
+{
+
+void CentralFreeList::init(uint32_t uSizeClass, PageHeap *pPageHeap)
+{
+    m_uSizeClass = uSizeClass;
+    m_uObjectSize = SizeClass::getClassSize(uSizeClass);
+    m_uSpanPages = SizeClass::getSpanPages(uSizeClass);
+    m_uBatchCount = SizeClass::getBatchCount(uSizeClass);
+    m_pPageHeap = pPageHeap;
+}
+
+void CentralFreeList::linkSpan(Span *pSpan)
+{
+    pSpan->pPrev = nullptr;
+    pSpan->pNext = m_pNonEmptySpans;
+    if (m_pNonEmptySpans != nullptr)
+    {
+        m_pNonEmptySpans->pPrev = pSpan;
+    }
+    m_pNonEmptySpans = pSpan;
+}
+
+void CentralFreeList::unlinkSpan(Span *pSpan)
+{
+    if (pSpan->pPrev != nullptr)
+    {
+        pSpan->pPrev->pNext = pSpan->pNext;
+    }
+    else
+    {
+        m_pNonEmptySpans = pSpan->pNext;
+    }
+
+    if (pSpan->pNext != nullptr)
+    {
+        pSpan->pNext->pPrev = pSpan->pPrev;
+    }
+    pSpan->pPrev = pSpan->pNext = nullptr;
+}
+
+void *CentralFreeList::popObject(Span *pSpan)
+{
+    void *pObject = pSpan->pFreeList;
+    if (pObject != nullptr)
+    {
+        pSpan->pFreeList = *(void **)pObject;
+    }
+    else
+    {
+        pObject = (uint8_t *)PageHeap::getSpanAddress(pSpan) + (uint64_t)pSpan->uBumpCount * m_uObjectSize;
+        pSpan->uBumpCount++;
+    }
+
+    if (++pSpan->uUsedCount == pSpan->uCapacity)
+    {
+        unlinkSpan(pSpan);
+    }
+    return pObject;
+}
+
+Span *CentralFreeList::allocateSpan(void *pOwner)
+{
+    auto pSpan = m_pPageHeap->allocateSpan(m_uSpanPages);
+    if (unlikely(pSpan == nullptr))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+        return nullptr;
+    }
+
+    pSpan->uSizeClass = m_uSizeClass;
+    pSpan->uObjectSize = m_uObjectSize;
+    pSpan->uCapacity = (uint32_t)((m_uSpanPages * kPageSize) / m_uObjectSize);
+    pSpan->pOwner.store(pOwner, std::memory_order_release);
+    linkSpan(pSpan);
+    return pSpan;
+}
+
+void CentralFreeList::pushObject(void *pMemory, Span *pSpan)
+{
+    if (pSpan->uUsedCount == pSpan->uCapacity)
+    {
+        linkSpan(pSpan);
+    }
+
+    *(void **)pMemory = pSpan->pFreeList;
+    pSpan->pFreeList = pMemory;
+
+    // hand the span back to the page heap once it is empty, unless it is the last one of the class
+    if (--pSpan->uUsedCount == 0 && (pSpan->pPrev != nullptr || pSpan->pNext != nullptr))
+    {
+        unlinkSpan(pSpan);
+        m_pPageHeap->freeSpan(pSpan);
+    }
+}
+
+void *CentralFreeList::allocate()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (unlikely(m_pNonEmptySpans == nullptr && allocateSpan(nullptr) == nullptr))
+    {
+        return nullptr;
+    }
+
+    return popObject(m_pNonEmptySpans);
+}
+
+void CentralFreeList::free(void *pMemory, Span *pSpan)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    pushObject(pMemory, pSpan);
+}
+
+uint32_t CentralFreeList::removeRange(void **ppHead, uint32_t uCount, void *pOwner)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (uCount == m_uBatchCount && m_uDepotCount > 0)
+    {
+        auto &batch = m_arrDepot[--m_uDepotCount];
+        *ppHead = batch.pHead;
+        return batch.uCount;
+    }
+
+    void *pHead = nullptr;
+    uint32_t uRemoved = 0;
+    for (; uRemoved < uCount; uRemoved++)
+    {
+        if (unlikely(m_pNonEmptySpans == nullptr && allocateSpan(pOwner) == nullptr))
+        {
+            break;
+        }
+
+        void *pObject = popObject(m_pNonEmptySpans);
+        *(void **)pObject = pHead;
+        pHead = pObject;
+    }
+
+    *ppHead = pHead;
+    return uRemoved;
+}
+
+void CentralFreeList::insertRange(void *pHead, uint32_t uCount)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (uCount == m_uBatchCount && m_uDepotCount < kMaxDepotBatches)
+    {
+        auto &batch = m_arrDepot[m_uDepotCount++];
+        batch.pHead = pHead;
+        batch.uCount = uCount;
+        return;
+    }
+
+    while (pHead != nullptr)
+    {
+        void *pNext = *(void **)pHead;
+        pushObject(pHead, PageHeap::getSpan(pHead));
+        pHead = pNext;
+    }
+}
+
+}
+}
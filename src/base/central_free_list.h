@@ -0,0 +1,102 @@
+#ifndef LLDK_BASE_CENTRAL_FREE_LIST_H
+#define LLDK_BASE_CENTRAL_FREE_LIST_H
+
+#include "lldk/common/common.h"
+#include "page_heap.h"
+#include <mutex>
+
+namespace lldk
+{
+namespace base
+{
+
+/**
+ * @brief The shared objects of one size class, carved from spans of the page heap
+ * @note full batches flushed by thread caches are kept as they are in a small depot, so that a
+ *       refill of another thread takes them back without touching the spans.
+ */
+class CentralFreeList
+{
+public:
+    CentralFreeList() = default;
+    ~CentralFreeList() = default;
+
+    CentralFreeList(const CentralFreeList &) = delete;
+    CentralFreeList &operator=(const CentralFreeList &) = delete;
+
+    /**
+     * @brief Init the central free list
+     * @param uSizeClass The size class
+     * @param pPageHeap The page heap to get spans from
+     */
+    void init(uint32_t uSizeClass, PageHeap *pPageHeap);
+
+    /**
+     * @brief Allocate an object
+     * @return The pointer to the object, NULL if failed
+     */
+    void *allocate();
+
+    /**
+     * @brief Free an object
+     * @param pMemory The pointer to the object
+     * @param pSpan The span of the object
+     */
+    void free(void *pMemory, Span *pSpan);
+
+    /**
+     * @brief Remove a batch of objects
+     * @param ppHead The head of the removed objects linked by their first word, output parameter
+     * @param uCount The object count wanted
+     * @param pOwner The thread cache the objects of newly carved spans are returned to
+     * @return The object count removed, 0 if failed
+     */
+    uint32_t removeRange(void **ppHead, uint32_t uCount, void *pOwner);
+
+    /**
+     * @brief Insert a batch of objects
+     * @param pHead The head of the objects linked by their first word
+     * @param uCount The object count
+     */
+    void insertRange(void *pHead, uint32_t uCount);
+
+    /**
+     * @brief Get the object size of the size class
+     * @return The object size
+     */
+    uint32_t getObjectSize() const
+    {
+        return m_uObjectSize;
+    }
+
+private:
+    static constexpr uint32_t kMaxDepotBatches = 32;
+
+    struct Batch
+    {
+        void *pHead;
+        uint32_t uCount;
+    };
+
+    Span *allocateSpan(void *pOwner);
+    void *popObject(Span *pSpan);
+    void pushObject(void *pMemory, Span *pSpan);
+    void linkSpan(Span *pSpan);
+    void unlinkSpan(Span *pSpan);
+
+private:
+    std::mutex m_mutex;
+    Span *m_pNonEmptySpans{nullptr}; // The spans have objects to hand out
+    Batch m_arrDepot[kMaxDepotBatches]; // The full batches flushed by thread caches
+    uint32_t m_uDepotCount{0};
+    uint32_t m_uBatchCount{0};
+    PageHeap *m_pPageHeap{nullptr};
+    uint32_t m_uSizeClass{0};
+    uint32_t m_uObjectSize{0};
+    uint32_t m_uSpanPages{0};
+};
+
+}
+}
+
+#endif // LLDK_BASE_CENTRAL_FREE_LIST_H
@@ -0,0 +1,298 @@
+#include "heap_profiler.h"
+#include "lldk/common/error_code.h"
+#include <cmath>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/mman.h>
+
+namespace lldk
+{
+namespace base
+{
+
+// set while the thread records a sample, initial-exec since a dynamic TLS access may allocate
+static __thread bool s_bRecording __attribute__((tls_model("initial-exec"))) = false;
+
+HeapProfiler::~HeapProfiler()
+{
+    if (m_pSamples != nullptr)
+    {
+        munmap(m_pSamples, sizeof(StackSample) * kMaxSampleCount);
+    }
+}
+
+int32_t HeapProfiler::setSampleInterval(uint64_t uSampleInterval)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (uSampleInterval != 0 && m_pSamples == nullptr)
+    {
+        // mapped rather than allocated, the table may belong to the allocator singleton
+        auto pSamples = mmap(nullptr, sizeof(StackSample) * kMaxSampleCount, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (unlikely(pSamples == MAP_FAILED))
+        {
+            lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+            return -1;
+        }
+        m_pSamples = (StackSample *)pSamples;
+    }
+
+    // samples taken with another interval can not be scaled together, turning sampling off keeps them
+    if (uSampleInterval != 0 && uSampleInterval != m_uProfileInterval)
+    {
+        memset((void *)m_pSamples, 0, sizeof(StackSample) * kMaxSampleCount);
+        m_uProfileInterval = uSampleInterval;
+    }
+    m_uSampleInterval.store(uSampleInterval, std::memory_order_relaxed);
+    return 0;
+}
+
+/**
+ * @brief Get the load address of the module this file is linked into
+ * @return The load address, NULL if unknown
+ */
+static void *getModuleBase()
+{
+    static void *s_pModuleBase = []() -> void * {
+        Dl_info info;
+        return dladdr((void *)&getModuleBase, &info) != 0 ? info.dli_fbase : nullptr;
+    }();
+    return s_pModuleBase;
+}
+
+/**
+ * @brief Count the leading frames of the allocator itself
+ * @param arrFrames The frames from the innermost
+ * @param uDepth The frame count
+ * @return The count of the frames to skip, 1 for the recording frame if the allocator is linked
+ *         into the same module as its caller
+ */
+static uint32_t getSkipFrameCount(void **arrFrames, uint32_t uDepth)
+{
+    void *pModuleBase = getModuleBase();
+    uint32_t uSkipCount = 1;
+    Dl_info info;
+    while (uSkipCount < uDepth && dladdr(arrFrames[uSkipCount], &info) != 0 && info.dli_fbase == pModuleBase)
+    {
+        uSkipCount++;
+    }
+    return uSkipCount < uDepth ? uSkipCount : (uDepth > 0 ? 1 : 0);
+}
+
+void HeapProfiler::record(uint64_t uSize)
+{
+    // the first backtrace loads the unwinder, which allocates and may be sampled again
+    if (unlikely(s_bRecording))
+    {
+        return;
+    }
+    s_bRecording = true;
+
+    void *arrFrames[kMaxStackDepth + kMaxSkipFrameCount];
+    int32_t iDepth = backtrace(arrFrames, (int32_t)(kMaxStackDepth + kMaxSkipFrameCount));
+    uint32_t uSkipCount = getSkipFrameCount(arrFrames, iDepth > 0 ? (uint32_t)iDepth : 0);
+    uint32_t uDepth = iDepth > 0 ? (uint32_t)iDepth - uSkipCount : 0;
+    uDepth = uDepth < kMaxStackDepth ? uDepth : kMaxStackDepth;
+    void **pFrames = arrFrames + uSkipCount;
+
+    // FNV-1a over the frame addresses
+    uint64_t uHash = 14695981039346656037ULL;
+    for (uint32_t i = 0; i < uDepth; i++)
+    {
+        uHash = (uHash ^ (uint64_t)(uintptr_t)pFrames[i]) * 1099511628211ULL;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (likely(m_uProfileInterval != 0))
+        {
+            // linear probing, the samples of a new stack are dropped once the table is full
+            StackSample *pSample = nullptr;
+            for (uint32_t i = 0; i < kMaxSampleCount; i++)
+            {
+                auto &sample = m_pSamples[(uHash + i) & (kMaxSampleCount - 1)];
+                if (sample.uCount == 0)
+                {
+                    sample.uHash = uHash;
+                    sample.uDepth = uDepth;
+                    memcpy(sample.arrFrames, pFrames, uDepth * sizeof(void *));
+                    pSample = &sample;
+                    break;
+                }
+                if (sample.uHash == uHash && sample.uDepth == uDepth &&
+                    memcmp(sample.arrFrames, pFrames, uDepth * sizeof(void *)) == 0)
+                {
+                    pSample = &sample;
+                    break;
+                }
+            }
+
+            if (likely(pSample != nullptr))
+            {
+                // an allocation of uSize bytes is sampled with the probability 1 - exp(-uSize / interval)
+                double dSize = uSize > 0 ? (double)uSize : 1.0;
+                pSample->uCount++;
+                pSample->uSize += uSize;
+                pSample->dEstimatedSize += dSize / (1.0 - exp(-dSize / (double)m_uProfileInterval));
+            }
+        }
+    }
+
+    s_bRecording = false;
+}
+
+int32_t HeapProfiler::dump(const char *pFileName, IAllocator::ProfileFormat eFormat) const
+{
+    if (unlikely(pFileName == nullptr || (eFormat != IAllocator::kProfilePprof && eFormat != IAllocator::kProfileCollapsed)))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return -1;
+    }
+
+    auto pFile = fopen(pFileName, "w");
+    if (unlikely(pFile == nullptr))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kSystemCallError);
+        return -1;
+    }
+
+    // the names and the file buffers are allocated under the lock, maybe from the profiled allocator,
+    // the thread must not record those allocations and take the lock again
+    bool bRecording = s_bRecording;
+    s_bRecording = true;
+    int32_t iRet = 0;
+    try
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        iRet = eFormat == IAllocator::kProfilePprof ? dumpPprof(pFile) : dumpCollapsed(pFile);
+    }
+    catch (...)
+    {
+        iRet = -1;
+    }
+    s_bRecording = bRecording;
+
+    if (unlikely(fclose(pFile) != 0 || iRet != 0))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kSystemCallError);
+        return -1;
+    }
+    return 0;
+}
+
+int32_t HeapProfiler::dumpPprof(FILE *pFile) const
+{
+    // the legacy text heap profile of gperftools, only the allocated columns are kept since the frees
+    // of sampled objects are not tracked, read it with pprof -sample_index=alloc_space
+    uint64_t uTotalCount = 0, uTotalSize = 0;
+    for (uint32_t i = 0; m_pSamples != nullptr && i < kMaxSampleCount; i++)
+    {
+        uTotalCount += m_pSamples[i].uCount;
+        uTotalSize += m_pSamples[i].uSize;
+    }
+
+    fprintf(pFile, "heap profile: %6d: %8d [%6llu: %8llu] @ heap_v2/%llu\n", 0, 0, (unsigned long long)uTotalCount,
+            (unsigned long long)uTotalSize, (unsigned long long)m_uProfileInterval);
+    for (uint32_t i = 0; m_pSamples != nullptr && i < kMaxSampleCount; i++)
+    {
+        auto &sample = m_pSamples[i];
+        if (sample.uCount == 0)
+        {
+            continue;
+        }
+
+        fprintf(pFile, "%6d: %8d [%6llu: %8llu] @", 0, 0, (unsigned long long)sample.uCount, (unsigned long long)sample.uSize);
+        for (uint32_t j = 0; j < sample.uDepth; j++)
+        {
+            fprintf(pFile, " %p", sample.arrFrames[j]);
+        }
+        fputc('\n', pFile);
+    }
+
+    fputs("\nMAPPED_LIBRARIES:\n", pFile);
+    auto pMaps = fopen("/proc/self/maps", "r");
+    if (pMaps != nullptr)
+    {
+        char arrBuffer[4096];
+        size_t uRead = 0;
+        while ((uRead = fread(arrBuffer, 1, sizeof(arrBuffer), pMaps)) > 0)
+        {
+            fwrite(arrBuffer, 1, uRead, pFile);
+        }
+        fclose(pMaps);
+    }
+    return ferror(pFile) != 0 ? -1 : 0;
+}
+
+/**
+ * @brief Get the name of a frame for the collapsed stacks
+ * @param pFrame The return address of the frame
+ * @param sName The name, the demangled symbol or module+offset, output parameter
+ */
+static void getFrameName(void *pFrame, std::string &sName)
+{
+    char arrName[64];
+    Dl_info info;
+    if (dladdr(pFrame, &info) == 0)
+    {
+        snprintf(arrName, sizeof(arrName), "%p", pFrame);
+        sName = arrName;
+        return;
+    }
+
+    if (info.dli_sname != nullptr)
+    {
+        int32_t iStatus = 0;
+        char *pDemangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &iStatus);
+        sName = iStatus == 0 && pDemangled != nullptr ? pDemangled : info.dli_sname;
+        ::free(pDemangled);
+    }
+    else
+    {
+        const char *pModule = info.dli_fname != nullptr ? strrchr(info.dli_fname, '/') : nullptr;
+        snprintf(arrName, sizeof(arrName), "+0x%llx", (unsigned long long)((uintptr_t)pFrame - (uintptr_t)info.dli_fbase));
+        sName = pModule != nullptr ? pModule + 1 : (info.dli_fname != nullptr ? info.dli_fname : "?");
+        sName += arrName;
+    }
+
+    // ';' separates the frames and the last ' ' the weight
+    for (auto &c : sName)
+    {
+        if (c == ';' || c == ' ')
+        {
+            c = '_';
+        }
+    }
+}
+
+int32_t HeapProfiler::dumpCollapsed(FILE *pFile) const
+{
+    // one line per stack, the frames from the root to the leaf, then the estimated allocated bytes
+    std::string sName;
+    for (uint32_t i = 0; m_pSamples != nullptr && i < kMaxSampleCount; i++)
+    {
+        auto &sample = m_pSamples[i];
+        if (sample.uCount == 0)
+        {
+            continue;
+        }
+
+        for (uint32_t j = sample.uDepth; j > 0; j--)
+        {
+            getFrameName(sample.arrFrames[j - 1], sName);
+            fputs(sName.c_str(), pFile);
+            if (j > 1)
+            {
+                fputc(';', pFile);
+            }
+        }
+        fprintf(pFile, " %llu\n", (unsigned long long)llround(sample.dEstimatedSize));
+    }
+    return ferror(pFile) != 0 ? -1 : 0;
+}
+
+}
+}
@@ -0,0 +1,89 @@
+#ifndef LLDK_BASE_HEAP_PROFILER_H
+#define LLDK_BASE_HEAP_PROFILER_H
+
+#include "lldk/base/allocator.h"
+#include <atomic>
+#include <mutex>
+#include <stdio.h>
+
+namespace lldk
+{
+namespace base
+{
+
+/**
+ * @brief The stack traces of the sampled allocations of an allocator
+ * @note a thread samples an allocation after a geometric distributed count of allocated bytes with
+ *       the sample interval as its mean, so every byte has the same chance to be sampled. samples of
+ *       the same stack are aggregated in a table of kMaxSampleCount stacks mapped when sampling is
+ *       first turned on, so recording never allocates from the allocator it profiles.
+ */
+class HeapProfiler
+{
+public:
+    HeapProfiler() = default;
+    ~HeapProfiler();
+
+    HeapProfiler(const HeapProfiler &) = delete;
+    HeapProfiler &operator=(const HeapProfiler &) = delete;
+
+    /**
+     * @brief Get the sample interval
+     * @return The mean bytes between two samples, 0 if sampling is off
+     */
+    LLDK_INLINE uint64_t getSampleInterval() const
+    {
+        return m_uSampleInterval.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Set the sample interval
+     * @param uSampleInterval The mean bytes between two samples, 0 to turn sampling off
+     * @return 0 if success, -1 if the sample table can not be mapped
+     */
+    int32_t setSampleInterval(uint64_t uSampleInterval);
+
+    /**
+     * @brief Record the stack trace of the calling thread for a sampled allocation
+     * @param uSize The requested bytes size of the allocation
+     * @note an allocation made by the stack unwinder re-enters the allocator, it is not recorded
+     */
+    void record(uint64_t uSize);
+
+    /**
+     * @brief Dump the aggregated samples to a file
+     * @param pFileName The file name
+     * @param eFormat The format of the file
+     * @return 0 if success, -1 if failed
+     */
+    int32_t dump(const char *pFileName, IAllocator::ProfileFormat eFormat) const;
+
+private:
+    static constexpr uint32_t kMaxStackDepth = 64;
+    static constexpr uint32_t kMaxSkipFrameCount = 8; // The frames of the allocator above the caller
+    static constexpr uint32_t kMaxSampleCount = 4096;  // The distinct stacks kept, a power of 2
+
+    struct StackSample
+    {
+        uint64_t uHash;          // The hash of the frames
+        uint32_t uDepth;
+        void *arrFrames[kMaxStackDepth];
+        uint64_t uCount;         // The sampled allocation count
+        uint64_t uSize;          // The sampled bytes size
+        double dEstimatedSize;   // The allocated bytes size the samples stand for
+    };
+
+    int32_t dumpPprof(FILE *pFile) const;
+    int32_t dumpCollapsed(FILE *pFile) const;
+
+private:
+    std::atomic<uint64_t> m_uSampleInterval{0};
+    mutable std::mutex m_mutex;
+    StackSample *m_pSamples{nullptr}; // Open addressed by the hash of the frames, a free slot has no count
+    uint64_t m_uProfileInterval{0}; // The sample interval the aggregated samples were taken with
+};
+
+}
+}
+
+#endif // LLDK_BASE_HEAP_PROFILER_H
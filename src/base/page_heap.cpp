@@ -0,0 +1,992 @@
+#include "page_heap.h"
+#include "lldk/common/error_code.h"
+#include "lldk/base/time.h"
+#include <chrono>
+#include <sys/mman.h>
+#include <stdio.h>
+#ifdef LLDK_OS_LINUX
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace lldk
+{
+namespace base
+{
+
+static constexpr uint32_t kAllPagesFreeMask = (uint32_t)(((1ULL << kPagesPerChunk) - 1) & ~1ULL);
+
+static uint32_t findFreeRun(uint32_t uFreePageMask, uint32_t uPageCount)
+{
+    uint32_t uRunMask = uFreePageMask;
+    for (uint32_t i = 1; i < uPageCount && uRunMask != 0; i++)
+    {
+        uRunMask &= uFreePageMask >> i;
+    }
+
+    return uRunMask == 0 ? kPagesPerChunk : (uint32_t)__builtin_ctz(uRunMask);
+}
+
+static LLDK_INLINE uint32_t getRunMask(uint32_t uStartPage, uint32_t uPageCount)
+{
+    return (uint32_t)(((1ULL << uPageCount) - 1) << uStartPage);
+}
+
+static void linkChunk(ChunkHeader *&pHead, ChunkHeader *pChunk)
+{
+    pChunk->pPrev = nullptr;
+    pChunk->pNext = pHead;
+    if (pHead != nullptr)
+    {
+        pHead->pPrev = pChunk;
+    }
+    pHead = pChunk;
+}
+
+static void unlinkChunk(ChunkHeader *&pHead, ChunkHeader *pChunk)
+{
+    if (pChunk->pPrev != nullptr)
+    {
+        pChunk->pPrev->pNext = pChunk->pNext;
+    }
+    else
+    {
+        pHead = pChunk->pNext;
+    }
+
+    if (pChunk->pNext != nullptr)
+    {
+        pChunk->pNext->pPrev = pChunk->pPrev;
+    }
+    pChunk->pPrev = pChunk->pNext = nullptr;
+}
+
+static void *mapAligned(uint64_t uSize, uint64_t uAlignment, int32_t iFlags)
+{
+    // over map by the alignment then trim the head and the tail to get an aligned mapping
+    uint64_t uTotalSize = uSize + uAlignment;
+    auto pMemory = mmap(nullptr, uTotalSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | iFlags, -1, 0);
+    if (unlikely(pMemory == MAP_FAILED))
+    {
+        return nullptr;
+    }
+
+    uintptr_t uBegin = (uintptr_t)pMemory;
+    uintptr_t uAligned = LLDK_ALIGN_BASE(uBegin, (uintptr_t)uAlignment);
+    uintptr_t uEnd = uBegin + uTotalSize;
+    uintptr_t uAlignedEnd = uAligned + uSize;
+    if (uAligned > uBegin)
+    {
+        munmap((void *)uBegin, uAligned - uBegin);
+    }
+    if (uEnd > uAlignedEnd)
+    {
+        munmap((void *)uAlignedEnd, uEnd - uAlignedEnd);
+    }
+    return (void *)uAligned;
+}
+
+#ifdef LLDK_OS_LINUX
+// the values of numaif.h, libnuma is not required
+static constexpr int32_t kMpolBind = 2;
+static constexpr int32_t kMpolLocal = 4;
+static constexpr uint32_t kMpolMfMove = 1 << 1;
+static constexpr uint32_t kMaxNumaNodes = 1024;
+
+/**
+ * @brief Get the count of the NUMA nodes from /sys/devices/system/node/online
+ * @return The highest online node id plus 1, 1 if unknown
+ */
+static int32_t getNumaNodeCount()
+{
+    auto pFile = fopen("/sys/devices/system/node/online", "r");
+    if (pFile == nullptr)
+    {
+        return 1;
+    }
+
+    // the format is a list of ranges like "0-1,3", the last number is the highest node id
+    char arrLine[256] = {0};
+    auto pLine = fgets(arrLine, sizeof(arrLine), pFile);
+    fclose(pFile);
+    if (pLine == nullptr)
+    {
+        return 1;
+    }
+
+    int32_t iNodeId = 0;
+    bool bInNumber = false;
+    for (const char *p = arrLine; *p != '\0'; p++)
+    {
+        bool bDigit = *p >= '0' && *p <= '9';
+        if (bDigit)
+        {
+            iNodeId = (bInNumber ? iNodeId * 10 : 0) + (*p - '0');
+        }
+        bInNumber = bDigit;
+    }
+    return iNodeId < (int32_t)kMaxNumaNodes ? iNodeId + 1 : (int32_t)kMaxNumaNodes;
+}
+#endif
+
+void PageHeap::bindMemory(void *pMemory, uint64_t uSize)
+{
+#ifdef LLDK_OS_LINUX
+    int32_t iNumaNode = m_iNumaNode;
+    if (iNumaNode == IAllocator::kNumaNodeAny)
+    {
+        return;
+    }
+
+    if (iNumaNode == IAllocator::kNumaNodeLocal)
+    {
+        // a chunk is shared by the spans of every thread, binding it to the node of the mapping
+        // thread would pull the pages of the others across, every page goes to the node of the
+        // thread touching it first instead, whatever policy the process inherited
+        syscall(SYS_mbind, pMemory, uSize, kMpolLocal, nullptr, 0, 0);
+        return;
+    }
+
+    // a failed binding leaves the first touch policy, the memory is still usable
+    unsigned long arrNodeMask[kMaxNumaNodes / (8 * sizeof(unsigned long))] = {0};
+    arrNodeMask[iNumaNode / (8 * sizeof(unsigned long))] |= 1UL << (iNumaNode % (8 * sizeof(unsigned long)));
+    syscall(SYS_mbind, pMemory, uSize, kMpolBind, arrNodeMask, kMaxNumaNodes + 1, kMpolMfMove);
+#else
+    (void)pMemory;
+    (void)uSize;
+#endif
+}
+
+void *PageHeap::mapMemory(uint64_t uSize, int32_t iFlags, bool *pHugeTlb)
+{
+    *pHugeTlb = false;
+    if (!m_bHugePage)
+    {
+        return mapAligned(uSize, kChunkSize, iFlags);
+    }
+
+    // huge page mappings are aligned to the huge page size, which is a multiple of the chunk size
+    uSize = LLDK_ALIGN_BASE(uSize, kChunkSize);
+#ifdef MAP_HUGETLB
+    // reserve the huge pages at map time, otherwise a drained pool raises SIGBUS on first touch
+    auto pMemory = mmap(nullptr, uSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (iFlags & ~MAP_NORESERVE), -1, 0);
+    if (pMemory != MAP_FAILED)
+    {
+        if (likely(((uintptr_t)pMemory & (kChunkSize - 1)) == 0))
+        {
+            *pHugeTlb = true;
+            return pMemory;
+        }
+        munmap(pMemory, uSize);
+    }
+#endif
+
+    auto pAligned = mapAligned(uSize, kChunkSize, iFlags);
+#ifdef MADV_HUGEPAGE
+    if (likely(pAligned != nullptr))
+    {
+        madvise(pAligned, uSize, MADV_HUGEPAGE);
+    }
+#endif
+    return pAligned;
+}
+
+std::atomic<std::atomic<uint64_t> *> ChunkRegistry::s_arrLeaves[1U << ChunkRegistry::kRootBits];
+
+std::atomic<uint64_t> *ChunkRegistry::getLeaf(uint64_t uIndex)
+{
+    auto &leaf = s_arrLeaves[uIndex >> kLeafBits];
+    auto pLeaf = leaf.load(std::memory_order_acquire);
+    if (pLeaf != nullptr)
+    {
+        return pLeaf;
+    }
+
+    // mapped rather than allocated, the registry is used by the allocator behind malloc as well
+    uint64_t uLeafSize = (1ULL << kLeafBits) / 8;
+    auto pMemory = mmap(nullptr, uLeafSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (unlikely(pMemory == MAP_FAILED))
+    {
+        return nullptr;
+    }
+
+    auto pNewLeaf = (std::atomic<uint64_t> *)pMemory;
+    if (!leaf.compare_exchange_strong(pLeaf, pNewLeaf, std::memory_order_acq_rel, std::memory_order_acquire))
+    {
+        munmap(pMemory, uLeafSize);
+        return pLeaf;
+    }
+    return pNewLeaf;
+}
+
+int32_t ChunkRegistry::add(const void *pChunk)
+{
+    uint64_t uIndex = (uintptr_t)pChunk >> kChunkShift;
+    auto pLeaf = uIndex < (1ULL << (kRootBits + kLeafBits)) ? getLeaf(uIndex) : nullptr;
+    if (unlikely(pLeaf == nullptr))
+    {
+        return -1;
+    }
+
+    uint64_t uBit = uIndex & ((1ULL << kLeafBits) - 1);
+    pLeaf[uBit / 64].fetch_or(1ULL << (uBit % 64), std::memory_order_release);
+    return 0;
+}
+
+void ChunkRegistry::remove(const void *pChunk)
+{
+    uint64_t uIndex = (uintptr_t)pChunk >> kChunkShift;
+    auto pLeaf = s_arrLeaves[uIndex >> kLeafBits].load(std::memory_order_acquire);
+    if (pLeaf != nullptr)
+    {
+        uint64_t uBit = uIndex & ((1ULL << kLeafBits) - 1);
+        pLeaf[uBit / 64].fetch_and(~(1ULL << (uBit % 64)), std::memory_order_release);
+    }
+}
+
+PageHeap::~PageHeap()
+{
+    stopScavenger();
+    if (m_pArena != nullptr)
+    {
+        for (uint64_t i = 0; i < m_vecArenaChunkUsed.size(); i++)
+        {
+            if (m_vecArenaChunkUsed[i])
+            {
+                ChunkRegistry::remove(m_pArena + i * kChunkSize);
+            }
+        }
+        munmap(m_pArena, m_uArenaSize);
+        return;
+    }
+
+    while (m_pChunks != nullptr)
+    {
+        auto pChunk = m_pChunks;
+        unlinkChunk(m_pChunks, pChunk);
+        unmapChunk(pChunk);
+    }
+
+    while (m_pHugeChunks != nullptr)
+    {
+        auto pChunk = m_pHugeChunks;
+        unlinkChunk(m_pHugeChunks, pChunk);
+        unmapChunk(pChunk);
+    }
+}
+
+int32_t PageHeap::init(const IAllocator::Config *pConfig, int32_t iNumaNode)
+{
+    if (unlikely(iNumaNode < IAllocator::kNumaNodeLocal))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return -1;
+    }
+
+#ifdef LLDK_OS_LINUX
+    int32_t iNumaNodeCount = getNumaNodeCount();
+    if (unlikely(iNumaNode >= iNumaNodeCount))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return -1;
+    }
+    m_iNumaNode = iNumaNodeCount > 1 ? iNumaNode : IAllocator::kNumaNodeAny;
+#else
+    if (unlikely(iNumaNode > 0))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return -1;
+    }
+#endif
+
+    // the pre-faulted or locked memory is meant to stay resident, madvise fails on locked pages anyway
+    if (unlikely(pConfig->uScavengeIdleMs != 0 && (pConfig->uFlags & (IAllocator::kConfigPrefault | IAllocator::kConfigLock)) != 0))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return -1;
+    }
+
+    m_bHugePage = (pConfig->uFlags & IAllocator::kConfigHugePage) != 0;
+    if (pConfig->uMaxSizeMB == 0)
+    {
+        if (unlikely((pConfig->uFlags & (IAllocator::kConfigPrefault | IAllocator::kConfigLock)) != 0))
+        {
+            lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+            return -1;
+        }
+        return 0;
+    }
+
+    uint64_t uArenaSize = LLDK_ALIGN_BASE(pConfig->uMaxSizeMB << 20, kChunkSize);
+    int32_t iFlags = 0;
+#ifdef MAP_POPULATE
+    if ((pConfig->uFlags & IAllocator::kConfigPrefault) != 0)
+    {
+        iFlags |= MAP_POPULATE;
+    }
+#endif
+#ifdef MAP_NORESERVE
+    if ((pConfig->uFlags & (IAllocator::kConfigPrefault | IAllocator::kConfigLock)) == 0)
+    {
+        iFlags |= MAP_NORESERVE;
+    }
+#endif
+
+    bool bHugeTlb = false;
+    auto pArena = (uint8_t *)mapMemory(uArenaSize, iFlags, &bHugeTlb);
+    if (unlikely(pArena == nullptr))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+        return -1;
+    }
+
+    // pages populated before the binding are migrated by it
+    bindMemory(pArena, uArenaSize);
+
+#ifndef MAP_POPULATE
+    if ((pConfig->uFlags & IAllocator::kConfigPrefault) != 0)
+    {
+        uint64_t uSystemPageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+        for (uint64_t uOffset = 0; uOffset < uArenaSize; uOffset += uSystemPageSize)
+        {
+            LLDK_ACCESS_ONCE(pArena[uOffset]) = 0;
+        }
+    }
+#endif
+
+    if ((pConfig->uFlags & IAllocator::kConfigLock) != 0 && unlikely(mlock(pArena, uArenaSize) != 0))
+    {
+        munmap(pArena, uArenaSize);
+        lldkSetErrorCode(lldk::ErrorCode::kSystemCallError);
+        return -1;
+    }
+
+    try
+    {
+        m_vecArenaChunkUsed.assign(uArenaSize / kChunkSize, false);
+    }
+    catch (...)
+    {
+        munmap(pArena, uArenaSize);
+        lldkSetErrorCode(lldk::ErrorCode::kThrowException);
+        return -1;
+    }
+
+    m_pArena = pArena;
+    m_uArenaSize = uArenaSize;
+    m_bArenaHugeTlb = bHugeTlb;
+    return 0;
+}
+
+void *PageHeap::allocateArena(uint64_t uChunkCount)
+{
+    // first fit, the arena is only walked when a new chunk is needed
+    uint64_t uTotalCount = m_vecArenaChunkUsed.size();
+    uint64_t uRunLength = 0;
+    for (uint64_t i = 0; i < uTotalCount; i++)
+    {
+        uRunLength = m_vecArenaChunkUsed[i] ? 0 : uRunLength + 1;
+        if (uRunLength == uChunkCount)
+        {
+            uint64_t uFirst = i + 1 - uChunkCount;
+            for (uint64_t j = uFirst; j <= i; j++)
+            {
+                m_vecArenaChunkUsed[j] = true;
+            }
+            return m_pArena + uFirst * kChunkSize;
+        }
+    }
+
+    return nullptr;
+}
+
+void PageHeap::freeArena(void *pMemory, uint64_t uChunkCount)
+{
+    uint64_t uFirst = (uint64_t)((uint8_t *)pMemory - m_pArena) / kChunkSize;
+    for (uint64_t j = uFirst; j < uFirst + uChunkCount; j++)
+    {
+        m_vecArenaChunkUsed[j] = false;
+    }
+}
+
+ChunkHeader *PageHeap::mapChunk(uint64_t uMapSize)
+{
+    void *pMemory = nullptr;
+    bool bHugeTlb = false;
+    if (m_pArena != nullptr)
+    {
+        uMapSize = LLDK_ALIGN_BASE(uMapSize, kChunkSize);
+        pMemory = allocateArena(uMapSize / kChunkSize);
+        bHugeTlb = m_bArenaHugeTlb;
+    }
+    else
+    {
+        uMapSize = LLDK_ALIGN_BASE(uMapSize, m_bHugePage ? kChunkSize : (uint64_t)sysconf(_SC_PAGESIZE));
+        pMemory = mapMemory(uMapSize, 0, &bHugeTlb);
+        if (likely(pMemory != nullptr))
+        {
+            bindMemory(pMemory, uMapSize);
+        }
+    }
+
+    if (likely(pMemory != nullptr) && unlikely(ChunkRegistry::add(pMemory) != 0))
+    {
+        if (m_pArena != nullptr)
+        {
+            freeArena(pMemory, uMapSize / kChunkSize);
+        }
+        else
+        {
+            munmap(pMemory, uMapSize);
+        }
+        pMemory = nullptr;
+    }
+
+    if (unlikely(pMemory == nullptr))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+        return nullptr;
+    }
+
+    auto pChunk = (ChunkHeader *)pMemory;
+    pChunk->uMagic = ChunkHeader::kMagic;
+    pChunk->pOwner = this;
+    pChunk->uMapSize = uMapSize;
+    pChunk->uFreePageMask = 0;
+    pChunk->uFlags = bHugeTlb ? ChunkHeader::kFlagHugeTlb : 0;
+    pChunk->uScavengedMask = 0;
+    pChunk->pPrev = pChunk->pNext = nullptr;
+
+    m_uMappedSize += uMapSize;
+    if (bHugeTlb)
+    {
+        m_uHugeTlbSize += uMapSize;
+    }
+    return pChunk;
+}
+
+ChunkHeader *PageHeap::mapEmptyChunk()
+{
+    auto pChunk = mapChunk(kChunkSize);
+    if (unlikely(pChunk == nullptr))
+    {
+        return nullptr;
+    }
+
+    pChunk->uFreePageMask = kAllPagesFreeMask;
+    uint64_t uNowMs = lldkGetClockMonotonicMs();
+    for (uint32_t i = 0; i < kPagesPerChunk; i++)
+    {
+        pChunk->arrFreeMs[i] = uNowMs;
+    }
+    linkChunk(m_pChunks, pChunk);
+    m_uEmptyChunkCount++;
+    return pChunk;
+}
+
+void PageHeap::unmapChunk(ChunkHeader *pChunk)
+{
+    m_uScavengedSize -= (uint64_t)__builtin_popcount(pChunk->uScavengedMask) << kPageShift;
+    m_uMappedSize -= pChunk->uMapSize;
+    if ((pChunk->uFlags & ChunkHeader::kFlagHugeTlb) != 0)
+    {
+        m_uHugeTlbSize -= pChunk->uMapSize;
+    }
+
+    pChunk->uMagic = 0;
+    ChunkRegistry::remove(pChunk);
+    if (m_pArena != nullptr)
+    {
+        freeArena(pChunk, pChunk->uMapSize / kChunkSize);
+        return;
+    }
+    munmap(pChunk, pChunk->uMapSize);
+}
+
+#ifdef LLDK_OS_LINUX
+/**
+ * @brief Sum the AnonHugePages of /proc/self/smaps that fall into the ranges
+ * @param vecRanges The sorted address ranges
+ * @return The bytes size, a mapping only partly covered by the ranges is counted pro rata
+ */
+static uint64_t getTransparentHugeSize(const std::vector<std::pair<uintptr_t, uintptr_t>> &vecRanges)
+{
+    auto pFile = fopen("/proc/self/smaps", "r");
+    if (unlikely(pFile == nullptr))
+    {
+        return 0;
+    }
+
+    uint64_t uTotalSize = 0;
+    unsigned long long uBegin = 0, uEnd = 0, uHugeKB = 0;
+    char arrLine[512];
+    while (fgets(arrLine, sizeof(arrLine), pFile) != nullptr)
+    {
+        unsigned long long uLineBegin = 0, uLineEnd = 0;
+        if (sscanf(arrLine, "%llx-%llx ", &uLineBegin, &uLineEnd) == 2)
+        {
+            uBegin = uLineBegin;
+            uEnd = uLineEnd;
+            continue;
+        }
+
+        if (sscanf(arrLine, "AnonHugePages: %llu kB", &uHugeKB) != 1 || uHugeKB == 0 || uEnd <= uBegin)
+        {
+            continue;
+        }
+
+        uint64_t uOverlapSize = 0;
+        for (auto &range : vecRanges)
+        {
+            uintptr_t uOverlapBegin = range.first > uBegin ? range.first : (uintptr_t)uBegin;
+            uintptr_t uOverlapEnd = range.second < uEnd ? range.second : (uintptr_t)uEnd;
+            if (uOverlapBegin < uOverlapEnd)
+            {
+                uOverlapSize += uOverlapEnd - uOverlapBegin;
+            }
+        }
+        uTotalSize += (uint64_t)((double)(uHugeKB << 10) * uOverlapSize / (uEnd - uBegin));
+    }
+
+    fclose(pFile);
+    return uTotalSize;
+}
+#endif
+
+void PageHeap::getMemoryStats(IAllocator::MemoryStats *pMemoryStats) const
+{
+    std::vector<std::pair<uintptr_t, uintptr_t>> vecRanges;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        pMemoryStats->uReservedSize = m_uArenaSize;
+        pMemoryStats->uMappedSize = m_uMappedSize;
+        pMemoryStats->uHugeTlbSize = m_uHugeTlbSize;
+        pMemoryStats->uTransparentHugeSize = 0;
+        pMemoryStats->uScavengedSize = m_uScavengedSize;
+        pMemoryStats->uTotalScavengedSize = m_uTotalScavengedSize;
+        if (!m_bHugePage || m_uHugeTlbSize == m_uMappedSize)
+        {
+            return;
+        }
+
+        try
+        {
+            if (m_pArena != nullptr)
+            {
+                vecRanges.emplace_back((uintptr_t)m_pArena, (uintptr_t)m_pArena + m_uArenaSize);
+            }
+            else
+            {
+                for (auto pChunk : {m_pChunks, m_pHugeChunks})
+                {
+                    for (; pChunk != nullptr; pChunk = pChunk->pNext)
+                    {
+                        vecRanges.emplace_back((uintptr_t)pChunk, (uintptr_t)pChunk + pChunk->uMapSize);
+                    }
+                }
+            }
+        }
+        catch (...)
+        {
+            return;
+        }
+    }
+
+#ifdef LLDK_OS_LINUX
+    pMemoryStats->uTransparentHugeSize = getTransparentHugeSize(vecRanges);
+#endif
+}
+
+void PageHeap::initSpan(ChunkHeader *pChunk, uint32_t uStartPage, uint32_t uPageCount, uint32_t uSizeClass)
+{
+    for (uint32_t i = uStartPage + 1; i < uStartPage + uPageCount; i++)
+    {
+        pChunk->arrSpans[i].uStartPage = uStartPage;
+    }
+
+    auto pSpan = &pChunk->arrSpans[uStartPage];
+    memset((void *)pSpan, 0, sizeof(Span));
+    pSpan->uStartPage = uStartPage;
+    pSpan->uPageCount = uPageCount;
+    pSpan->uSizeClass = uSizeClass;
+}
+
+Span *PageHeap::allocateSpan(uint32_t uPageCount)
+{
+    if (unlikely(uPageCount == 0 || uPageCount >= kPagesPerChunk))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ChunkHeader *pChunk = m_pChunks;
+    uint32_t uStartPage = kPagesPerChunk;
+    for (; pChunk != nullptr; pChunk = pChunk->pNext)
+    {
+        uStartPage = findFreeRun(pChunk->uFreePageMask, uPageCount);
+        if (uStartPage != kPagesPerChunk)
+        {
+            break;
+        }
+    }
+
+    if (pChunk == nullptr)
+    {
+        pChunk = mapEmptyChunk();
+        if (unlikely(pChunk == nullptr))
+        {
+            return nullptr;
+        }
+        uStartPage = 1;
+    }
+
+    if (pChunk->uFreePageMask == kAllPagesFreeMask)
+    {
+        m_uEmptyChunkCount--;
+    }
+    uint32_t uRunMask = getRunMask(uStartPage, uPageCount);
+    pChunk->uFreePageMask &= ~uRunMask;
+    if (unlikely((pChunk->uScavengedMask & uRunMask) != 0))
+    {
+        m_uScavengedSize -= (uint64_t)__builtin_popcount(pChunk->uScavengedMask & uRunMask) << kPageShift;
+        pChunk->uScavengedMask &= ~uRunMask;
+    }
+    initSpan(pChunk, uStartPage, uPageCount, Span::kSpanFree);
+    return &pChunk->arrSpans[uStartPage];
+}
+
+void PageHeap::freeSpan(Span *pSpan)
+{
+    auto pChunk = getChunk(pSpan);
+
+    uint64_t uNowMs = lldkGetClockMonotonicMs();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    pSpan->uSizeClass = Span::kSpanFree;
+    for (uint32_t i = pSpan->uStartPage; i < pSpan->uStartPage + pSpan->uPageCount; i++)
+    {
+        pChunk->arrFreeMs[i] = uNowMs;
+    }
+    pChunk->uFreePageMask |= getRunMask(pSpan->uStartPage, pSpan->uPageCount);
+    if (pChunk->uFreePageMask == kAllPagesFreeMask)
+    {
+        // keep one empty chunk around so that a span bouncing on a chunk boundary does not remap,
+        // or the empty chunks asked for by reserve
+        if (m_uEmptyChunkCount >= m_uMaxEmptyChunkCount)
+        {
+            unlinkChunk(m_pChunks, pChunk);
+            unmapChunk(pChunk);
+        }
+        else
+        {
+            m_uEmptyChunkCount++;
+        }
+    }
+}
+
+void *PageHeap::allocateLarge(uint64_t uSize)
+{
+    uint64_t uPageCount = (uSize + kPageSize - 1) >> kPageShift;
+    if (uPageCount < kPagesPerChunk)
+    {
+        auto pSpan = allocateSpan((uint32_t)uPageCount);
+        if (unlikely(pSpan == nullptr))
+        {
+            return nullptr;
+        }
+
+        pSpan->uSizeClass = Span::kSpanLarge;
+        pSpan->uLargeSize = uSize;
+        return getSpanAddress(pSpan);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto pChunk = mapChunk(kPageSize + uSize);
+    if (unlikely(pChunk == nullptr))
+    {
+        return nullptr;
+    }
+
+    initSpan(pChunk, 1, 1, Span::kSpanHuge);
+    pChunk->arrSpans[1].uLargeSize = uSize;
+    linkChunk(m_pHugeChunks, pChunk);
+    return (uint8_t *)pChunk + kPageSize;
+}
+
+void PageHeap::freeLarge(Span *pSpan)
+{
+    if (pSpan->uSizeClass == Span::kSpanHuge)
+    {
+        auto pChunk = getChunk(pSpan);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        unlinkChunk(m_pHugeChunks, pChunk);
+        unmapChunk(pChunk);
+        return;
+    }
+
+    freeSpan(pSpan);
+}
+
+void *PageHeap::reAllocateLarge(Span *pSpan, uint64_t uSize)
+{
+    auto pChunk = getChunk(pSpan);
+    uint64_t uPageCount = (uSize + kPageSize - 1) >> kPageShift;
+    if (pSpan->uSizeClass == Span::kSpanHuge)
+    {
+        // a huge block shrunk below a chunk goes back to a span, the copy is bounded by a chunk
+        return uPageCount < kPagesPerChunk ? nullptr : reAllocateHuge(pChunk, uSize);
+    }
+
+    uint32_t uStartPage = pSpan->uStartPage;
+    if (uPageCount >= kPagesPerChunk || uStartPage + uPageCount > kPagesPerChunk)
+    {
+        return nullptr;
+    }
+
+    uint32_t uOldPageCount = pSpan->uPageCount;
+    uint32_t uNewPageCount = (uint32_t)uPageCount;
+    uint64_t uNowMs = lldkGetClockMonotonicMs();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (uNewPageCount > uOldPageCount)
+    {
+        uint32_t uRunMask = getRunMask(uStartPage + uOldPageCount, uNewPageCount - uOldPageCount);
+        if ((pChunk->uFreePageMask & uRunMask) != uRunMask)
+        {
+            return nullptr;
+        }
+
+        pChunk->uFreePageMask &= ~uRunMask;
+        if (unlikely((pChunk->uScavengedMask & uRunMask) != 0))
+        {
+            m_uScavengedSize -= (uint64_t)__builtin_popcount(pChunk->uScavengedMask & uRunMask) << kPageShift;
+            pChunk->uScavengedMask &= ~uRunMask;
+        }
+        for (uint32_t i = uStartPage + uOldPageCount; i < uStartPage + uNewPageCount; i++)
+        {
+            pChunk->arrSpans[i].uStartPage = uStartPage;
+        }
+    }
+    else if (uNewPageCount < uOldPageCount)
+    {
+        for (uint32_t i = uStartPage + uNewPageCount; i < uStartPage + uOldPageCount; i++)
+        {
+            pChunk->arrFreeMs[i] = uNowMs;
+        }
+        pChunk->uFreePageMask |= getRunMask(uStartPage + uNewPageCount, uOldPageCount - uNewPageCount);
+    }
+
+    pSpan->uPageCount = uNewPageCount;
+    pSpan->uLargeSize = uSize;
+    return getSpanAddress(pSpan);
+}
+
+void *PageHeap::reAllocateHuge(ChunkHeader *pChunk, uint64_t uSize)
+{
+    uint64_t uMapSize = kPageSize + uSize;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_pArena != nullptr || (pChunk->uFlags & ChunkHeader::kFlagHugeTlb) != 0)
+    {
+        // the chunks of the arena and the MAP_HUGETLB pages keep their mapping, only its slack is used
+        if (uMapSize > pChunk->uMapSize)
+        {
+            return nullptr;
+        }
+        pChunk->arrSpans[1].uLargeSize = uSize;
+        return (uint8_t *)pChunk + kPageSize;
+    }
+
+#ifdef LLDK_OS_LINUX
+    uMapSize = LLDK_ALIGN_BASE(uMapSize, m_bHugePage ? kChunkSize : (uint64_t)sysconf(_SC_PAGESIZE));
+    uint64_t uOldMapSize = pChunk->uMapSize;
+    if (uMapSize < uOldMapSize)
+    {
+        munmap((uint8_t *)pChunk + uMapSize, uOldMapSize - uMapSize);
+    }
+    else if (uMapSize > uOldMapSize)
+    {
+        // the neighbours link the chunk by its address, which changes if the mapping moves
+        unlinkChunk(m_pHugeChunks, pChunk);
+        auto pNewChunk = mremap(pChunk, uOldMapSize, uMapSize, 0);
+        if (pNewChunk == MAP_FAILED)
+        {
+            // move the page tables to a new chunk aligned range, the bytes are not copied, the
+            // target is registered first so the moved block is never left unowned
+            auto pTarget = mapAligned(uMapSize, kChunkSize, MAP_NORESERVE);
+            pNewChunk = pTarget == nullptr || ChunkRegistry::add(pTarget) != 0
+                            ? MAP_FAILED
+                            : mremap(pChunk, uOldMapSize, uMapSize, MREMAP_MAYMOVE | MREMAP_FIXED, pTarget);
+            if (pNewChunk == MAP_FAILED)
+            {
+                if (pTarget != nullptr)
+                {
+                    ChunkRegistry::remove(pTarget);
+                    munmap(pTarget, uMapSize);
+                }
+                linkChunk(m_pHugeChunks, pChunk);
+                return nullptr;
+            }
+            ChunkRegistry::remove(pChunk);
+        }
+        pChunk = (ChunkHeader *)pNewChunk;
+        linkChunk(m_pHugeChunks, pChunk);
+    }
+
+    m_uMappedSize = m_uMappedSize - uOldMapSize + uMapSize;
+    pChunk->uMapSize = uMapSize;
+    pChunk->arrSpans[1].uLargeSize = uSize;
+    return (uint8_t *)pChunk + kPageSize;
+#else
+    return nullptr;
+#endif
+}
+
+int32_t PageHeap::reserve(uint64_t uSize, uint64_t uCount)
+{
+    uint64_t uPageCount = (uSize + kPageSize - 1) >> kPageShift;
+    if (unlikely(uPageCount == 0 || uPageCount >= kPagesPerChunk))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return -1;
+    }
+
+    uint64_t uBlocksPerChunk = (kPagesPerChunk - 1) / uPageCount;
+    uint64_t uChunkCount = (uCount + uBlocksPerChunk - 1) / uBlocksPerChunk;
+    if (unlikely(uChunkCount > UINT32_MAX))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    while (m_uEmptyChunkCount < uChunkCount)
+    {
+        if (unlikely(mapEmptyChunk() == nullptr))
+        {
+            return -1;
+        }
+    }
+    if (m_uMaxEmptyChunkCount < uChunkCount)
+    {
+        m_uMaxEmptyChunkCount = (uint32_t)uChunkCount;
+    }
+
+    // write a byte of every system page, a MAP_HUGETLB chunk is already backed
+    uint64_t uSystemPageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+    for (auto pChunk = m_pChunks; pChunk != nullptr; pChunk = pChunk->pNext)
+    {
+        if (pChunk->uFreePageMask != kAllPagesFreeMask || (pChunk->uFlags & ChunkHeader::kFlagHugeTlb) != 0)
+        {
+            continue;
+        }
+
+        auto pPages = (volatile uint8_t *)pChunk;
+        for (uint64_t uOffset = kPageSize; uOffset < kChunkSize; uOffset += uSystemPageSize)
+        {
+            pPages[uOffset] = 0;
+        }
+        m_uScavengedSize -= (uint64_t)__builtin_popcount(pChunk->uScavengedMask) << kPageShift;
+        pChunk->uScavengedMask = 0;
+    }
+    return 0;
+}
+
+uint64_t PageHeap::scavenge(uint64_t uIdleMs, uint64_t uMaxSize)
+{
+    // the pages are released under the lock, a span can not be handed out while its pages go away
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t uNowMs = lldkGetClockMonotonicMs();
+    uint64_t uReleasedSize = 0;
+    for (auto pChunk = m_pChunks; pChunk != nullptr && uReleasedSize < uMaxSize; pChunk = pChunk->pNext)
+    {
+        // a MAP_HUGETLB page can not be released in 64KB pieces
+        if ((pChunk->uFlags & ChunkHeader::kFlagHugeTlb) != 0)
+        {
+            continue;
+        }
+
+        uint32_t uCandidateMask = pChunk->uFreePageMask & ~pChunk->uScavengedMask;
+        while (uCandidateMask != 0 && uReleasedSize < uMaxSize)
+        {
+            uint32_t uStartPage = (uint32_t)__builtin_ctz(uCandidateMask);
+            uint32_t uEndPage = uStartPage;
+            while (uEndPage < kPagesPerChunk && (uCandidateMask & (1U << uEndPage)) != 0 &&
+                   uNowMs - pChunk->arrFreeMs[uEndPage] >= uIdleMs)
+            {
+                uEndPage++;
+            }
+
+            if (uEndPage == uStartPage)
+            {
+                uCandidateMask &= ~(1U << uStartPage);
+                continue;
+            }
+
+            uint32_t uRunMask = getRunMask(uStartPage, uEndPage - uStartPage);
+            uint64_t uRunSize = (uint64_t)(uEndPage - uStartPage) << kPageShift;
+            uCandidateMask &= ~uRunMask;
+            if (madvise((uint8_t *)pChunk + ((uint64_t)uStartPage << kPageShift), uRunSize, MADV_DONTNEED) != 0)
+            {
+                continue;
+            }
+
+            pChunk->uScavengedMask |= uRunMask;
+            uReleasedSize += uRunSize;
+        }
+    }
+
+    m_uScavengedSize += uReleasedSize;
+    m_uTotalScavengedSize += uReleasedSize;
+    return uReleasedSize;
+}
+
+void PageHeap::runScavenger(uint32_t uIdleMs)
+{
+    // a pass every half idle period, so a page is returned at most 1.5 idle periods after its free
+    static constexpr uint64_t kMaxScavengeSize = 64ULL << 20;
+    auto period = std::chrono::milliseconds(uIdleMs / 2 > 0 ? uIdleMs / 2 : 1);
+
+    std::unique_lock<std::mutex> lock(m_scavengerMutex);
+    while (!m_scavengerCond.wait_for(lock, period, [this] { return m_bScavengerStop; }))
+    {
+        lock.unlock();
+        scavenge(uIdleMs, kMaxScavengeSize);
+        lock.lock();
+    }
+}
+
+int32_t PageHeap::startScavenger(uint32_t uIdleMs)
+{
+    if (uIdleMs == 0)
+    {
+        return 0;
+    }
+
+    try
+    {
+        m_scavengerThread = std::thread(&PageHeap::runScavenger, this, uIdleMs);
+    }
+    catch (...)
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kThrowException);
+        return -1;
+    }
+    return 0;
+}
+
+void PageHeap::stopScavenger()
+{
+    if (!m_scavengerThread.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_scavengerMutex);
+        m_bScavengerStop = true;
+    }
+    m_scavengerCond.notify_one();
+    m_scavengerThread.join();
+}
+
+}
+}
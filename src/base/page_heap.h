@@ -0,0 +1,295 @@
+#ifndef LLDK_BASE_PAGE_HEAP_H
+#define LLDK_BASE_PAGE_HEAP_H
+
+#include "lldk/common/common.h"
+#include "lldk/base/allocator.h"
+#include "size_class.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lldk
+{
+namespace base
+{
+
+/**
+ * @brief A run of pages inside a chunk
+ * @note every page of a chunk has a span descriptor, only the descriptor of the first page of a run
+ *       is meaningful, the other pages point back to it by uStartPage.
+ */
+struct Span
+{
+    static constexpr uint32_t kSpanFree = 0xFFFFFFFF;  // The span is free
+    static constexpr uint32_t kSpanLarge = 0xFFFFFFFE; // The span holds one large block
+    static constexpr uint32_t kSpanHuge = 0xFFFFFFFD;  // The span holds one huge block in its own mapping
+
+    void *pFreeList;      // The freed objects of the span
+    uint32_t uStartPage;  // The first page of the span in the chunk
+    uint32_t uPageCount;  // The page count of the span
+    uint32_t uSizeClass;  // The size class of the span, or kSpanFree/kSpanLarge/kSpanHuge
+    uint32_t uObjectSize; // The object size of the span
+    uint32_t uCapacity;   // The object count the span can hold
+    uint32_t uUsedCount;  // The object count handed out of the span
+    uint32_t uBumpCount;  // The object count carved from the span so far
+    uint32_t uReserved;
+    uint64_t uLargeSize;  // The block size of a large or huge span
+    uint64_t uAllocateTsc; // The allocation time of a large or huge block, kept for the lifetime histogram
+    std::atomic<void *> pOwner; // The thread cache the objects of the span are returned to, read by the freeing threads
+    Span *pPrev;
+    Span *pNext;
+};
+
+/**
+ * @brief The header in the first page of every chunk
+ */
+struct ChunkHeader
+{
+    static constexpr uint64_t kMagic = 0x6C6C646B6368756BULL; // "lldkchuk"
+
+    uint64_t uMagic;
+    void *pOwner;           // The page heap owns the chunk
+    static constexpr uint32_t kFlagHugeTlb = 1 << 0; // The chunk is mapped with MAP_HUGETLB
+
+    uint64_t uMapSize;      // The mapped bytes of the chunk
+    uint32_t uFreePageMask; // The bit i is set if page i is free
+    uint32_t uFlags;        // The kFlag bits of the chunk
+    uint32_t uScavengedMask; // The bit i is set if free page i was returned to the OS
+    uint32_t uReserved;
+    ChunkHeader *pPrev;
+    ChunkHeader *pNext;
+    Span arrSpans[kPagesPerChunk];
+    uint64_t arrFreeMs[kPagesPerChunk]; // The monotonic time page i was freed, read by the scavenger
+};
+
+static_assert(sizeof(ChunkHeader) <= kPageSize, "ChunkHeader must fit in the first page of a chunk");
+
+/**
+ * @brief The chunks mapped by the page heaps of the process, one bit per chunk address
+ * @note a pointer of another allocator may have nothing mapped at its chunk address, owns looks the
+ *       chunk up here before it reads the header. the bits are a two level radix over the chunk
+ *       addresses, a leaf is mapped on its first chunk and kept for the life of the process.
+ */
+class ChunkRegistry
+{
+public:
+    /**
+     * @brief Register a mapped chunk
+     * @param pChunk The chunk
+     * @return 0 if success, -1 if the leaf of the chunk can not be mapped
+     */
+    static int32_t add(const void *pChunk);
+
+    /**
+     * @brief Unregister a chunk before it is unmapped
+     * @param pChunk The chunk
+     */
+    static void remove(const void *pChunk);
+
+    /**
+     * @brief Check whether a chunk is mapped by a page heap
+     * @param pChunk The chunk address
+     * @return true if the chunk is registered
+     */
+    static LLDK_INLINE bool contains(const void *pChunk)
+    {
+        uint64_t uIndex = (uintptr_t)pChunk >> kChunkShift;
+        if (unlikely(uIndex >= (1ULL << (kRootBits + kLeafBits))))
+        {
+            return false;
+        }
+
+        auto pLeaf = s_arrLeaves[uIndex >> kLeafBits].load(std::memory_order_acquire);
+        if (pLeaf == nullptr)
+        {
+            return false;
+        }
+
+        uint64_t uBit = uIndex & ((1ULL << kLeafBits) - 1);
+        return (pLeaf[uBit / 64].load(std::memory_order_acquire) & (1ULL << (uBit % 64))) != 0;
+    }
+
+private:
+    // 48 bits of user space, 2^27 chunk addresses, a leaf of 2^15 bits is 4KB
+    static constexpr uint32_t kLeafBits = 15;
+    static constexpr uint32_t kRootBits = 48 - kChunkShift - kLeafBits;
+
+    static std::atomic<uint64_t> *getLeaf(uint64_t uIndex);
+
+    static std::atomic<std::atomic<uint64_t> *> s_arrLeaves[1U << kRootBits];
+};
+
+class PageHeap
+{
+public:
+    PageHeap() = default;
+    ~PageHeap();
+
+    PageHeap(const PageHeap &) = delete;
+    PageHeap &operator=(const PageHeap &) = delete;
+
+    /**
+     * @brief Init the page heap
+     * @param pConfig The config of the allocator
+     * @param iNumaNode The NUMA node to bind the memory to, or an IAllocator::NumaNode
+     * @return 0 if success, -1 if failed
+     * @note with a budget the whole arena is reserved here, and pre-faulted or locked if asked.
+     */
+    int32_t init(const IAllocator::Config *pConfig, int32_t iNumaNode);
+
+    /**
+     * @brief Allocate a span of pages
+     * @param uPageCount The page count, must be less than kPagesPerChunk
+     * @return The span, NULL if failed
+     */
+    Span *allocateSpan(uint32_t uPageCount);
+
+    /**
+     * @brief Free a span of pages
+     * @param pSpan The span
+     */
+    void freeSpan(Span *pSpan);
+
+    /**
+     * @brief Allocate a large block, backed by a span or by its own mapping
+     * @param uSize The size of the block, greater than kMaxSmallSize
+     * @return The pointer to the block, NULL if failed
+     */
+    void *allocateLarge(uint64_t uSize);
+
+    /**
+     * @brief Free a large block
+     * @param pSpan The span of the block
+     */
+    void freeLarge(Span *pSpan);
+
+    /**
+     * @brief Resize a large block without copying it
+     * @param pSpan The span of the block
+     * @param uSize The new size of the block, greater than kMaxSmallSize
+     * @return The pointer to the resized block, NULL if it can not be resized in place
+     * @note a span grows into the free pages following it in its chunk and gives back its tail pages
+     *       on a shrink. a huge block is grown with mremap, which moves the pages instead of copying
+     *       them when the mapping can not be extended where it is. NULL sets no error code, the
+     *       caller falls back to allocate and copy.
+     */
+    void *reAllocateLarge(Span *pSpan, uint64_t uSize);
+
+    /**
+     * @brief Keep the empty chunks for the large blocks mapped and faulted in
+     * @param uSize The size of the blocks, greater than kMaxSmallSize and less than a chunk
+     * @param uCount The count of the blocks
+     * @return 0 if success, -1 if failed
+     */
+    int32_t reserve(uint64_t uSize, uint64_t uCount);
+
+    /**
+     * @brief Start the scavenger thread returning the idle free pages to the OS
+     * @param uIdleMs The time a free page stays untouched before it is returned
+     * @return 0 if success, -1 if failed
+     */
+    int32_t startScavenger(uint32_t uIdleMs);
+
+    /**
+     * @brief Return the free pages idle for a while to the OS
+     * @param uIdleMs The time a free page stays untouched before it is returned
+     * @param uMaxSize The bytes size to return at most, bounds the time the lock is held
+     * @return The bytes size returned
+     * @note a span allocated again on returned pages is faulted back in as zeros on first touch.
+     */
+    uint64_t scavenge(uint64_t uIdleMs, uint64_t uMaxSize);
+
+    /**
+     * @brief Get the memory stats of the page heap
+     * @param pMemoryStats The memory stats, output parameter
+     */
+    void getMemoryStats(IAllocator::MemoryStats *pMemoryStats) const;
+
+    /**
+     * @brief Get the address of the first page of the span
+     * @param pSpan The span
+     * @return The address
+     */
+    static LLDK_INLINE void *getSpanAddress(Span *pSpan)
+    {
+        auto pChunk = getChunk(pSpan);
+        return (uint8_t *)pChunk + ((uint64_t)pSpan->uStartPage << kPageShift);
+    }
+
+    /**
+     * @brief Get the chunk of the address
+     * @param pMemory The address inside a chunk
+     * @return The chunk header
+     */
+    static LLDK_INLINE ChunkHeader *getChunk(const void *pMemory)
+    {
+        return (ChunkHeader *)((uintptr_t)pMemory & ~(uintptr_t)(kChunkSize - 1));
+    }
+
+    /**
+     * @brief Get the span of the address
+     * @param pMemory The address returned by the page heap
+     * @return The span
+     */
+    static LLDK_INLINE Span *getSpan(const void *pMemory)
+    {
+        auto pChunk = getChunk(pMemory);
+        uint32_t uPage = (uint32_t)(((uintptr_t)pMemory - (uintptr_t)pChunk) >> kPageShift);
+        return &pChunk->arrSpans[pChunk->arrSpans[uPage].uStartPage];
+    }
+
+    /**
+     * @brief Check whether the address belongs to the page heap
+     * @param pMemory The address
+     * @return true if the address belongs to the page heap
+     */
+    LLDK_INLINE bool owns(const void *pMemory) const
+    {
+        auto pChunk = getChunk(pMemory);
+        return ChunkRegistry::contains(pChunk) && pChunk->uMagic == ChunkHeader::kMagic && pChunk->pOwner == this;
+    }
+
+private:
+    ChunkHeader *mapChunk(uint64_t uMapSize);
+    ChunkHeader *mapEmptyChunk();
+    void unmapChunk(ChunkHeader *pChunk);
+    void *reAllocateHuge(ChunkHeader *pChunk, uint64_t uSize);
+    void *mapMemory(uint64_t uSize, int32_t iFlags, bool *pHugeTlb);
+    void bindMemory(void *pMemory, uint64_t uSize);
+    void *allocateArena(uint64_t uChunkCount);
+    void freeArena(void *pMemory, uint64_t uChunkCount);
+    void initSpan(ChunkHeader *pChunk, uint32_t uStartPage, uint32_t uPageCount, uint32_t uSizeClass);
+    void runScavenger(uint32_t uIdleMs);
+    void stopScavenger();
+
+private:
+    mutable std::mutex m_mutex;
+    ChunkHeader *m_pChunks{nullptr};     // The chunks split into spans
+    ChunkHeader *m_pHugeChunks{nullptr}; // The chunks hold one huge block each
+    uint32_t m_uEmptyChunkCount{0};
+    uint32_t m_uMaxEmptyChunkCount{1}; // The empty chunks kept mapped, raised by reserve
+
+    uint8_t *m_pArena{nullptr};              // The reserved budget, chunks are carved from it if not NULL
+    uint64_t m_uArenaSize{0};
+    bool m_bArenaHugeTlb{false};
+    std::vector<bool> m_vecArenaChunkUsed;   // The bit i is set if chunk i of the arena is used
+
+    bool m_bHugePage{false};
+    int32_t m_iNumaNode{IAllocator::kNumaNodeAny};
+    uint64_t m_uMappedSize{0};
+    uint64_t m_uHugeTlbSize{0};
+    uint64_t m_uScavengedSize{0};      // The free pages returned to the OS and not allocated again
+    uint64_t m_uTotalScavengedSize{0};
+
+    std::thread m_scavengerThread;
+    std::mutex m_scavengerMutex;
+    std::condition_variable m_scavengerCond;
+    bool m_bScavengerStop{false};
+};
+
+}
+}
+
+#endif // LLDK_BASE_PAGE_HEAP_H
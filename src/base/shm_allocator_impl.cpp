@@ -0,0 +1,839 @@
+#include "shm_allocator_impl.h"
+#include "lldk/common/error_code.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace lldk
+{
+namespace base
+{
+
+static constexpr uint64_t kShmHeaderSize = LLDK_ALIGN_BASE(sizeof(ShmHeader), 16);
+
+class ShmAllocatorImpl::LockGuard
+{
+public:
+    explicit LockGuard(const ShmAllocatorImpl *pShmAllocator) : m_pShmAllocator(pShmAllocator)
+    {
+        m_pShmAllocator->lock();
+    }
+
+    ~LockGuard()
+    {
+        m_pShmAllocator->unlock();
+    }
+
+    LockGuard(const LockGuard &) = delete;
+    LockGuard &operator=(const LockGuard &) = delete;
+
+private:
+    const ShmAllocatorImpl *m_pShmAllocator;
+};
+
+ShmAllocatorImpl::ShmAllocatorImpl(const char *pName)
+    : m_sName(pName), m_sShmName(pName[0] == '/' ? std::string(pName) : std::string("/") + pName)
+{
+}
+
+ShmAllocatorImpl::~ShmAllocatorImpl()
+{
+    if (m_pSlot != nullptr)
+    {
+        LockGuard lock(this);
+        if (--m_pSlot->uAttachCount == 0)
+        {
+            m_pSlot->iPid = 0;
+        }
+    }
+
+    if (m_pBase != nullptr)
+    {
+        munmap(m_pBase, m_uMappedSize);
+    }
+}
+
+int32_t ShmAllocatorImpl::map(int32_t iFd, uint64_t uSize)
+{
+    // the region is mapped page aligned, so the large blocks are aligned up to kMaxAlignment
+    auto pReserved = (uint8_t *)mmap(nullptr, uSize + kPageSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (unlikely(pReserved == MAP_FAILED))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kSystemCallError);
+        return -1;
+    }
+
+    auto pBase = (uint8_t *)LLDK_ALIGN_BASE((uintptr_t)pReserved, kPageSize);
+    if (unlikely(mmap(pBase, uSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, iFd, 0) == MAP_FAILED))
+    {
+        munmap(pReserved, uSize + kPageSize);
+        lldkSetErrorCode(lldk::ErrorCode::kSystemCallError);
+        return -1;
+    }
+
+    if (pBase > pReserved)
+    {
+        munmap(pReserved, (uint64_t)(pBase - pReserved));
+    }
+    if (pBase + uSize < pReserved + uSize + kPageSize)
+    {
+        munmap(pBase + uSize, (uint64_t)(pReserved + kPageSize - pBase));
+    }
+
+    m_pBase = pBase;
+    m_uMappedSize = uSize;
+    m_pHeader = (ShmHeader *)pBase;
+    m_pPageMap = (uint32_t *)(pBase + kShmHeaderSize);
+    return 0;
+}
+
+int32_t ShmAllocatorImpl::create(uint64_t uSizeMB)
+{
+    uint64_t uSize = uSizeMB << 20;
+    int32_t iFd = shm_open(m_sShmName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (unlikely(iFd < 0))
+    {
+        lldkSetErrorCode(errno == EEXIST || errno == EINVAL || errno == ENAMETOOLONG ? lldk::ErrorCode::kInvalidParam
+                                                                                      : lldk::ErrorCode::kSystemCallError);
+        return -1;
+    }
+
+    int32_t iRet = ftruncate(iFd, (off_t)uSize) == 0 ? map(iFd, uSize) : -1;
+    close(iFd);
+    if (unlikely(iRet != 0))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kSystemCallError);
+        shm_unlink(m_sShmName.c_str());
+        return -1;
+    }
+
+    // the new region reads as zeros, only the non zero fields are set
+    uint64_t uDataOffset = LLDK_ALIGN_BASE(kShmHeaderSize + (uSize / kPageSize) * sizeof(uint32_t), kPageSize);
+    if (unlikely(uDataOffset + kPageSize > uSize))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        shm_unlink(m_sShmName.c_str());
+        return -1;
+    }
+
+    m_pHeader->uSize = uSize;
+    m_pHeader->uDataOffset = uDataOffset;
+    m_pHeader->uPageCount = (uSize - uDataOffset) / kPageSize;
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    iRet = pthread_mutex_init(&m_pHeader->mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    if (unlikely(iRet != 0 || attachProcess() != 0))
+    {
+        lldkSetErrorCode(iRet != 0 ? lldk::ErrorCode::kSystemCallError : lldk::ErrorCode::kNoMemory);
+        shm_unlink(m_sShmName.c_str());
+        return -1;
+    }
+
+    m_pHeader->uMagic.store(ShmHeader::kMagic, std::memory_order_release);
+    return 0;
+}
+
+int32_t ShmAllocatorImpl::attach()
+{
+    int32_t iFd = shm_open(m_sShmName.c_str(), O_RDWR, 0);
+    if (unlikely(iFd < 0))
+    {
+        lldkSetErrorCode(errno == ENOENT || errno == EINVAL || errno == ENAMETOOLONG ? lldk::ErrorCode::kInvalidParam
+                                                                                      : lldk::ErrorCode::kSystemCallError);
+        return -1;
+    }
+
+    struct stat st;
+    if (unlikely(fstat(iFd, &st) != 0))
+    {
+        close(iFd);
+        lldkSetErrorCode(lldk::ErrorCode::kSystemCallError);
+        return -1;
+    }
+
+    // the creator may not have sized the region yet
+    if (unlikely((uint64_t)st.st_size < kShmHeaderSize + kPageSize))
+    {
+        close(iFd);
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidState);
+        return -1;
+    }
+
+    int32_t iRet = map(iFd, (uint64_t)st.st_size);
+    close(iFd);
+    if (unlikely(iRet != 0))
+    {
+        return -1;
+    }
+
+    if (unlikely(m_pHeader->uMagic.load(std::memory_order_acquire) != ShmHeader::kMagic || m_pHeader->uSize != (uint64_t)st.st_size))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidState);
+        return -1;
+    }
+
+    if (unlikely(attachProcess() != 0))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+        return -1;
+    }
+    return 0;
+}
+
+int32_t ShmAllocatorImpl::attachProcess()
+{
+    LockGuard lock(this);
+    int32_t iPid = (int32_t)getpid();
+    ShmHeader::ProcessSlot *pFreeSlot = nullptr;
+    for (auto &slot : m_pHeader->arrProcesses)
+    {
+        if (slot.iPid == iPid)
+        {
+            slot.uAttachCount++;
+            m_pSlot = &slot;
+            return 0;
+        }
+
+        // the slot of a process died without a detach is taken over
+        if (pFreeSlot == nullptr && (slot.iPid == 0 || (kill(slot.iPid, 0) != 0 && errno == ESRCH)))
+        {
+            pFreeSlot = &slot;
+        }
+    }
+
+    if (unlikely(pFreeSlot == nullptr))
+    {
+        return -1;
+    }
+
+    // the counts of the previous process are kept, so the sums over the slots stay balanced
+    pFreeSlot->iPid = iPid;
+    pFreeSlot->uAttachCount = 1;
+    pFreeSlot->stats.uTid = (uint64_t)iPid;
+    m_pSlot = pFreeSlot;
+    return 0;
+}
+
+void ShmAllocatorImpl::lock() const
+{
+    // the owner died holding the lock, the metadata it was changing is taken as it is
+    if (unlikely(pthread_mutex_lock(&m_pHeader->mutex) == EOWNERDEAD))
+    {
+        pthread_mutex_consistent(&m_pHeader->mutex);
+    }
+}
+
+void ShmAllocatorImpl::unlock() const
+{
+    pthread_mutex_unlock(&m_pHeader->mutex);
+}
+
+uint64_t ShmAllocatorImpl::allocatePages(uint64_t uPageCount)
+{
+    // first fit over the freed runs, then the pages never used
+    uint64_t *pLink = &m_pHeader->uFreeRuns;
+    while (*pLink != 0)
+    {
+        uint64_t uOffset = *pLink;
+        auto pRun = (FreeRun *)getAddress(uOffset);
+        if (pRun->uPageCount >= uPageCount)
+        {
+            uint64_t uNext = pRun->uNext;
+            uint64_t uRestCount = pRun->uPageCount - uPageCount;
+            if (uRestCount == 0)
+            {
+                *pLink = uNext;
+            }
+            else
+            {
+                uint64_t uRestOffset = uOffset + uPageCount * kPageSize;
+                auto pRest = (FreeRun *)getAddress(uRestOffset);
+                pRest->uNext = uNext;
+                pRest->uPageCount = uRestCount;
+                *pLink = uRestOffset;
+            }
+            m_pHeader->uUsedPages += uPageCount;
+            return uOffset;
+        }
+        pLink = &pRun->uNext;
+    }
+
+    if (unlikely(m_pHeader->uNextPage + uPageCount > m_pHeader->uPageCount))
+    {
+        return 0;
+    }
+
+    uint64_t uOffset = m_pHeader->uDataOffset + m_pHeader->uNextPage * kPageSize;
+    m_pHeader->uNextPage += uPageCount;
+    m_pHeader->uUsedPages += uPageCount;
+    return uOffset;
+}
+
+void ShmAllocatorImpl::freePages(uint64_t uOffset, uint64_t uPageCount)
+{
+    m_pHeader->uUsedPages -= uPageCount;
+
+    uint64_t *pLink = &m_pHeader->uFreeRuns;
+    uint64_t uPrevOffset = 0;
+    while (*pLink != 0 && *pLink < uOffset)
+    {
+        uPrevOffset = *pLink;
+        pLink = &((FreeRun *)getAddress(uPrevOffset))->uNext;
+    }
+
+    auto pRun = (FreeRun *)getAddress(uOffset);
+    pRun->uNext = *pLink;
+    pRun->uPageCount = uPageCount;
+    if (pRun->uNext != 0 && uOffset + uPageCount * kPageSize == pRun->uNext)
+    {
+        auto pNextRun = (FreeRun *)getAddress(pRun->uNext);
+        pRun->uPageCount += pNextRun->uPageCount;
+        pRun->uNext = pNextRun->uNext;
+    }
+
+    if (uPrevOffset != 0)
+    {
+        auto pPrevRun = (FreeRun *)getAddress(uPrevOffset);
+        if (uPrevOffset + pPrevRun->uPageCount * kPageSize == uOffset)
+        {
+            pPrevRun->uPageCount += pRun->uPageCount;
+            pPrevRun->uNext = pRun->uNext;
+            return;
+        }
+    }
+    *pLink = uOffset;
+}
+
+uint64_t ShmAllocatorImpl::allocateLocked(uint64_t uBlockSize, uint64_t *pAllocatedSize)
+{
+    if (likely(uBlockSize <= kMaxSmallSize))
+    {
+        uint32_t uSizeClass = SizeClass::getSizeClass(uBlockSize);
+        uint64_t uClassSize = SizeClass::getClassSize(uSizeClass);
+        auto &classList = m_pHeader->arrClasses[uSizeClass];
+        uint64_t uOffset = classList.uFreeList;
+        if (uOffset != 0)
+        {
+            classList.uFreeList = *(uint64_t *)getAddress(uOffset);
+        }
+        else
+        {
+            if (classList.uCursor + uClassSize > classList.uEnd)
+            {
+                uint32_t uSpanPages = SizeClass::getSpanPages(uSizeClass);
+                uint64_t uSpanOffset = allocatePages(uSpanPages);
+                if (unlikely(uSpanOffset == 0))
+                {
+                    return 0;
+                }
+
+                uint64_t uPageIndex = (uSpanOffset - m_pHeader->uDataOffset) >> kPageShift;
+                for (uint32_t i = 0; i < uSpanPages; i++)
+                {
+                    m_pPageMap[uPageIndex + i] = kPageSmall | (i << kPageIndexShift) | uSizeClass;
+                }
+                classList.uCursor = uSpanOffset;
+                classList.uEnd = uSpanOffset + uSpanPages * kPageSize;
+            }
+
+            uOffset = classList.uCursor;
+            classList.uCursor += uClassSize;
+        }
+
+        *pAllocatedSize = uClassSize;
+        return uOffset;
+    }
+
+    // the rounding below wraps near the top of the range, the batches and reserve come here unchecked
+    if (unlikely(uBlockSize > kMaxAllocateSize))
+    {
+        return 0;
+    }
+
+    uint64_t uPageCount = (uBlockSize + kPageSize - 1) >> kPageShift;
+    if (unlikely(uPageCount > kPageValueMask))
+    {
+        return 0;
+    }
+
+    uint64_t uOffset = allocatePages(uPageCount);
+    if (unlikely(uOffset == 0))
+    {
+        return 0;
+    }
+
+    m_pPageMap[(uOffset - m_pHeader->uDataOffset) >> kPageShift] = kPageLarge | (uint32_t)uPageCount;
+    *pAllocatedSize = uPageCount * kPageSize;
+    return uOffset;
+}
+
+uint64_t ShmAllocatorImpl::getBlockSize(void *pMemory) const
+{
+    uint64_t uOffset = toOffset(pMemory);
+    if (unlikely(uOffset < m_pHeader->uDataOffset))
+    {
+        return 0;
+    }
+
+    uint32_t uEntry = m_pPageMap[(uOffset - m_pHeader->uDataOffset) >> kPageShift];
+    if (uEntry & kPageSmall)
+    {
+        // only the start of an object carved from the span is a block, a pointer inside one is not
+        uint32_t uSizeClass = uEntry & kPageClassMask;
+        uint64_t uClassSize = SizeClass::getClassSize(uSizeClass);
+        uint64_t uPageInSpan = (uEntry & kPageValueMask) >> kPageIndexShift;
+        uint64_t uSpanOffset = (uOffset & ~(kPageSize - 1)) - uPageInSpan * kPageSize;
+        uint64_t uObjectCount = SizeClass::getSpanPages(uSizeClass) * kPageSize / uClassSize;
+        uint64_t uObjectOffset = uOffset - uSpanOffset;
+        if (uObjectOffset % uClassSize != 0 || uObjectOffset / uClassSize >= uObjectCount)
+        {
+            return 0;
+        }
+        return uClassSize;
+    }
+
+    if ((uEntry & kPageLarge) && (uOffset & (kPageSize - 1)) == 0)
+    {
+        return (uint64_t)(uEntry & kPageValueMask) * kPageSize;
+    }
+    return 0;
+}
+
+int32_t ShmAllocatorImpl::freeLocked(void *pMemory, uint64_t *pFreedSize)
+{
+    uint64_t uSize = getBlockSize(pMemory);
+    if (unlikely(uSize == 0))
+    {
+        return -1;
+    }
+
+    uint64_t uOffset = toOffset(pMemory);
+    uint64_t uPageIndex = (uOffset - m_pHeader->uDataOffset) >> kPageShift;
+    if (m_pPageMap[uPageIndex] & kPageSmall)
+    {
+        auto &classList = m_pHeader->arrClasses[m_pPageMap[uPageIndex] & kPageClassMask];
+        *(uint64_t *)pMemory = classList.uFreeList;
+        classList.uFreeList = uOffset;
+    }
+    else
+    {
+        m_pPageMap[uPageIndex] = 0;
+        freePages(uOffset, uSize >> kPageShift);
+    }
+
+    *pFreedSize = uSize;
+    return 0;
+}
+
+void *ShmAllocatorImpl::allocate(uint64_t uSize)
+{
+    if (unlikely(uSize > kMaxAllocateSize))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+        return nullptr;
+    }
+
+    LockGuard lock(this);
+    uint64_t uAllocatedSize = 0;
+    uint64_t uOffset = allocateLocked(uSize, &uAllocatedSize);
+    if (unlikely(uOffset == 0))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+        return nullptr;
+    }
+
+    m_pSlot->stats.uAllocatedSize += uAllocatedSize;
+    m_pSlot->stats.uAllocatedCount++;
+    return getAddress(uOffset);
+}
+
+void ShmAllocatorImpl::free(void *pMemory)
+{
+    if (unlikely(toOffset(pMemory) == kNullOffset))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return;
+    }
+
+    LockGuard lock(this);
+    uint64_t uFreedSize = 0;
+    if (unlikely(freeLocked(pMemory, &uFreedSize) != 0))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return;
+    }
+
+    m_pSlot->stats.uFreedSize += uFreedSize;
+    m_pSlot->stats.uFreedCount++;
+}
+
+void *ShmAllocatorImpl::allocateAligned(uint64_t uSize, uint64_t uAlign)
+{
+    if (unlikely(uAlign == 0 || (uAlign & (uAlign - 1)) != 0 || uAlign > kMaxAlignment))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return nullptr;
+    }
+
+    if (unlikely(uSize > kMaxAllocateSize))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+        return nullptr;
+    }
+
+    // the spans and the large blocks start on a page boundary, as in the process allocator
+    uint64_t uBlockSize = LLDK_ALIGN_BASE(uSize > 0 ? uSize : 1, uAlign);
+    if (uBlockSize <= kMaxSmallSize)
+    {
+        uint32_t uSizeClass = SizeClass::getSizeClass(uBlockSize);
+        while (SizeClass::getClassSize(uSizeClass) % uAlign != 0)
+        {
+            uSizeClass++;
+        }
+        uBlockSize = SizeClass::getClassSize(uSizeClass);
+    }
+    return allocate(uBlockSize);
+}
+
+void ShmAllocatorImpl::free(void *pMemory, uint64_t uSize)
+{
+    // the page map is read under the lock anyway, the size saves nothing
+    (void)uSize;
+    free(pMemory);
+}
+
+uint64_t ShmAllocatorImpl::allocateBatch(uint64_t uSize, uint64_t uCount, void **ppMemory)
+{
+    if (unlikely(ppMemory == nullptr && uCount > 0))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return 0;
+    }
+
+    LockGuard lock(this);
+    uint64_t uAllocatedSize = 0;
+    uint64_t uTotalSize = 0;
+    uint64_t uAllocated = 0;
+    for (; uAllocated < uCount; uAllocated++)
+    {
+        uint64_t uOffset = allocateLocked(uSize, &uAllocatedSize);
+        if (unlikely(uOffset == 0))
+        {
+            lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+            break;
+        }
+        ppMemory[uAllocated] = getAddress(uOffset);
+        uTotalSize += uAllocatedSize;
+    }
+
+    m_pSlot->stats.uAllocatedSize += uTotalSize;
+    m_pSlot->stats.uAllocatedCount += uAllocated;
+    return uAllocated;
+}
+
+void ShmAllocatorImpl::freeBatch(void **ppMemory, uint64_t uCount)
+{
+    if (unlikely(ppMemory == nullptr && uCount > 0))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return;
+    }
+
+    LockGuard lock(this);
+    uint64_t uFreedSize = 0;
+    for (uint64_t i = 0; i < uCount; i++)
+    {
+        uint64_t uSize = 0;
+        if (unlikely(freeLocked(ppMemory[i], &uSize) != 0))
+        {
+            lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+            continue;
+        }
+        m_pSlot->stats.uFreedCount++;
+        uFreedSize += uSize;
+    }
+    m_pSlot->stats.uFreedSize += uFreedSize;
+}
+
+void *ShmAllocatorImpl::reAllocate(void *pMemory, uint64_t uSize)
+{
+    if (unlikely(pMemory == nullptr))
+    {
+        return allocate(uSize);
+    }
+
+    if (unlikely(uSize > kMaxAllocateSize))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+        return nullptr;
+    }
+
+    LockGuard lock(this);
+    uint64_t uOldSize = getBlockSize(pMemory);
+    if (unlikely(uOldSize == 0))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return nullptr;
+    }
+
+    // a block of the same size class or page count is kept in place
+    uint64_t uNewSize = uSize <= kMaxSmallSize ? SizeClass::getClassSize(SizeClass::getSizeClass(uSize))
+                                               : LLDK_ALIGN_BASE(uSize, kPageSize);
+    if (uNewSize == uOldSize)
+    {
+        return pMemory;
+    }
+
+    uint64_t uOffset = allocateLocked(uSize, &uNewSize);
+    if (unlikely(uOffset == 0))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+        return nullptr;
+    }
+
+    void *pNewMemory = getAddress(uOffset);
+    memcpy(pNewMemory, pMemory, uOldSize < uSize ? uOldSize : uSize);
+    freeLocked(pMemory, &uOldSize);
+
+    m_pSlot->stats.uAllocatedSize += uNewSize;
+    m_pSlot->stats.uAllocatedCount++;
+    m_pSlot->stats.uFreedSize += uOldSize;
+    m_pSlot->stats.uFreedCount++;
+    return pNewMemory;
+}
+
+uint64_t ShmAllocatorImpl::getUsableSize(void *pMemory) const
+{
+    if (unlikely(toOffset(pMemory) == kNullOffset))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return 0;
+    }
+
+    LockGuard lock(this);
+    uint64_t uSize = getBlockSize(pMemory);
+    if (unlikely(uSize == 0))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+    }
+    return uSize;
+}
+
+int32_t ShmAllocatorImpl::reserve(uint64_t uSize, uint64_t uCount)
+{
+    // the blocks are carved and written, chained by their first word, then freed to the region, a
+    // small block lands on the free list of its class and a large one on the free runs
+    LockGuard lock(this);
+    uint64_t uChain = 0;
+    uint64_t uReserved = 0;
+    for (; uReserved < uCount; uReserved++)
+    {
+        uint64_t uAllocatedSize = 0;
+        uint64_t uOffset = allocateLocked(uSize, &uAllocatedSize);
+        if (unlikely(uOffset == 0))
+        {
+            break;
+        }
+
+        auto pMemory = getAddress(uOffset);
+        memset(pMemory, 0, uAllocatedSize);
+        *(uint64_t *)pMemory = uChain;
+        uChain = uOffset;
+    }
+
+    while (uChain != 0)
+    {
+        auto pMemory = getAddress(uChain);
+        uChain = *(uint64_t *)pMemory;
+        uint64_t uFreedSize = 0;
+        freeLocked(pMemory, &uFreedSize);
+    }
+
+    if (unlikely(uReserved < uCount))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+        return -1;
+    }
+    return 0;
+}
+
+const char *ShmAllocatorImpl::getName() const
+{
+    return m_sName.c_str();
+}
+
+int32_t ShmAllocatorImpl::getAllocateStats(IAllocator::AllocateStats *pAllocateStats, uint32_t *pThreadCount) const
+{
+    if (unlikely(pAllocateStats == nullptr || pThreadCount == nullptr))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return -1;
+    }
+
+    // one entry per process ever attached, uTid is its process id
+    LockGuard lock(this);
+    uint32_t uCount = 0;
+    for (auto &slot : m_pHeader->arrProcesses)
+    {
+        if (slot.stats.uTid != 0 && uCount < *pThreadCount)
+        {
+            pAllocateStats[uCount++] = slot.stats;
+        }
+    }
+    *pThreadCount = uCount;
+    return 0;
+}
+
+int32_t ShmAllocatorImpl::getMemoryStats(IAllocator::MemoryStats *pMemoryStats) const
+{
+    if (unlikely(pMemoryStats == nullptr))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return -1;
+    }
+
+    LockGuard lock(this);
+    memset(pMemoryStats, 0, sizeof(*pMemoryStats));
+    pMemoryStats->uReservedSize = m_pHeader->uSize;
+    pMemoryStats->uMappedSize = m_pHeader->uUsedPages * kPageSize;
+    return 0;
+}
+
+int32_t ShmAllocatorImpl::getAllocateHistogram(IAllocator::AllocateHistogram *pHistogram) const
+{
+    (void)pHistogram;
+    lldkSetErrorCode(lldk::ErrorCode::kInvalidState);
+    return -1;
+}
+
+int32_t ShmAllocatorImpl::setSampleInterval(uint64_t uSampleInterval)
+{
+    // a stack of another process means nothing here, no stack is sampled
+    (void)uSampleInterval;
+    lldkSetErrorCode(lldk::ErrorCode::kInvalidCall);
+    return -1;
+}
+
+int32_t ShmAllocatorImpl::dumpHeapProfile(const char *pFileName, IAllocator::ProfileFormat eFormat) const
+{
+    (void)pFileName;
+    (void)eFormat;
+    lldkSetErrorCode(lldk::ErrorCode::kInvalidCall);
+    return -1;
+}
+
+uint64_t ShmAllocatorImpl::toOffset(const void *pMemory) const
+{
+    auto pAddress = (const uint8_t *)pMemory;
+    return pAddress > m_pBase && pAddress < m_pBase + m_uMappedSize ? (uint64_t)(pAddress - m_pBase) : kNullOffset;
+}
+
+void *ShmAllocatorImpl::fromOffset(uint64_t uOffset) const
+{
+    return uOffset != kNullOffset && uOffset < m_uMappedSize ? getAddress(uOffset) : nullptr;
+}
+
+void ShmAllocatorImpl::setRootOffset(uint64_t uOffset)
+{
+    m_pHeader->uRootOffset.store(uOffset, std::memory_order_release);
+}
+
+uint64_t ShmAllocatorImpl::getRootOffset() const
+{
+    return m_pHeader->uRootOffset.load(std::memory_order_acquire);
+}
+
+}
+}
+
+static lldk::base::IShmAllocator *newShmAllocator(const char *pName, uint64_t uSizeMB)
+{
+    auto pAllocatorSingleton = lldkGetAllocatorSingleton();
+    if (unlikely(pAllocatorSingleton == nullptr))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+        return nullptr;
+    }
+
+    lldk::base::ShmAllocatorImpl *pShmAllocator = nullptr;
+    try
+    {
+        pShmAllocator = pAllocatorSingleton->newObject<lldk::base::ShmAllocatorImpl>(pName);
+    }
+    catch (...)
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kThrowException);
+        return nullptr;
+    }
+
+    if (unlikely(pShmAllocator == nullptr))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+        return nullptr;
+    }
+
+    if (unlikely((uSizeMB > 0 ? pShmAllocator->create(uSizeMB) : pShmAllocator->attach()) != 0))
+    {
+        pAllocatorSingleton->deleteObject(pShmAllocator);
+        return nullptr;
+    }
+    return pShmAllocator;
+}
+
+lldk::base::IShmAllocator *lldkCreateShmAllocator(const char *pName, uint64_t uSizeMB)
+{
+    if (unlikely(pName == nullptr || pName[0] == '\0' || uSizeMB == 0 || uSizeMB > (UINT64_MAX >> 21)))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return nullptr;
+    }
+
+    return newShmAllocator(pName, uSizeMB);
+}
+
+lldk::base::IShmAllocator *lldkAttachShmAllocator(const char *pName)
+{
+    if (unlikely(pName == nullptr || pName[0] == '\0'))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return nullptr;
+    }
+
+    return newShmAllocator(pName, 0);
+}
+
+void lldkDestroyShmAllocator(lldk::base::IShmAllocator *pShmAllocator)
+{
+    auto pAllocatorSingleton = lldkGetAllocatorSingleton();
+    if (unlikely(pShmAllocator == nullptr || pAllocatorSingleton == nullptr))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return;
+    }
+
+    pAllocatorSingleton->deleteObject(static_cast<lldk::base::ShmAllocatorImpl *>(pShmAllocator));
+}
+
+int32_t lldkUnlinkShmAllocator(const char *pName)
+{
+    if (unlikely(pName == nullptr || pName[0] == '\0'))
+    {
+        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
+        return -1;
+    }
+
+    std::string sShmName = pName[0] == '/' ? std::string(pName) : std::string("/") + pName;
+    if (unlikely(shm_unlink(sShmName.c_str()) != 0))
+    {
+        lldkSetErrorCode(errno == ENOENT ? lldk::ErrorCode::kInvalidParam : lldk::ErrorCode::kSystemCallError);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,140 @@
+#ifndef LLDK_BASE_SHM_ALLOCATOR_IMPL_H
+#define LLDK_BASE_SHM_ALLOCATOR_IMPL_H
+
+#include "lldk/base/shm_allocator.h"
+#include "size_class.h"
+#include <atomic>
+#include <pthread.h>
+#include <string>
+
+namespace lldk
+{
+namespace base
+{
+
+/**
+ * @brief The layout of a shared memory region
+ * @note the header, then the page map of a uint32_t per page, then the pages from uDataOffset.
+ *       every link inside the region is an offset from its start, 0 is the null link.
+ */
+struct ShmHeader
+{
+    static constexpr uint64_t kMagic = 0x4C4C444B53484D32ULL; // "LLDKSHM2"
+    static constexpr uint32_t kMaxProcessCount = 64;
+
+    struct ClassList
+    {
+        uint64_t uFreeList; // The freed objects linked by the offset in their first word
+        uint64_t uCursor;   // The next never used object of the newest span
+        uint64_t uEnd;
+    };
+
+    struct ProcessSlot
+    {
+        int32_t iPid;          // The attached process, 0 if the slot is free
+        uint32_t uAttachCount; // The allocators of the process attached through the slot
+        IAllocator::AllocateStats stats; // uTid is the last process, kept for the sums after a detach
+    };
+
+    std::atomic<uint64_t> uMagic; // Stored last by the creator, the region is ready once it is set
+    uint64_t uSize;               // The bytes size of the region
+    uint64_t uDataOffset;         // The offset of the first page
+    uint64_t uPageCount;
+    pthread_mutex_t mutex;        // Robust and process shared
+    std::atomic<uint64_t> uRootOffset;
+    uint64_t uNextPage;  // The pages from here on were never used
+    uint64_t uUsedPages; // The pages handed out to spans and large blocks
+    uint64_t uFreeRuns;  // The freed page runs, sorted by offset
+    ClassList arrClasses[kSizeClassCount];
+    ProcessSlot arrProcesses[kMaxProcessCount];
+};
+
+class ShmAllocatorImpl : public IShmAllocator
+{
+public:
+    ShmAllocatorImpl(const char *pName);
+    ~ShmAllocatorImpl() override;
+
+    void *allocate(uint64_t uSize) override;
+    void free(void *pMemory) override;
+    void *allocateAligned(uint64_t uSize, uint64_t uAlign) override;
+    void free(void *pMemory, uint64_t uSize) override;
+    uint64_t allocateBatch(uint64_t uSize, uint64_t uCount, void **ppMemory) override;
+    void freeBatch(void **ppMemory, uint64_t uCount) override;
+    void *reAllocate(void *pMemory, uint64_t uSize) override;
+    uint64_t getUsableSize(void *pMemory) const override;
+    int32_t reserve(uint64_t uSize, uint64_t uCount) override;
+    const char *getName() const override;
+    int32_t getAllocateStats(IAllocator::AllocateStats *pAllocateStats, uint32_t *pThreadCount) const override;
+    int32_t getMemoryStats(IAllocator::MemoryStats *pMemoryStats) const override;
+    int32_t getAllocateHistogram(IAllocator::AllocateHistogram *pHistogram) const override;
+    int32_t setSampleInterval(uint64_t uSampleInterval) override;
+    int32_t dumpHeapProfile(const char *pFileName, IAllocator::ProfileFormat eFormat) const override;
+
+    uint64_t toOffset(const void *pMemory) const override;
+    void *fromOffset(uint64_t uOffset) const override;
+    void setRootOffset(uint64_t uOffset) override;
+    uint64_t getRootOffset() const override;
+
+    /**
+     * @brief Create the region and format it
+     * @param uSizeMB The size of the region, in MB
+     * @return 0 if success, -1 if failed
+     */
+    int32_t create(uint64_t uSizeMB);
+
+    /**
+     * @brief Attach to the existing region
+     * @return 0 if success, -1 if failed
+     */
+    int32_t attach();
+
+private:
+    // a page map entry is 0 for a free page, the size class and the index of the page in its span
+    // for a page of a small span, or the page count on the first page of a large block
+    static constexpr uint32_t kPageSmall = 1U << 31;
+    static constexpr uint32_t kPageLarge = 1U << 30;
+    static constexpr uint32_t kPageValueMask = kPageLarge - 1;
+    static constexpr uint32_t kPageIndexShift = 8;
+    static constexpr uint32_t kPageClassMask = (1U << kPageIndexShift) - 1;
+    static_assert(kSizeClassCount <= kPageClassMask + 1, "the size class must fit below the page index");
+
+    struct FreeRun
+    {
+        uint64_t uNext;
+        uint64_t uPageCount;
+    };
+
+    class LockGuard;
+
+    LLDK_INLINE uint8_t *getAddress(uint64_t uOffset) const
+    {
+        return m_pBase + uOffset;
+    }
+
+    int32_t map(int32_t iFd, uint64_t uSize);
+    int32_t attachProcess();
+    void lock() const;
+    void unlock() const;
+
+    // the methods below are called with the lock held
+    uint64_t allocateLocked(uint64_t uBlockSize, uint64_t *pAllocatedSize);
+    int32_t freeLocked(void *pMemory, uint64_t *pFreedSize);
+    uint64_t getBlockSize(void *pMemory) const;
+    uint64_t allocatePages(uint64_t uPageCount);
+    void freePages(uint64_t uOffset, uint64_t uPageCount);
+
+private:
+    std::string m_sName;
+    std::string m_sShmName;
+    uint8_t *m_pBase{nullptr};
+    uint64_t m_uMappedSize{0};
+    ShmHeader *m_pHeader{nullptr};
+    uint32_t *m_pPageMap{nullptr};
+    ShmHeader::ProcessSlot *m_pSlot{nullptr};
+};
+
+}
+}
+
+#endif // LLDK_BASE_SHM_ALLOCATOR_IMPL_H
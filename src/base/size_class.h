@@ -0,0 +1,102 @@
+#ifndef LLDK_BASE_SIZE_CLASS_H
+#define LLDK_BASE_SIZE_CLASS_H
+
+#include "lldk/common/common.h"
+
+namespace lldk
+{
+namespace base
+{
+
+/**
+ * @brief The layout constants of the slab engine
+ * @note memory is mapped in chunks aligned to kChunkSize, the first page of every chunk holds the
+ *       chunk header, so the metadata of any block is found by masking its address.
+ */
+static constexpr uint32_t kPageShift = 16;
+static constexpr uint64_t kPageSize = 1ULL << kPageShift;
+static constexpr uint32_t kChunkShift = 21;
+static constexpr uint64_t kChunkSize = 1ULL << kChunkShift;
+static constexpr uint32_t kPagesPerChunk = (uint32_t)(kChunkSize / kPageSize);
+
+static constexpr uint64_t kMinAlignment = 16;
+static constexpr uint64_t kMaxSmallSize = 32 * 1024;
+// no mapping can be larger than the user address space, a size checked against it is rounded up
+// to pages, chunks or an alignment without wrapping
+static constexpr uint64_t kMaxAllocateSize = 1ULL << 48;
+static constexpr uint32_t kSizeClassCount = 40;
+
+/**
+ * @brief The size classes of the slab engine
+ * @note sizes up to 128 bytes are spaced 16 bytes apart, above that every power of two is split
+ *       into four classes, e.g. 160, 192, 224, 256, 320, ... 32768. every class size is a multiple
+ *       of kMinAlignment and every power of two class is naturally aligned.
+ */
+class SizeClass
+{
+public:
+    /**
+     * @brief Get the size class of the size
+     * @param uSize The size, must be less than or equal to kMaxSmallSize
+     * @return The size class
+     */
+    static LLDK_INLINE uint32_t getSizeClass(uint64_t uSize)
+    {
+        if (uSize <= 128)
+        {
+            return uSize == 0 ? 0 : (uint32_t)((uSize - 1) >> 4);
+        }
+
+        uint32_t uShift = 63 - (uint32_t)__builtin_clzll(uSize - 1);
+        return 8 + ((uShift - 7) << 2) + (uint32_t)((uSize - 1 - (1ULL << uShift)) >> (uShift - 2));
+    }
+
+    /**
+     * @brief Get the object size of the size class
+     * @param uSizeClass The size class
+     * @return The object size
+     */
+    static LLDK_INLINE uint32_t getClassSize(uint32_t uSizeClass)
+    {
+        if (uSizeClass < 8)
+        {
+            return (uSizeClass + 1) << 4;
+        }
+
+        uint32_t uIndex = uSizeClass - 8;
+        uint32_t uShift = 7 + (uIndex >> 2);
+        return (1U << uShift) + (((uIndex & 3) + 1) << (uShift - 2));
+    }
+
+    /**
+     * @brief Get the object count moved between a thread cache and the central free list at once
+     * @param uSizeClass The size class
+     * @return The batch count
+     */
+    static LLDK_INLINE uint32_t getBatchCount(uint32_t uSizeClass)
+    {
+        uint32_t uCount = (uint32_t)(kPageSize / getClassSize(uSizeClass));
+        return uCount < 2 ? 2 : (uCount > 64 ? 64 : uCount);
+    }
+
+    /**
+     * @brief Get the page count of the span of the size class
+     * @param uSizeClass The size class
+     * @return The page count, chosen so that the tail waste of a span is at most 1/8
+     */
+    static uint32_t getSpanPages(uint32_t uSizeClass)
+    {
+        uint64_t uClassSize = getClassSize(uSizeClass);
+        uint32_t uPages = 1;
+        while ((uPages * kPageSize) % uClassSize > (uPages * kPageSize) / 8)
+        {
+            uPages++;
+        }
+        return uPages;
+    }
+};
+
+}
+}
+
+#endif // LLDK_BASE_SIZE_CLASS_H
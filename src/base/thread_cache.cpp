@@ -0,0 +1,232 @@
+#include "thread_cache.h"
+#include <cmath>
+#include <thread>
+
+namespace lldk
+{
+namespace base
+{
+
+ThreadCache::ThreadCache()
+{
+    for (uint32_t i = 0; i < kSizeClassCount; i++)
+    {
+        m_arrMagazines[i].pHead = nullptr;
+        m_arrMagazines[i].uLength = 0;
+        m_arrRemoteFrees[i].store(nullptr, std::memory_order_relaxed);
+        m_arrRemoteCounts[i].store(0, std::memory_order_relaxed);
+    }
+    reset();
+}
+
+void ThreadCache::reset()
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_stats.uTid = lldkGetTid();
+    memset(&m_histogram, 0, sizeof(m_histogram));
+    m_iBytesUntilSample = 0;
+    m_uRandomState = (uint64_t)m_stats.uTid * 0x9E3779B97F4A7C15ULL + (uint64_t)(uintptr_t)this;
+    m_uRandomState = m_uRandomState != 0 ? m_uRandomState : 1;
+
+    for (uint32_t i = 0; i < kSizeClassCount; i++)
+    {
+        m_arrMagazines[i].uMaxLength = SizeClass::getBatchCount(i) * 2;
+    }
+    m_bRetired.store(false);
+}
+
+void ThreadCache::retire(CentralFreeList *pCentralFreeLists)
+{
+    // a pusher counts itself before it reads the flag, the cache reads the count after it sets the flag,
+    // so a push either sees the flag and frees locally, or is waited for and drained below
+    m_bRetired.store(true);
+    while (m_iRemotePushers.load() != 0)
+    {
+        std::this_thread::yield();
+    }
+
+    for (uint32_t i = 0; i < kSizeClassCount; i++)
+    {
+        while (m_arrMagazines[i].uLength > 0)
+        {
+            flush(i, pCentralFreeLists);
+        }
+        m_arrMagazines[i].pHead = nullptr;
+        drainRemote(i, pCentralFreeLists);
+    }
+}
+
+void *ThreadCache::refill(uint32_t uSizeClass, CentralFreeList *pCentralFreeLists)
+{
+    auto &magazine = m_arrMagazines[uSizeClass];
+    uint32_t uCount = 0;
+    void *pHead = takeRemote(uSizeClass, &uCount);
+    if (pHead == nullptr)
+    {
+        uCount = pCentralFreeLists[uSizeClass].removeRange(&pHead, SizeClass::getBatchCount(uSizeClass), this);
+        if (unlikely(uCount == 0))
+        {
+            return nullptr;
+        }
+    }
+
+    magazine.pHead = *(void **)pHead;
+    magazine.uLength = uCount - 1;
+    return pHead;
+}
+
+uint64_t ThreadCache::allocateBatch(uint32_t uSizeClass, uint64_t uCount, void **ppMemory, CentralFreeList *pCentralFreeLists)
+{
+    auto &magazine = m_arrMagazines[uSizeClass];
+    uint64_t uAllocated = 0;
+    while (uAllocated < uCount)
+    {
+        // drain the magazine, then one refill brings a whole batch under one lock
+        void *pObject = magazine.pHead;
+        while (pObject != nullptr && uAllocated < uCount)
+        {
+            ppMemory[uAllocated++] = pObject;
+            pObject = *(void **)pObject;
+            magazine.uLength--;
+        }
+        magazine.pHead = pObject;
+
+        if (uAllocated == uCount || (pObject = refill(uSizeClass, pCentralFreeLists)) == nullptr)
+        {
+            break;
+        }
+        ppMemory[uAllocated++] = pObject;
+    }
+    return uAllocated;
+}
+
+uint32_t ThreadCache::reserve(uint32_t uSizeClass, uint32_t uCount, CentralFreeList *pCentralFreeLists)
+{
+    // room for the objects and the rest of the last refill, so putting them back does not flush
+    auto &magazine = m_arrMagazines[uSizeClass];
+    uint32_t uMaxLength = uCount + SizeClass::getBatchCount(uSizeClass);
+    if (magazine.uMaxLength < uMaxLength)
+    {
+        magazine.uMaxLength = uMaxLength;
+    }
+
+    // take the objects out and write them, the ones already cached included, then put them back
+    uint64_t uClassSize = SizeClass::getClassSize(uSizeClass);
+    void *pHead = nullptr;
+    uint32_t uTaken = 0;
+    for (; uTaken < uCount; uTaken++)
+    {
+        void *pObject = allocate(uSizeClass, pCentralFreeLists);
+        if (unlikely(pObject == nullptr))
+        {
+            break;
+        }
+        memset(pObject, 0, uClassSize);
+        *(void **)pObject = pHead;
+        pHead = pObject;
+    }
+
+    while (pHead != nullptr)
+    {
+        void *pNext = *(void **)pHead;
+        free(pHead, uSizeClass, pCentralFreeLists);
+        pHead = pNext;
+    }
+    return magazine.uLength;
+}
+
+void ThreadCache::flush(uint32_t uSizeClass, CentralFreeList *pCentralFreeLists)
+{
+    auto &magazine = m_arrMagazines[uSizeClass];
+    uint32_t uCount = SizeClass::getBatchCount(uSizeClass);
+    if (uCount > magazine.uLength)
+    {
+        uCount = magazine.uLength;
+    }
+
+    void *pHead = magazine.pHead;
+    void *pTail = pHead;
+    for (uint32_t i = 1; i < uCount; i++)
+    {
+        pTail = *(void **)pTail;
+    }
+
+    magazine.pHead = *(void **)pTail;
+    magazine.uLength -= uCount;
+    *(void **)pTail = nullptr;
+    pCentralFreeLists[uSizeClass].insertRange(pHead, uCount);
+
+    // the thread frees more of the class than it allocates, what others freed to it is not needed either
+    drainRemote(uSizeClass, pCentralFreeLists);
+}
+
+int64_t ThreadCache::getSampleDistance(uint64_t uSampleInterval)
+{
+    // xorshift64, then the exponential distribution, the distance between the points of a poisson process
+    m_uRandomState ^= m_uRandomState << 13;
+    m_uRandomState ^= m_uRandomState >> 7;
+    m_uRandomState ^= m_uRandomState << 17;
+    double dUniform = (double)((m_uRandomState >> 11) + 1) * (1.0 / 9007199254740992.0);
+    double dDistance = -log(dUniform) * (double)uSampleInterval;
+    return dDistance < (double)INT64_MAX / 2 ? (int64_t)dDistance : INT64_MAX / 2;
+}
+
+bool ThreadCache::pushRemote(uint32_t uSizeClass, void *pMemory, CentralFreeList *pCentralFreeLists)
+{
+    m_iRemotePushers.fetch_add(1);
+    if (unlikely(m_bRetired.load()))
+    {
+        m_iRemotePushers.fetch_sub(1, std::memory_order_release);
+        return false;
+    }
+
+    auto &remoteFrees = m_arrRemoteFrees[uSizeClass];
+    void *pHead = remoteFrees.load(std::memory_order_relaxed);
+    do
+    {
+        *(void **)pMemory = pHead;
+    } while (!remoteFrees.compare_exchange_weak(pHead, pMemory, std::memory_order_release, std::memory_order_relaxed));
+
+    // the owner may never allocate the class again, a full batch goes to the central free list
+    if (unlikely(m_arrRemoteCounts[uSizeClass].fetch_add(1, std::memory_order_relaxed) + 1 >=
+                 (int32_t)SizeClass::getBatchCount(uSizeClass)))
+    {
+        drainRemote(uSizeClass, pCentralFreeLists);
+    }
+
+    m_iRemotePushers.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+void *ThreadCache::takeRemote(uint32_t uSizeClass, uint32_t *pCount)
+{
+    auto &remoteFrees = m_arrRemoteFrees[uSizeClass];
+    if (remoteFrees.load(std::memory_order_relaxed) == nullptr)
+    {
+        *pCount = 0;
+        return nullptr;
+    }
+
+    void *pHead = remoteFrees.exchange(nullptr, std::memory_order_acquire);
+    uint32_t uCount = 0;
+    for (void *pObject = pHead; pObject != nullptr; pObject = *(void **)pObject)
+    {
+        uCount++;
+    }
+    m_arrRemoteCounts[uSizeClass].fetch_sub((int32_t)uCount, std::memory_order_relaxed);
+    *pCount = uCount;
+    return pHead;
+}
+
+void ThreadCache::drainRemote(uint32_t uSizeClass, CentralFreeList *pCentralFreeLists)
+{
+    uint32_t uCount = 0;
+    void *pHead = takeRemote(uSizeClass, &uCount);
+    if (pHead != nullptr)
+    {
+        pCentralFreeLists[uSizeClass].insertRange(pHead, uCount);
+    }
+}
+
+}
+}
@@ -0,0 +1,216 @@
+#ifndef LLDK_BASE_THREAD_CACHE_H
+#define LLDK_BASE_THREAD_CACHE_H
+
+#include "lldk/base/allocator.h"
+#include "central_free_list.h"
+#include <atomic>
+
+namespace lldk
+{
+namespace base
+{
+
+/**
+ * @brief The per thread state of an allocator
+ * @note every size class has a magazine, a free list refilled from and flushed to the central free
+ *       list in batches. an object freed on a thread other than the owner of its span is pushed to
+ *       the lock free remote free list of the owner, which takes the whole list back on its next
+ *       refill. once a list holds a batch, the pushing thread hands it to the central free list, so
+ *       an owner no longer allocating the class does not strand the objects.
+ */
+class ThreadCache
+{
+public:
+    ThreadCache();
+    ~ThreadCache() = default;
+
+    ThreadCache(const ThreadCache &) = delete;
+    ThreadCache &operator=(const ThreadCache &) = delete;
+
+    /**
+     * @brief Allocate an object
+     * @param uSizeClass The size class
+     * @param pCentralFreeLists The central free lists of the allocator
+     * @return The pointer to the object, NULL if failed
+     */
+    LLDK_INLINE void *allocate(uint32_t uSizeClass, CentralFreeList *pCentralFreeLists)
+    {
+        auto &magazine = m_arrMagazines[uSizeClass];
+        void *pObject = magazine.pHead;
+        if (likely(pObject != nullptr))
+        {
+            magazine.pHead = *(void **)pObject;
+            magazine.uLength--;
+            return pObject;
+        }
+
+        return refill(uSizeClass, pCentralFreeLists);
+    }
+
+    /**
+     * @brief Allocate many objects of a size class
+     * @param uSizeClass The size class
+     * @param uCount The object count
+     * @param ppMemory The pointers to the objects, output parameter
+     * @param pCentralFreeLists The central free lists of the allocator
+     * @return The object count allocated, less than uCount if failed
+     */
+    uint64_t allocateBatch(uint32_t uSizeClass, uint64_t uCount, void **ppMemory, CentralFreeList *pCentralFreeLists);
+
+    /**
+     * @brief Fill the magazine of a size class with objects whose pages are faulted in
+     * @param uSizeClass The size class
+     * @param uCount The object count the magazine holds afterwards
+     * @param pCentralFreeLists The central free lists of the allocator
+     * @return The object count in the magazine, less than uCount if failed
+     * @note the magazine keeps room for uCount objects from then on, a free does not flush them.
+     */
+    uint32_t reserve(uint32_t uSizeClass, uint32_t uCount, CentralFreeList *pCentralFreeLists);
+
+    /**
+     * @brief Free an object
+     * @param pMemory The pointer to the object
+     * @param pSpan The span of the object
+     * @param pCentralFreeLists The central free lists of the allocator
+     */
+    LLDK_INLINE void free(void *pMemory, Span *pSpan, CentralFreeList *pCentralFreeLists)
+    {
+        auto pOwner = static_cast<ThreadCache *>(pSpan->pOwner.load(std::memory_order_acquire));
+        if (unlikely(pOwner != this && pOwner != nullptr) && pOwner->pushRemote(pSpan->uSizeClass, pMemory, pCentralFreeLists))
+        {
+            return;
+        }
+
+        free(pMemory, pSpan->uSizeClass, pCentralFreeLists);
+    }
+
+    /**
+     * @brief Free an object to the magazine of the thread, without looking at its span
+     * @param pMemory The pointer to the object
+     * @param uSizeClass The size class of the object
+     * @param pCentralFreeLists The central free lists of the allocator
+     * @note the object of a span owned by another thread reaches the central free list on a flush.
+     */
+    LLDK_INLINE void free(void *pMemory, uint32_t uSizeClass, CentralFreeList *pCentralFreeLists)
+    {
+        auto &magazine = m_arrMagazines[uSizeClass];
+        *(void **)pMemory = magazine.pHead;
+        magazine.pHead = pMemory;
+        if (unlikely(++magazine.uLength > magazine.uMaxLength))
+        {
+            flush(uSizeClass, pCentralFreeLists);
+        }
+    }
+
+    /**
+     * @brief Get the allocate stats of the thread
+     * @return The allocate stats
+     */
+    LLDK_INLINE IAllocator::AllocateStats &getStats()
+    {
+        return m_stats;
+    }
+
+    LLDK_INLINE const IAllocator::AllocateStats &getStats() const
+    {
+        return m_stats;
+    }
+
+    /**
+     * @brief Count the allocated bytes towards the next sample of the heap profiler
+     * @param uSize The allocated bytes size
+     * @param uSampleInterval The mean bytes between two samples
+     * @return true if the allocation is sampled
+     */
+    LLDK_INLINE bool sample(uint64_t uSize, uint64_t uSampleInterval)
+    {
+        m_iBytesUntilSample -= (int64_t)uSize;
+        if (likely(m_iBytesUntilSample >= 0))
+        {
+            return false;
+        }
+
+        m_iBytesUntilSample = getSampleDistance(uSampleInterval);
+        return true;
+    }
+
+    /**
+     * @brief Get the allocate histogram of the thread
+     * @return The allocate histogram
+     */
+    LLDK_INLINE IAllocator::AllocateHistogram &getHistogram()
+    {
+        return m_histogram;
+    }
+
+    LLDK_INLINE const IAllocator::AllocateHistogram &getHistogram() const
+    {
+        return m_histogram;
+    }
+
+    /**
+     * @brief Refuse the remote frees and return the cached objects and the objects freed by other threads
+     *        to the central free lists, called when the thread exits
+     * @param pCentralFreeLists The central free lists of the allocator
+     * @note the spans keep pointing to the cache, the later frees of other threads go to their own
+     *       magazines until a new thread takes the cache over.
+     */
+    void retire(CentralFreeList *pCentralFreeLists);
+
+    /**
+     * @brief Reset the stats, the histogram and the magazine limits for a new thread taking the cache over
+     */
+    void reset();
+
+    /**
+     * @brief Get the next cache of the free list of the allocator
+     * @return The next cache
+     */
+    LLDK_INLINE ThreadCache *getNextFree() const
+    {
+        return m_pNextFree;
+    }
+
+    /**
+     * @brief Set the next cache of the free list of the allocator
+     * @param pNextFree The next cache
+     */
+    LLDK_INLINE void setNextFree(ThreadCache *pNextFree)
+    {
+        m_pNextFree = pNextFree;
+    }
+
+private:
+    struct Magazine
+    {
+        void *pHead;
+        uint32_t uLength;
+        uint32_t uMaxLength;
+    };
+
+    void *refill(uint32_t uSizeClass, CentralFreeList *pCentralFreeLists);
+    void flush(uint32_t uSizeClass, CentralFreeList *pCentralFreeLists);
+    bool pushRemote(uint32_t uSizeClass, void *pMemory, CentralFreeList *pCentralFreeLists);
+    void *takeRemote(uint32_t uSizeClass, uint32_t *pCount);
+    void drainRemote(uint32_t uSizeClass, CentralFreeList *pCentralFreeLists);
+    int64_t getSampleDistance(uint64_t uSampleInterval);
+
+private:
+    IAllocator::AllocateStats m_stats;
+    IAllocator::AllocateHistogram m_histogram;
+    int64_t m_iBytesUntilSample{0}; // The allocated bytes left before the next sample
+    uint64_t m_uRandomState;
+    ThreadCache *m_pNextFree{nullptr}; // The next cache left by an exited thread
+    Magazine m_arrMagazines[kSizeClassCount];
+    // written by other threads, keep it off the cachelines of the magazines
+    char m_arrPadding[LLDK_CACHELINE_SIZE];
+    std::atomic<void *> m_arrRemoteFrees[kSizeClassCount];
+    std::atomic<int32_t> m_arrRemoteCounts[kSizeClassCount]; // The object counts of the remote free lists, may lag
+    std::atomic<int32_t> m_iRemotePushers{0}; // The threads inside pushRemote
+    std::atomic<bool> m_bRetired{false};      // Set while the cache has no thread
+};
+
+}
+}
+
+#endif // LLDK_BASE_THREAD_CACHE_H
@@ -0,0 +1,520 @@
+#include "lldk/base/allocator.h"
+#include "lldk/common/common.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <malloc.h>
+#include <mutex>
+#include <new>
+#include <unistd.h>
+
+namespace lldk
+{
+namespace base
+{
+
+/**
+ * @brief The memory handed out while the thread is already inside the override
+ * @note the allocator allocates its singleton, thread caches and thread local tables with operator
+ *       new or malloc, which comes back here. those nested allocations are carved from a static
+ *       region in power of 2 classes, a freed block is kept on the list of its class and reused,
+ *       so the tables of the exiting threads do not drain the region.
+ */
+static constexpr uint64_t kBootstrapSize = 64ULL << 20;
+static constexpr uint64_t kBootstrapHeaderSize = 16; // The header kept right before the block
+static constexpr uint64_t kBootstrapMinShift = 4;
+static constexpr uint32_t kBootstrapClassCount = 23; // The blocks of 16B to 64MB
+static constexpr uint32_t kBootstrapNoClass = kBootstrapClassCount; // An over-aligned block, never reused
+
+struct BootstrapHeader
+{
+    uint64_t uSize;  // The requested size
+    uint64_t uClass; // The class of the block, kBootstrapNoClass if it is not reused
+};
+static_assert(sizeof(BootstrapHeader) == kBootstrapHeaderSize, "the header must keep the block 16 bytes aligned");
+
+alignas(IAllocator::kMaxAlignment) static uint8_t s_arrBootstrap[kBootstrapSize];
+static uint64_t s_uBootstrapOffset = 0;
+static void *s_arrBootstrapFreeLists[kBootstrapClassCount] = {};
+static std::mutex s_bootstrapMutex;
+
+static std::atomic<IAllocator *> s_pAllocator {nullptr};
+static thread_local bool s_bInOverride __attribute__((tls_model("initial-exec"))) = false;
+
+/**
+ * @brief Mark the thread as inside the override for the scope
+ */
+class OverrideGuard
+{
+public:
+    OverrideGuard() : m_bNested(s_bInOverride)
+    {
+        s_bInOverride = true;
+    }
+
+    ~OverrideGuard()
+    {
+        s_bInOverride = m_bNested;
+    }
+
+    OverrideGuard(const OverrideGuard &) = delete;
+    OverrideGuard &operator=(const OverrideGuard &) = delete;
+
+    LLDK_INLINE bool isNested() const
+    {
+        return m_bNested;
+    }
+
+private:
+    bool m_bNested;
+};
+
+static LLDK_INLINE bool isBootstrap(const void *pMemory)
+{
+    return (const uint8_t *)pMemory >= s_arrBootstrap && (const uint8_t *)pMemory < s_arrBootstrap + kBootstrapSize;
+}
+
+static LLDK_INLINE BootstrapHeader *getBootstrapHeader(void *pMemory)
+{
+    return (BootstrapHeader *)((uint8_t *)pMemory - kBootstrapHeaderSize);
+}
+
+static void *allocateBootstrap(uint64_t uSize, uint64_t uAlign)
+{
+    if (unlikely(uSize > kBootstrapSize))
+    {
+        return nullptr;
+    }
+
+    uint32_t uClass = 0;
+    while (((1ULL << kBootstrapMinShift) << uClass) < uSize)
+    {
+        uClass++;
+    }
+    uint64_t uBlockSize = (1ULL << kBootstrapMinShift) << uClass;
+
+    // a block of a class is only 16 bytes aligned, an over-aligned request is bumped and never reused
+    if (uAlign > kBootstrapHeaderSize)
+    {
+        uClass = kBootstrapNoClass;
+        uBlockSize = LLDK_ALIGN16(uSize);
+    }
+    else
+    {
+        uAlign = kBootstrapHeaderSize;
+    }
+
+    std::lock_guard<std::mutex> lock(s_bootstrapMutex);
+    void *pMemory = uClass != kBootstrapNoClass ? s_arrBootstrapFreeLists[uClass] : nullptr;
+    if (pMemory != nullptr)
+    {
+        s_arrBootstrapFreeLists[uClass] = *(void **)pMemory;
+    }
+    else
+    {
+        uint64_t uBlockOffset = LLDK_ALIGN_BASE(s_uBootstrapOffset + kBootstrapHeaderSize, uAlign);
+        if (unlikely(uBlockOffset + uBlockSize > kBootstrapSize))
+        {
+            return nullptr;
+        }
+        s_uBootstrapOffset = uBlockOffset + uBlockSize;
+        pMemory = s_arrBootstrap + uBlockOffset;
+    }
+
+    auto pHeader = getBootstrapHeader(pMemory);
+    pHeader->uSize = uSize;
+    pHeader->uClass = uClass;
+    return pMemory;
+}
+
+static void freeBootstrap(void *pMemory)
+{
+    auto pHeader = getBootstrapHeader(pMemory);
+    if (unlikely(pHeader->uClass == kBootstrapNoClass))
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(s_bootstrapMutex);
+    *(void **)pMemory = s_arrBootstrapFreeLists[pHeader->uClass];
+    s_arrBootstrapFreeLists[pHeader->uClass] = pMemory;
+}
+
+static LLDK_INLINE IAllocator *getAllocator()
+{
+    auto pAllocator = s_pAllocator.load(std::memory_order_acquire);
+    if (unlikely(pAllocator == nullptr))
+    {
+        pAllocator = lldkGetAllocatorSingleton();
+        s_pAllocator.store(pAllocator, std::memory_order_release);
+    }
+    return pAllocator;
+}
+
+static void *allocateMemory(uint64_t uSize, uint64_t uAlign)
+{
+    OverrideGuard guard;
+    if (unlikely(guard.isNested()))
+    {
+        return allocateBootstrap(uSize, uAlign);
+    }
+
+    auto pAllocator = getAllocator();
+    if (unlikely(pAllocator == nullptr))
+    {
+        return allocateBootstrap(uSize, uAlign);
+    }
+    return uAlign <= IAllocator::kDefaultAlignment ? pAllocator->allocate(uSize) : pAllocator->allocateAligned(uSize, uAlign);
+}
+
+static void freeMemory(void *pMemory)
+{
+    if (unlikely(pMemory == nullptr))
+    {
+        return;
+    }
+
+    if (unlikely(isBootstrap(pMemory)))
+    {
+        freeBootstrap(pMemory);
+        return;
+    }
+
+    OverrideGuard guard;
+    getAllocator()->free(pMemory);
+}
+
+#ifdef __cpp_sized_deallocation
+
+static void freeMemory(void *pMemory, uint64_t uSize)
+{
+    if (unlikely(pMemory == nullptr))
+    {
+        return;
+    }
+
+    if (unlikely(isBootstrap(pMemory)))
+    {
+        freeBootstrap(pMemory);
+        return;
+    }
+
+    OverrideGuard guard;
+    getAllocator()->free(pMemory, uSize);
+}
+
+#endif // __cpp_sized_deallocation
+
+static void *allocateOrThrow(uint64_t uSize, uint64_t uAlign)
+{
+    void *pMemory = nullptr;
+    while (unlikely((pMemory = allocateMemory(uSize, uAlign)) == nullptr))
+    {
+        auto pNewHandler = std::get_new_handler();
+        if (pNewHandler == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        pNewHandler();
+    }
+    return pMemory;
+}
+
+static void *allocateNoThrow(uint64_t uSize, uint64_t uAlign) noexcept
+{
+    try
+    {
+        return allocateOrThrow(uSize, uAlign);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+#ifdef LLDK_OVERRIDE_MALLOC
+
+static uint64_t getUsableSize(void *pMemory)
+{
+    if (pMemory == nullptr)
+    {
+        return 0;
+    }
+
+    if (isBootstrap(pMemory))
+    {
+        return getBootstrapHeader(pMemory)->uSize;
+    }
+
+    // a pointer the allocator does not own, e.g. one freed by another malloc, reports 0
+    return getAllocator()->getUsableSize(pMemory);
+}
+
+static void *reAllocateMemory(void *pMemory, uint64_t uSize)
+{
+    if (isBootstrap(pMemory))
+    {
+        uint64_t uOldSize = getUsableSize(pMemory);
+        void *pNewMemory = allocateMemory(uSize, 0);
+        if (likely(pNewMemory != nullptr))
+        {
+            memcpy(pNewMemory, pMemory, uOldSize < uSize ? uOldSize : uSize);
+            freeBootstrap(pMemory);
+        }
+        return pNewMemory;
+    }
+
+    OverrideGuard guard;
+    return getAllocator()->reAllocate(pMemory, uSize);
+}
+
+static void *allocateAlignedMemory(uint64_t uAlign, uint64_t uSize)
+{
+    if (unlikely(uAlign == 0 || (uAlign & (uAlign - 1)) != 0 || uAlign > IAllocator::kMaxAlignment))
+    {
+        errno = EINVAL;
+        return nullptr;
+    }
+
+    void *pMemory = allocateMemory(uSize, uAlign);
+    if (unlikely(pMemory == nullptr))
+    {
+        errno = ENOMEM;
+    }
+    return pMemory;
+}
+
+#endif // LLDK_OVERRIDE_MALLOC
+
+}
+}
+
+using lldk::base::allocateNoThrow;
+using lldk::base::allocateOrThrow;
+using lldk::base::freeMemory;
+
+LLDK_EXPORT void *operator new(size_t uSize)
+{
+    return allocateOrThrow(uSize, 0);
+}
+
+LLDK_EXPORT void *operator new[](size_t uSize)
+{
+    return allocateOrThrow(uSize, 0);
+}
+
+LLDK_EXPORT void *operator new(size_t uSize, const std::nothrow_t &) noexcept
+{
+    return allocateNoThrow(uSize, 0);
+}
+
+LLDK_EXPORT void *operator new[](size_t uSize, const std::nothrow_t &) noexcept
+{
+    return allocateNoThrow(uSize, 0);
+}
+
+LLDK_EXPORT void operator delete(void *pMemory) noexcept
+{
+    freeMemory(pMemory);
+}
+
+LLDK_EXPORT void operator delete[](void *pMemory) noexcept
+{
+    freeMemory(pMemory);
+}
+
+LLDK_EXPORT void operator delete(void *pMemory, const std::nothrow_t &) noexcept
+{
+    freeMemory(pMemory);
+}
+
+LLDK_EXPORT void operator delete[](void *pMemory, const std::nothrow_t &) noexcept
+{
+    freeMemory(pMemory);
+}
+
+#ifdef __cpp_sized_deallocation
+
+LLDK_EXPORT void operator delete(void *pMemory, size_t uSize) noexcept
+{
+    freeMemory(pMemory, uSize);
+}
+
+LLDK_EXPORT void operator delete[](void *pMemory, size_t uSize) noexcept
+{
+    freeMemory(pMemory, uSize);
+}
+
+#endif // __cpp_sized_deallocation
+
+#ifdef __cpp_aligned_new
+
+// the sized free of the allocator can not take an over-aligned block, so the aligned deletes drop the size
+
+LLDK_EXPORT void *operator new(size_t uSize, std::align_val_t eAlign)
+{
+    return allocateOrThrow(uSize, (uint64_t)eAlign);
+}
+
+LLDK_EXPORT void *operator new[](size_t uSize, std::align_val_t eAlign)
+{
+    return allocateOrThrow(uSize, (uint64_t)eAlign);
+}
+
+LLDK_EXPORT void *operator new(size_t uSize, std::align_val_t eAlign, const std::nothrow_t &) noexcept
+{
+    return allocateNoThrow(uSize, (uint64_t)eAlign);
+}
+
+LLDK_EXPORT void *operator new[](size_t uSize, std::align_val_t eAlign, const std::nothrow_t &) noexcept
+{
+    return allocateNoThrow(uSize, (uint64_t)eAlign);
+}
+
+LLDK_EXPORT void operator delete(void *pMemory, std::align_val_t) noexcept
+{
+    freeMemory(pMemory);
+}
+
+LLDK_EXPORT void operator delete[](void *pMemory, std::align_val_t) noexcept
+{
+    freeMemory(pMemory);
+}
+
+LLDK_EXPORT void operator delete(void *pMemory, size_t, std::align_val_t) noexcept
+{
+    freeMemory(pMemory);
+}
+
+LLDK_EXPORT void operator delete[](void *pMemory, size_t, std::align_val_t) noexcept
+{
+    freeMemory(pMemory);
+}
+
+LLDK_EXPORT void operator delete(void *pMemory, std::align_val_t, const std::nothrow_t &) noexcept
+{
+    freeMemory(pMemory);
+}
+
+LLDK_EXPORT void operator delete[](void *pMemory, std::align_val_t, const std::nothrow_t &) noexcept
+{
+    freeMemory(pMemory);
+}
+
+#endif // __cpp_aligned_new
+
+#ifdef LLDK_OVERRIDE_MALLOC
+
+// the declarations of glibc carry __THROW, the definitions must match them
+
+extern "C" {
+
+LLDK_EXPORT void *malloc(size_t uSize) __THROW
+{
+    void *pMemory = lldk::base::allocateMemory(uSize, 0);
+    if (unlikely(pMemory == nullptr))
+    {
+        errno = ENOMEM;
+    }
+    return pMemory;
+}
+
+LLDK_EXPORT void free(void *pMemory) __THROW
+{
+    freeMemory(pMemory);
+}
+
+LLDK_EXPORT void *calloc(size_t uCount, size_t uSize) __THROW
+{
+    size_t uTotalSize = 0;
+    if (unlikely(__builtin_mul_overflow(uCount, uSize, &uTotalSize)))
+    {
+        errno = ENOMEM;
+        return nullptr;
+    }
+
+    void *pMemory = malloc(uTotalSize);
+    if (likely(pMemory != nullptr))
+    {
+        memset(pMemory, 0, uTotalSize);
+    }
+    return pMemory;
+}
+
+LLDK_EXPORT void *realloc(void *pMemory, size_t uSize) __THROW
+{
+    if (pMemory == nullptr)
+    {
+        return malloc(uSize);
+    }
+
+    if (uSize == 0)
+    {
+        free(pMemory);
+        return nullptr;
+    }
+
+    void *pNewMemory = lldk::base::reAllocateMemory(pMemory, uSize);
+    if (unlikely(pNewMemory == nullptr))
+    {
+        errno = ENOMEM;
+    }
+    return pNewMemory;
+}
+
+LLDK_EXPORT void *reallocarray(void *pMemory, size_t uCount, size_t uSize) __THROW
+{
+    size_t uTotalSize = 0;
+    if (unlikely(__builtin_mul_overflow(uCount, uSize, &uTotalSize)))
+    {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    return realloc(pMemory, uTotalSize);
+}
+
+LLDK_EXPORT void *memalign(size_t uAlign, size_t uSize) __THROW
+{
+    return lldk::base::allocateAlignedMemory(uAlign, uSize);
+}
+
+LLDK_EXPORT void *aligned_alloc(size_t uAlign, size_t uSize) __THROW
+{
+    return lldk::base::allocateAlignedMemory(uAlign, uSize);
+}
+
+LLDK_EXPORT int posix_memalign(void **ppMemory, size_t uAlign, size_t uSize) __THROW
+{
+    if (unlikely(uAlign < sizeof(void *) || (uAlign & (uAlign - 1)) != 0 || uAlign > lldk::base::IAllocator::kMaxAlignment))
+    {
+        return EINVAL;
+    }
+
+    void *pMemory = lldk::base::allocateMemory(uSize, uAlign);
+    if (unlikely(pMemory == nullptr))
+    {
+        return ENOMEM;
+    }
+    *ppMemory = pMemory;
+    return 0;
+}
+
+LLDK_EXPORT void *valloc(size_t uSize) __THROW
+{
+    return lldk::base::allocateAlignedMemory(sysconf(_SC_PAGESIZE), uSize);
+}
+
+LLDK_EXPORT void *pvalloc(size_t uSize) __THROW
+{
+    uint64_t uPageSize = sysconf(_SC_PAGESIZE);
+    return lldk::base::allocateAlignedMemory(uPageSize, LLDK_ALIGN_BASE(uSize, uPageSize));
+}
+
+LLDK_EXPORT size_t malloc_usable_size(void *pMemory) __THROW
+{
+    return lldk::base::getUsableSize(pMemory);
+}
+
+}
+
+#endif // LLDK_OVERRIDE_MALLOC
@@ -1,21 +1,97 @@
 #include "lldk_thread_local.h"
 #include "../utilities/lldk_bitset.h"
 #include "lldk/common/error_code.h"
-#include <vector>
+#include <cstring>
 #include <mutex>
+#include <new>
+#include <thread>
+#include <pthread.h>
 
 namespace lldk
 {
 namespace utilities
 {
 
-static thread_local void **s_ppInstances = nullptr;
+// read by the threads and the blocks which have not set any thread local storage, never written
+static std::atomic<void *> s_arrEmptyBlock[LldkThreadLocalBase::kInstanceBlockSize] = {};
 
+// every slot points to the empty block, listed out since the atomics can not be filled by a constant initializer
+#define LLDK_EMPTY_BLOCK_4 {s_arrEmptyBlock}, {s_arrEmptyBlock}, {s_arrEmptyBlock}, {s_arrEmptyBlock}
+#define LLDK_EMPTY_BLOCK_16 LLDK_EMPTY_BLOCK_4, LLDK_EMPTY_BLOCK_4, LLDK_EMPTY_BLOCK_4, LLDK_EMPTY_BLOCK_4
+#define LLDK_EMPTY_BLOCK_64 LLDK_EMPTY_BLOCK_16, LLDK_EMPTY_BLOCK_16, LLDK_EMPTY_BLOCK_16, LLDK_EMPTY_BLOCK_16
+#define LLDK_EMPTY_BLOCK_256 LLDK_EMPTY_BLOCK_64, LLDK_EMPTY_BLOCK_64, LLDK_EMPTY_BLOCK_64, LLDK_EMPTY_BLOCK_64
+
+static_assert(LldkThreadLocalBase::kInstanceBlockCount == 256 + 1, "update the initializer of s_arrEmptyBlocks");
+static std::atomic<std::atomic<void *> *> s_arrEmptyBlocks[LldkThreadLocalBase::kInstanceBlockCount] = {
+    LLDK_EMPTY_BLOCK_256, {s_arrEmptyBlock}
+};
+
+#undef LLDK_EMPTY_BLOCK_256
+#undef LLDK_EMPTY_BLOCK_64
+#undef LLDK_EMPTY_BLOCK_16
+#undef LLDK_EMPTY_BLOCK_4
+
+__thread LldkThreadLocalBase::BlockSlot *LldkThreadLocalBase::s_pThreadBlocks __attribute__((tls_model("initial-exec"))) = s_arrEmptyBlocks;
+
+// constant initialized, a malloc interposed by lldk_override may set up a thread local storage
+// before the static initializers of the library run
+std::atomic<LldkThreadLocalBase::ThreadEntry *> LldkThreadLocalBase::s_pThreadEntries {nullptr};
+std::atomic<uint64_t> LldkThreadLocalBase::s_uEpoch {0};
+std::atomic<uint64_t> LldkThreadLocalBase::s_arrReaderCounts[2] = {};
+
+// the lock of the instance ids and their release functions, the threads exiting take it as well
 static std::mutex s_mutex;
 static LldkBitset<LldkThreadLocalBase::kMaxInstanceId> s_bitset;
-static std::vector<void **> s_vecpppInstances;
 
-uint32_t LldkThreadLocalBase::newInstanceId()
+// serializes the exiting threads flipping the epoch, a second flip would skip the readers of the first half
+static std::mutex s_epochMutex;
+
+// the release functions run out of the lock, a running one pins the hook so the instance waits for it
+struct InstanceHook
+{
+    LldkThreadLocalBase::ReleaseFunc pReleaseFunc;
+    void *pContext;
+    uint32_t uPinCount;
+};
+static InstanceHook s_arrInstanceHooks[LldkThreadLocalBase::kMaxInstanceId];
+
+// the destructor of the key releases the table of an exiting thread, the main thread never runs it
+static pthread_once_t s_threadExitKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t s_threadExitKey;
+static bool s_bThreadExitKeyValid = false;
+static __thread bool s_bThreadExiting = false;
+
+LldkThreadLocalBase::ReadGuard::ReadGuard()
+{
+    // a reader which counted itself in a half that has just been flipped away retries in the new one
+    while (true)
+    {
+        m_uIndex = (uint32_t)(s_uEpoch.load() & 1);
+        s_arrReaderCounts[m_uIndex].fetch_add(1);
+        if (likely((uint32_t)(s_uEpoch.load() & 1) == m_uIndex))
+        {
+            break;
+        }
+        s_arrReaderCounts[m_uIndex].fetch_sub(1, std::memory_order_release);
+    }
+}
+
+LldkThreadLocalBase::ReadGuard::~ReadGuard()
+{
+    s_arrReaderCounts[m_uIndex].fetch_sub(1, std::memory_order_release);
+}
+
+void LldkThreadLocalBase::synchronize()
+{
+    // the readers entering from now on count in the other half, and can not find what was unpublished
+    uint32_t uIndex = (uint32_t)(s_uEpoch.fetch_add(1) & 1);
+    while (s_arrReaderCounts[uIndex].load(std::memory_order_acquire) != 0)
+    {
+        std::this_thread::yield();
+    }
+}
+
+uint32_t LldkThreadLocalBase::newInstanceId(ReleaseFunc pReleaseFunc, void *pContext)
 {
     std::lock_guard<std::mutex> lock(s_mutex);
     auto uInstanceId = s_bitset.findFirstNone();
@@ -24,13 +100,72 @@ uint32_t LldkThreadLocalBase::newInstanceId()
         return kInvalidInstanceId;
     }
     s_bitset.set(uInstanceId);
+    s_arrInstanceHooks[uInstanceId].pReleaseFunc = pReleaseFunc;
+    s_arrInstanceHooks[uInstanceId].pContext = pContext;
     return uInstanceId;
 }
 
 void LldkThreadLocalBase::deleteInstanceId(uint32_t uInstanceId)
 {
-    std::lock_guard<std::mutex> lock(s_mutex);
-    s_bitset.clear(uInstanceId);
+    if (unlikely(uInstanceId == kInvalidInstanceId))
+    {
+        return;
+    }
+
+    // the entries are never freed, the list is walked without the lock. each storage is taken out of
+    // its table under the lock and released out of it, the function may create or destroy an instance
+    auto &hook = s_arrInstanceHooks[uInstanceId];
+    for (auto pEntry = s_pThreadEntries.load(std::memory_order_acquire); pEntry != nullptr; pEntry = pEntry->pNext)
+    {
+        void *pStorage = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            // an exiting thread waiting for the traversals has unpublished its table but not released it yet
+            auto pBlocks = pEntry->pBlocks.load(std::memory_order_acquire);
+            if (pBlocks == nullptr)
+            {
+                pBlocks = pEntry->pRetiredBlocks;
+            }
+            if (pBlocks == nullptr)
+            {
+                continue;
+            }
+
+            // the empty block holds only NULL, the exchange never writes it
+            auto pBlock = pBlocks[uInstanceId >> kInstanceBlockShift].load(std::memory_order_acquire);
+            if (pBlock == s_arrEmptyBlock)
+            {
+                continue;
+            }
+            pStorage = pBlock[uInstanceId & kInstanceBlockMask].exchange(nullptr, std::memory_order_acq_rel);
+        }
+
+        if (pStorage != nullptr && hook.pReleaseFunc != nullptr)
+        {
+            hook.pReleaseFunc(hook.pContext, pStorage, false);
+        }
+    }
+
+    // wait for the exiting threads still releasing their storages of the instance
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            if (hook.uPinCount == 0)
+            {
+                hook.pReleaseFunc = nullptr;
+                hook.pContext = nullptr;
+                s_bitset.clear(uInstanceId);
+                return;
+            }
+        }
+        std::this_thread::yield();
+    }
+}
+
+bool LldkThreadLocalBase::isThreadExiting()
+{
+    return s_bThreadExiting;
 }
 
 int32_t LldkThreadLocalBase::setThreadLocalStorage(uint32_t uInstanceId, void *pStorage)
@@ -40,61 +175,178 @@ int32_t LldkThreadLocalBase::setThreadLocalStorage(uint32_t uInstanceId, void *p
         lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
         return -1;
     }
-    
-    if (unlikely(s_ppInstances == nullptr))
+
+    if (unlikely(s_pThreadBlocks == s_arrEmptyBlocks))
     {
-        s_ppInstances = (void **)LldkThreadLocalBase::lldkAllocate(sizeof(void *) * kMaxInstanceId);
-        if (unlikely(s_ppInstances == nullptr))
+        // a storage set after the exit hook ran would never be released
+        if (unlikely(s_bThreadExiting))
+        {
+            lldkSetErrorCode(lldk::ErrorCode::kInvalidState);
+            return -1;
+        }
+
+        pthread_once(&s_threadExitKeyOnce, []() {
+            s_bThreadExitKeyValid = pthread_key_create(&s_threadExitKey, &LldkThreadLocalBase::onThreadExit) == 0;
+        });
+
+        auto pBlocks = (BlockSlot *)LldkThreadLocalBase::lldkAllocate(sizeof(BlockSlot) * kInstanceBlockCount);
+        if (unlikely(pBlocks == nullptr))
         {
             lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
             return -1;
         }
-        memset(s_ppInstances, 0, sizeof(void *) * kMaxInstanceId);
+        for (uint32_t i = 0; i < kInstanceBlockCount; i++)
+        {
+            new (&pBlocks[i]) BlockSlot(s_arrEmptyBlock);
+        }
 
-        try
+        // take the entry of an exited thread, or push a new one
+        ThreadEntry *pEntry = nullptr;
+        for (auto pFree = s_pThreadEntries.load(std::memory_order_acquire); pFree != nullptr; pFree = pFree->pNext)
         {
-            std::lock_guard<std::mutex> lock(s_mutex);
-            s_vecpppInstances.push_back(s_ppInstances);
+            bool bInUse = false;
+            if (!pFree->bInUse.load(std::memory_order_relaxed) &&
+                pFree->bInUse.compare_exchange_strong(bInUse, true, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                pEntry = pFree;
+                break;
+            }
+        }
+
+        if (pEntry == nullptr)
+        {
+            pEntry = (ThreadEntry *)LldkThreadLocalBase::lldkAllocate(sizeof(ThreadEntry));
+            if (unlikely(pEntry == nullptr))
+            {
+                LldkThreadLocalBase::lldkFree(pBlocks);
+                lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
+                return -1;
+            }
+            memset((void *)pEntry, 0, sizeof(ThreadEntry));
+            pEntry->bInUse.store(true, std::memory_order_relaxed);
+            pEntry->pNext = s_pThreadEntries.load(std::memory_order_relaxed);
+            while (!s_pThreadEntries.compare_exchange_weak(pEntry->pNext, pEntry, std::memory_order_release, std::memory_order_relaxed))
+            {
+            }
         }
-        catch (...)
+
+        pEntry->pBlocks.store(pBlocks, std::memory_order_release);
+        if (likely(s_bThreadExitKeyValid))
         {
-            LldkThreadLocalBase::lldkFree(s_ppInstances);
-            s_ppInstances = nullptr;
-            lldkSetErrorCode(lldk::ErrorCode::kThrowException);
+            pthread_setspecific(s_threadExitKey, pEntry);
+        }
+        s_pThreadBlocks = pBlocks;
+    }
+
+    auto pBlockSlot = &s_pThreadBlocks[uInstanceId >> kInstanceBlockShift];
+    auto pBlock = pBlockSlot->load(std::memory_order_relaxed);
+    if (unlikely(pBlock == s_arrEmptyBlock))
+    {
+        pBlock = newBlock(pBlockSlot);
+        if (unlikely(pBlock == nullptr))
+        {
+            lldkSetErrorCode(lldk::ErrorCode::kNoMemory);
             return -1;
         }
     }
 
-    s_ppInstances[uInstanceId] = pStorage;
+    pBlock[uInstanceId & kInstanceBlockMask].store(pStorage, std::memory_order_release);
     return 0;
 }
 
-void *LldkThreadLocalBase::getThreadLocalStorage(uint32_t uInstanceId)
+LldkThreadLocalBase::Slot *LldkThreadLocalBase::newBlock(BlockSlot *pBlockSlot)
 {
-    return s_ppInstances[uInstanceId];
+    auto pBlock = (Slot *)LldkThreadLocalBase::lldkAllocate(sizeof(Slot) * kInstanceBlockSize);
+    if (unlikely(pBlock == nullptr))
+    {
+        return nullptr;
+    }
+    memset((void *)pBlock, 0, sizeof(Slot) * kInstanceBlockSize);
+
+    // only the owner thread writes its first level, the release publishes the zeroed block to the traversals
+    pBlockSlot->store(pBlock, std::memory_order_release);
+    return pBlock;
 }
 
-int32_t LldkThreadLocalBase::foreach(uint32_t uInstanceId, std::function<int32_t(void *)> func)
+void LldkThreadLocalBase::onThreadExit(void *pArg)
 {
-    if (unlikely(func == nullptr))
+    auto pEntry = static_cast<ThreadEntry *>(pArg);
+    auto pBlocks = pEntry->pBlocks.load(std::memory_order_relaxed);
+    s_bThreadExiting = true;
+    s_pThreadBlocks = s_arrEmptyBlocks;
+
     {
-        lldkSetErrorCode(lldk::ErrorCode::kInvalidParam);
-        return -1;
+        std::lock_guard<std::mutex> lock(s_mutex);
+        pEntry->pRetiredBlocks = pBlocks;
+        pEntry->pBlocks.store(nullptr, std::memory_order_release);
     }
 
-    std::lock_guard<std::mutex> lock(s_mutex);
-    for (auto ppInstance : s_vecpppInstances)
     {
-        if (ppInstance != nullptr && ppInstance[uInstanceId] != nullptr)
+        // wait for the traversals which may still read the table or its storages, without the instance mutex
+        // since their callbacks may create or destroy an instance
+        std::lock_guard<std::mutex> lock(s_epochMutex);
+        synchronize();
+    }
+
+    // only the blocks the thread has touched are scanned, an instance destroyed meanwhile reaches them
+    // through pRetiredBlocks until the end
+    for (uint32_t i = 0; i < kInstanceBlockCount - 1; i++)
+    {
+        auto pBlock = pBlocks[i].load(std::memory_order_relaxed);
+        if (pBlock == s_arrEmptyBlock)
         {
-            if (unlikely(func(ppInstance[uInstanceId]) != 0))
+            continue;
+        }
+
+        // the storages are taken out and their hooks pinned under the lock, then released out of it
+        InstanceHook arrHooks[kInstanceBlockSize];
+        void *arrStorages[kInstanceBlockSize];
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            for (uint32_t j = 0; j < kInstanceBlockSize; j++)
             {
-                lldkSetErrorCode(lldk::ErrorCode::kCallFailed);
-                return -1;
+                auto &hook = s_arrInstanceHooks[(i << kInstanceBlockShift) + j];
+                arrStorages[j] = pBlock[j].exchange(nullptr, std::memory_order_relaxed);
+                if (arrStorages[j] != nullptr && hook.pReleaseFunc != nullptr)
+                {
+                    hook.uPinCount++;
+                    arrHooks[j] = hook;
+                }
+                else
+                {
+                    arrStorages[j] = nullptr;
+                }
+            }
+            pBlocks[i].store(s_arrEmptyBlock, std::memory_order_relaxed);
+        }
+
+        for (uint32_t j = 0; j < kInstanceBlockSize; j++)
+        {
+            if (arrStorages[j] != nullptr)
+            {
+                arrHooks[j].pReleaseFunc(arrHooks[j].pContext, arrStorages[j], true);
             }
         }
+
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            for (uint32_t j = 0; j < kInstanceBlockSize; j++)
+            {
+                if (arrStorages[j] != nullptr)
+                {
+                    s_arrInstanceHooks[(i << kInstanceBlockShift) + j].uPinCount--;
+                }
+            }
+        }
+        LldkThreadLocalBase::lldkFree(pBlock);
     }
-    return 0;
+
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        pEntry->pRetiredBlocks = nullptr;
+    }
+    LldkThreadLocalBase::lldkFree(pBlocks);
+    pEntry->bInUse.store(false, std::memory_order_release);
 }
 
 LLDK_EXTERN_C void *__lldkAllocate(uint64_t uSize);
@@ -110,5 +362,30 @@ void LldkThreadLocalBase::lldkFree(void *pMemory)
     __lldkFree(pMemory);
 }
 
+void *LldkThreadLocalBase::lldkAllocateAligned(uint64_t uSize, uint64_t uAlignment)
+{
+    // round up to whole lines, and keep the pointer of lldkAllocate in the word before the aligned address
+    auto uPaddedSize = (uSize + uAlignment - 1) & ~(uAlignment - 1);
+    auto pMemory = (uint8_t *)lldkAllocate(uPaddedSize + uAlignment);
+    if (unlikely(pMemory == nullptr))
+    {
+        return nullptr;
+    }
+
+    auto pAligned = (uint8_t *)(((uintptr_t)pMemory + uAlignment) & ~(uintptr_t)(uAlignment - 1));
+    ((void **)pAligned)[-1] = pMemory;
+    return pAligned;
+}
+
+void LldkThreadLocalBase::lldkFreeAligned(void *pMemory)
+{
+    if (unlikely(pMemory == nullptr))
+    {
+        return;
+    }
+
+    lldkFree(((void **)pMemory)[-1]);
+}
+
 }
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 #define LLDK_UTILITIES_LLDK_THREAD_LOCAL_H
 
 #include "lldk/common/common.h"
+#include "lldk/common/error_code.h"
+#include <atomic>
 #include <functional>
 #include <stdexcept>
 
@@ -19,19 +21,44 @@ public:
     /**
      * @brief The maximum instance id
      */
-    static constexpr uint32_t kMaxInstanceId = 2048;
+    static constexpr uint32_t kMaxInstanceId = 1 << 16;
 
     static constexpr uint32_t kInvalidInstanceId = kMaxInstanceId;
 
+    /**
+     * @brief The per-thread table is split into blocks of kInstanceBlockSize slots, allocated on first use
+     */
+    static constexpr uint32_t kInstanceBlockShift = 8;
+    static constexpr uint32_t kInstanceBlockSize = 1 << kInstanceBlockShift;
+    static constexpr uint32_t kInstanceBlockMask = kInstanceBlockSize - 1;
+
+    /**
+     * @brief The number of blocks of a table, the last one only holds the slot of the invalid id
+     */
+    static constexpr uint32_t kInstanceBlockCount = (kMaxInstanceId >> kInstanceBlockShift) + 1;
+
+    /**
+     * @brief The function releasing a thread local storage of an instance
+     * @param pContext The context given to newInstanceId
+     * @param pStorage The thread local storage
+     * @param bThreadExit true if the owner thread is exiting, false if the instance is deleted
+     * @note called without the lock of the instance ids, it may create or delete other instances
+     */
+    using ReleaseFunc = void (*)(void *pContext, void *pStorage, bool bThreadExit);
+
     /**
      * @brief Create a new instance id
-     * @return The new instance id
+     * @param pReleaseFunc The function releasing the storages of the instance
+     * @param pContext The context passed to pReleaseFunc
+     * @return The new instance id, kInvalidInstanceId if failed
      */
-    static uint32_t newInstanceId();
+    static uint32_t newInstanceId(ReleaseFunc pReleaseFunc, void *pContext);
 
     /**
-     * @brief Delete an instance id
+     * @brief Delete an instance id, release the storages of the instance in all threads
      * @param uInstanceId The instance id to delete
+     * @note no thread may use the instance meanwhile, a thread exiting meanwhile is waited for, so the
+     *       release function of the instance must not delete the instance itself
      */
     static void deleteInstanceId(uint32_t uInstanceId);
 
@@ -43,20 +70,77 @@ public:
      */
     static int32_t setThreadLocalStorage(uint32_t uInstanceId, void *pStorage);
 
+    /**
+     * @brief Check whether the calling thread has released its thread local storages on exit
+     * @return true if exiting, false otherwise
+     */
+    static bool isThreadExiting();
+
     /**
      * @brief Get the thread local storage
      * @param uInstanceId The instance id
-     * @return The thread local storage
+     * @return The thread local storage, NULL if the thread has not set it or the instance id is invalid
+     * @note inlined into the callers as two dependent loads, the blocks not allocated yet are the shared empty block
      */
-    static void *getThreadLocalStorage(uint32_t uInstanceId);
+    static LLDK_INLINE void *getThreadLocalStorage(uint32_t uInstanceId)
+    {
+        auto pBlock = s_pThreadBlocks[uInstanceId >> kInstanceBlockShift].load(std::memory_order_relaxed);
+        return pBlock[uInstanceId & kInstanceBlockMask].load(std::memory_order_relaxed);
+    }
 
     /**
      * @brief Foreach the all thread local storages of the instance id
      * @param uInstanceId The instance id
-     * @param func The function to be called for each thread local storage, return 0 continue, otherwise stop
-     * @return 0 if success, nonzero if failed, if func return nonzero stop the foreach and foreach return 0
+     * @param func The function called as int32_t(void *) for each thread local storage, return 0 continue, otherwise stop
+     * @return 0 if success, -1 if func returns nonzero
+     * @note lock free, the threads starting or setting their storages meanwhile are not blocked
+     */
+    template <typename Func>
+    static int32_t foreach(uint32_t uInstanceId, Func &&func)
+    {
+        ReadGuard guard;
+        for (auto pEntry = s_pThreadEntries.load(std::memory_order_acquire); pEntry != nullptr; pEntry = pEntry->pNext)
+        {
+            auto pBlocks = pEntry->pBlocks.load(std::memory_order_acquire);
+            if (pBlocks == nullptr)
+            {
+                continue;
+            }
+
+            auto pBlock = pBlocks[uInstanceId >> kInstanceBlockShift].load(std::memory_order_acquire);
+            auto pStorage = pBlock[uInstanceId & kInstanceBlockMask].load(std::memory_order_acquire);
+            if (pStorage != nullptr && unlikely(func(pStorage) != 0))
+            {
+                lldkSetErrorCode(lldk::ErrorCode::kCallFailed);
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Check whether a callable is empty, a std::function or a function pointer can be
+     * @param func The callable
+     * @return true if empty, false otherwise
      */
-    static int32_t foreach(uint32_t uInstanceId, std::function<int32_t(void *)> func);
+    template <typename Func>
+    static bool isNullFunc(const Func &func)
+    {
+        unused(func);
+        return false;
+    }
+
+    template <typename R, typename... Args>
+    static bool isNullFunc(const std::function<R(Args...)> &func)
+    {
+        return func == nullptr;
+    }
+
+    template <typename R, typename... Args>
+    static bool isNullFunc(R (*pFunc)(Args...))
+    {
+        return pFunc == nullptr;
+    }
 
     /**
      * @brief Allocate memory
@@ -70,9 +154,157 @@ public:
      * @param pMemory The pointer to the memory to free
      */
     static void lldkFree(void *pMemory);
+
+    /**
+     * @brief Allocate memory occupying whole cachelines, so it shares no cacheline with other allocations
+     * @param uSize The size of the memory to allocate
+     * @param uAlignment The alignment, a power of two not less than LLDK_CACHELINE_SIZE
+     * @return The pointer to the allocated memory, NULL if failed
+     */
+    static void *lldkAllocateAligned(uint64_t uSize, uint64_t uAlignment);
+
+    /**
+     * @brief Free memory allocated by lldkAllocateAligned
+     * @param pMemory The pointer to the memory to free
+     */
+    static void lldkFreeAligned(void *pMemory);
+
+private:
+    /**
+     * @brief A slot holding a thread local storage, and a first level slot holding a block of them
+     */
+    using Slot = std::atomic<void *>;
+    using BlockSlot = std::atomic<Slot *>;
+
+    /**
+     * @brief The registry node of a thread's table, pushed at the head and never unlinked
+     * @note a thread exiting retires its table and leaves the entry to the next new thread
+     */
+    struct ThreadEntry
+    {
+        std::atomic<BlockSlot *> pBlocks; // NULL while the entry is free
+        std::atomic<bool> bInUse;
+        BlockSlot *pRetiredBlocks; // the unpublished table of an exiting thread, guarded by the instance mutex
+        ThreadEntry *pNext;
+    };
+
+    /**
+     * @brief Keep the tables read by a traversal alive until it leaves
+     * @note the readers count themselves in the half of the epoch they entered, a writer retiring memory
+     *       flips the epoch and waits for the old half to drain
+     */
+    class ReadGuard
+    {
+    public:
+        ReadGuard();
+        ~ReadGuard();
+
+        ReadGuard(const ReadGuard &) = delete;
+        ReadGuard &operator=(const ReadGuard &) = delete;
+
+    private:
+        uint32_t m_uIndex;
+    };
+
+    /**
+     * @brief Flip the epoch and wait for the readers which entered before
+     * @note the callers hold the epoch mutex but not the instance mutex, a traversal callback may take the latter
+     */
+    static void synchronize();
+
+    /**
+     * @brief Release the storages and the table of the thread, the destructor of the thread exit key
+     * @param pArg The entry of the thread
+     */
+    static void onThreadExit(void *pArg);
+
+    static std::atomic<ThreadEntry *> s_pThreadEntries;
+    static std::atomic<uint64_t> s_uEpoch;
+    static std::atomic<uint64_t> s_arrReaderCounts[2];
+
+    /**
+     * @brief Allocate a block of the calling thread's table
+     * @param pBlockSlot The first level slot of the block
+     * @return The block, NULL if failed
+     */
+    static Slot *newBlock(BlockSlot *pBlockSlot);
+
+    /**
+     * @brief The first level of the table of the thread local storages of the thread, indexed by the instance id
+     *        shifted by kInstanceBlockShift, each slot points to a block indexed by the low bits
+     * @note a block is allocated by the first setThreadLocalStorage of an id in it, until then the slot points
+     *       to a shared empty block, so a lookup never checks for NULL. the slot of the invalid id stays empty.
+     *       it points to a shared empty first level until the first setThreadLocalStorage in the thread.
+     *       __thread with the initial-exec model is a constant initialized variable at a fixed offset of
+     *       the thread pointer, read without the tls_get_addr call or the thread_local init wrapper.
+     */
+    static __thread BlockSlot *s_pThreadBlocks __attribute__((tls_model("initial-exec")));
 };
 
+/**
+ * @brief The default factory of LldkThreadLocal, default construct the storage in the lldk memory
+ * @note the storage is padded to whole cachelines, the counters of one thread do not false share with
+ *       the storages of the other threads or instances
+ */
 template <typename T>
+struct LldkThreadLocalCreateFunc
+{
+    T *operator()() const
+    {
+        auto pStorage = LldkThreadLocalBase::lldkAllocateAligned(
+            sizeof(T), alignof(T) > LLDK_CACHELINE_SIZE ? alignof(T) : LLDK_CACHELINE_SIZE);
+        if (unlikely(pStorage == nullptr))
+        {
+            return nullptr;
+        }
+
+        try
+        {
+            return new(pStorage) T();
+        }
+        catch (...)
+        {
+            LldkThreadLocalBase::lldkFreeAligned(pStorage);
+            return nullptr;
+        }
+    }
+};
+
+/**
+ * @brief The default destroyer of LldkThreadLocal, pairs with LldkThreadLocalCreateFunc
+ */
+template <typename T>
+struct LldkThreadLocalDestroyFunc
+{
+    void operator()(T *pValue) const
+    {
+        pValue->~T();
+        LldkThreadLocalBase::lldkFreeAligned(pValue);
+    }
+};
+
+/**
+ * @brief The default retirer of LldkThreadLocal, nothing is kept of the storage of an exited thread
+ */
+template <typename T>
+struct LldkThreadLocalRetireFunc
+{
+    void operator()(T *pValue) const
+    {
+        unused(pValue);
+    }
+};
+
+/**
+ * @brief The per thread storage of T, created by CreateFunc on the first get() in each thread
+ * @note CreateFunc returns the new storage or NULL, DestroyFunc releases a storage returned by CreateFunc.
+ *       when a thread exits, RetireFunc folds its storage into an aggregate kept by the user, e.g. the
+ *       counters of the exited threads, then DestroyFunc releases it. the storages of the threads still
+ *       running are destroyed with the LldkThreadLocal. both run out of the lock of the instance ids, they
+ *       may create or delete another LldkThreadLocal.
+ */
+template <typename T, typename CreateFunc = LldkThreadLocalCreateFunc<T>, typename DestroyFunc = LldkThreadLocalDestroyFunc<T>,
+          typename RetireFunc = LldkThreadLocalRetireFunc<T>>
 class LldkThreadLocal
 {
 public:
@@ -80,30 +312,27 @@ public:
     LldkThreadLocal &operator=(const LldkThreadLocal &) = delete;
 
     /**
-     * @brief Constructor
+     * @brief Constructor, the storages are created lazily in the threads
+     * @param createFunc The factory of the storage
+     * @param destroyFunc The destroyer of the storage
+     * @param retireFunc The retirer of the storage of an exiting thread
      */
-    LldkThreadLocal()
+    explicit LldkThreadLocal(CreateFunc createFunc = CreateFunc(), DestroyFunc destroyFunc = DestroyFunc(),
+                             RetireFunc retireFunc = RetireFunc())
     {
-        m_uInstanceId = LldkThreadLocalBase::newInstanceId();
-        if (m_uInstanceId == LldkThreadLocalBase::kInvalidInstanceId)
-        {
-            throw std::runtime_error("Failed to create instance id");
-        }
-
-        auto pStorage = LldkThreadLocalBase::lldkAllocate(sizeof(T));
+        // the functors stay at a fixed address for the exiting threads, a move only hands over the pointer
+        auto pStorage = LldkThreadLocalBase::lldkAllocate(sizeof(Funcs));
         if (unlikely(pStorage == nullptr))
         {
-            throw std::runtime_error("Failed to create storage");
+            throw std::runtime_error("Failed to create functors");
         }
+        m_pFuncs = new(pStorage) Funcs{createFunc, destroyFunc, retireFunc};
 
-        new(pStorage) T();
-
-        if (unlikely(LldkThreadLocalBase::setThreadLocalStorage(m_uInstanceId, pStorage) != 0))
+        m_uInstanceId = LldkThreadLocalBase::newInstanceId(&LldkThreadLocal::release, m_pFuncs);
+        if (m_uInstanceId == LldkThreadLocalBase::kInvalidInstanceId)
         {
-            LldkThreadLocalBase::lldkFree(pStorage);
-            LldkThreadLocalBase::deleteInstanceId(m_uInstanceId);
-            m_uInstanceId = LldkThreadLocalBase::kInvalidInstanceId;
-            throw std::runtime_error("Failed to set thread local storage");
+            deleteFuncs();
+            throw std::runtime_error("Failed to create instance id");
         }
     }
 
@@ -112,7 +341,9 @@ public:
         if (likely(this != &that))
         {
             m_uInstanceId = that.m_uInstanceId;
+            m_pFuncs = that.m_pFuncs;
             that.m_uInstanceId = LldkThreadLocalBase::kInvalidInstanceId;
+            that.m_pFuncs = nullptr;
         }
     }
 
@@ -120,49 +351,58 @@ public:
     {
         if (likely(this != &that))
         {
+            destroy();
             m_uInstanceId = that.m_uInstanceId;
+            m_pFuncs = that.m_pFuncs;
             that.m_uInstanceId = LldkThreadLocalBase::kInvalidInstanceId;
+            that.m_pFuncs = nullptr;
         }
 
         return *this;
     }
 
     /**
-     * @brief Destructor
+     * @brief Destructor, destroy the storages of all threads
      */
     ~LldkThreadLocal()
     {
-        auto pStorage = LldkThreadLocalBase::getThreadLocalStorage(m_uInstanceId);
-        if (likely(pStorage != nullptr))
+        destroy();
+    }
+
+    /**
+     * @brief Get the thread local storage, create it on the first call in the thread
+     * @return The thread local storage, NULL if failed
+     */
+    LLDK_INLINE T *get()
+    {
+        auto pValue = peek();
+        if (likely(pValue != nullptr))
         {
-            static_cast<T *>(pStorage)->~T();
-            LldkThreadLocalBase::lldkFree(pStorage);
-            LldkThreadLocalBase::setThreadLocalStorage(m_uInstanceId, nullptr);
+            return pValue;
         }
-        LldkThreadLocalBase::deleteInstanceId(m_uInstanceId);
-        m_uInstanceId = LldkThreadLocalBase::kInvalidInstanceId;
+        return create();
     }
 
     /**
-     * @brief Get the thread local storage
-     * @return The thread local storage
+     * @brief Get the thread local storage without creating it
+     * @return The thread local storage, NULL if the thread has not created it
      */
-    T *get() const
+    LLDK_INLINE T *peek() const
     {
-        return reinterpret_cast<T *>(LldkThreadLocalBase::getThreadLocalStorage(m_uInstanceId));
+        return static_cast<T *>(LldkThreadLocalBase::getThreadLocalStorage(m_uInstanceId));
     }
 
     /**
      * @brief Foreach the all thread local storages of the instance id
-     * @param uInstanceId The instance id
-     * @param func The function to be called for each thread local storage, return 0 continue, otherwise stop
-     * @return 0 if success, nonzero if failed, if func return nonzero stop the foreach and foreach return 0
+     * @param func The function called as int32_t(T *) for each thread local storage, return 0 continue, otherwise stop
+     * @return 0 if success, -1 if func is empty or returns nonzero
      */
-    int32_t foreach(std::function<int32_t(T *)> func) const
+    template <typename Func>
+    int32_t foreach(Func &&func) const
     {
-        if (likely(m_uInstanceId != LldkThreadLocalBase::kInvalidInstanceId && func != nullptr))
+        if (likely(m_uInstanceId != LldkThreadLocalBase::kInvalidInstanceId && !LldkThreadLocalBase::isNullFunc(func)))
         {
-            return LldkThreadLocalBase::foreach(m_uInstanceId, [func](void *pStorage) {
+            return LldkThreadLocalBase::foreach(m_uInstanceId, [&func](void *pStorage) {
                 return func(static_cast<T *>(pStorage));
             });
         }
@@ -170,8 +410,115 @@ public:
         return -1;
     }
 
+    /**
+     * @brief Visit the thread local storages of the running threads
+     * @param func The function called as void(const T &) for each thread local storage
+     * @return 0 if success, -1 if the instance is invalid or func is empty
+     * @note the storages may be updated by their threads meanwhile, func reads a snapshot of each
+     */
+    template <typename Func>
+    int32_t combineEach(Func &&func) const
+    {
+        if (unlikely(LldkThreadLocalBase::isNullFunc(func)))
+        {
+            return -1;
+        }
+
+        return foreach([&func](T *pValue) {
+            func(static_cast<const T &>(*pValue));
+            return 0;
+        });
+    }
+
+    /**
+     * @brief Reduce the thread local storages of the running threads
+     * @param reducer The function called as T(const T &, const T &), folds a storage into the result
+     * @param init The initial result, e.g. the aggregate of the exited threads kept by RetireFunc
+     * @return The result, init if no thread has created its storage
+     */
+    template <typename Reducer>
+    T combine(Reducer &&reducer, T init = T()) const
+    {
+        combineEach([&reducer, &init](const T &value) {
+            init = reducer(static_cast<const T &>(init), value);
+        });
+        return init;
+    }
+
+private:
+    struct Funcs
+    {
+        CreateFunc createFunc;
+        DestroyFunc destroyFunc;
+        RetireFunc retireFunc;
+    };
+
+    /**
+     * @brief Create the storage of the calling thread, kept out of line of get()
+     * @return The thread local storage, NULL if failed
+     */
+    __attribute__((noinline, cold)) T *create()
+    {
+        if (unlikely(m_uInstanceId == LldkThreadLocalBase::kInvalidInstanceId || LldkThreadLocalBase::isThreadExiting()))
+        {
+            return nullptr;
+        }
+
+        T *pValue = nullptr;
+        try
+        {
+            pValue = m_pFuncs->createFunc();
+        }
+        catch (...)
+        {
+            return nullptr;
+        }
+
+        if (unlikely(pValue == nullptr))
+        {
+            return nullptr;
+        }
+
+        if (unlikely(LldkThreadLocalBase::setThreadLocalStorage(m_uInstanceId, pValue) != 0))
+        {
+            m_pFuncs->destroyFunc(pValue);
+            return nullptr;
+        }
+        return pValue;
+    }
+
+    static void release(void *pContext, void *pStorage, bool bThreadExit)
+    {
+        auto pFuncs = static_cast<Funcs *>(pContext);
+        if (bThreadExit)
+        {
+            pFuncs->retireFunc(static_cast<T *>(pStorage));
+        }
+        pFuncs->destroyFunc(static_cast<T *>(pStorage));
+    }
+
+    void deleteFuncs()
+    {
+        m_pFuncs->~Funcs();
+        LldkThreadLocalBase::lldkFree(m_pFuncs);
+        m_pFuncs = nullptr;
+    }
+
+    void destroy()
+    {
+        if (unlikely(m_uInstanceId == LldkThreadLocalBase::kInvalidInstanceId))
+        {
+            return;
+        }
+
+        LldkThreadLocalBase::deleteInstanceId(m_uInstanceId);
+        m_uInstanceId = LldkThreadLocalBase::kInvalidInstanceId;
+        deleteFuncs();
+    }
+
 private:
     uint32_t m_uInstanceId{LldkThreadLocalBase::kInvalidInstanceId};
+    Funcs *m_pFuncs{nullptr};
 };
 
 }
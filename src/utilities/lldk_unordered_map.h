@@ -2,6 +2,7 @@
 #define LLDK_UTILITIES_LLDK_UNORDERED_MAP_H
 
 #include "lldk/common/common.h"
+#include "lldk/base/stl_allocator.h"
 #include <cstdint>
 #include <unordered_map>
 #include <functional>
@@ -12,15 +13,24 @@ namespace lldk
 namespace utilities
 {
 
-template <typename Key, typename Value, typename HashFunc, uint32_t CACHE_SIZE = 64>
+// the nodes come from the allocator singleton unless another allocator is given
+template <typename Key, typename Value, typename HashFunc, uint32_t CACHE_SIZE = 64,
+          typename Alloc = lldk::base::LldkStlAllocator<std::pair<const Key, Value>>>
 class LldkUnorderedMap
 {
 public:
+    using MapType = std::unordered_map<Key, Value, HashFunc, std::equal_to<Key>, Alloc>;
+
     LldkUnorderedMap()
     {
         memset(m_arrEntries, 0, sizeof(m_arrEntries));
     }
 
+    explicit LldkUnorderedMap(const Alloc &alloc) : m_mapEntries(alloc)
+    {
+        memset(m_arrEntries, 0, sizeof(m_arrEntries));
+    }
+
     ~LldkUnorderedMap() = default;
 
     bool insert(const Key& key, const Value& value)
@@ -43,12 +53,19 @@ public:
 
     void erase(const Key& key)
     {
-        m_mapEntries.erase(key);
+        auto iter = m_mapEntries.find(key);
+        if (unlikely(iter == m_mapEntries.end()))
+        {
+            return;
+        }
+
+        // drop the cached entry before its node is freed, the key may live in the node
         auto uHash = hashFunc(key) % CACHE_SIZE;
-        if (m_arrEntries[uHash] != nullptr && (m_arrEntries[uHash])->first == key)
+        if (m_arrEntries[uHash] == &(*iter))
         {
             m_arrEntries[uHash] = nullptr;
         }
+        m_mapEntries.erase(iter);
     }
 
     Value* find(const Key& key)
@@ -117,9 +134,9 @@ public:
 
 private:
     HashFunc hashFunc;
-    typename std::unordered_map<Key, Value, HashFunc>::value_type *m_arrEntries[CACHE_SIZE];
+    typename MapType::value_type *m_arrEntries[CACHE_SIZE];
     uint64_t m_uCachemissCount{0};
-    std::unordered_map<Key, Value, HashFunc> m_mapEntries;
+    MapType m_mapEntries;
 };
 
 }
@@ -0,0 +1,1076 @@
+#include "gtest/gtest.h"
+#include "lldk/base/allocator.h"
+#include "lldk/common/error_code.h"
+#include <algorithm>
+#include <cstring>
+#include <set>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace lldk::base;
+
+LLDK_EXTERN_C void *__lldkAllocate(uint64_t uSize);
+LLDK_EXTERN_C void __lldkFree(void *pMemory);
+LLDK_EXTERN_C int32_t __lldkGetAllocateStats(lldk::base::IAllocator::AllocateStats *pAllocateStats);
+
+struct alignas(LLDK_CACHELINE_SIZE) CachelineCounter
+{
+    uint64_t uValue;
+};
+
+// 测试辅助类：按用例名创建并在结束时销毁分配器
+class AllocatorTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        std::string sName = std::string("test.") + ::testing::UnitTest::GetInstance()->current_test_info()->name();
+        m_pAllocator = lldkCreateAllocator(sName.c_str(), 0);
+        ASSERT_NE(m_pAllocator, nullptr);
+    }
+
+    void TearDown() override
+    {
+        lldkDestroyAllocator(m_pAllocator);
+    }
+
+    IAllocator *m_pAllocator{nullptr};
+};
+
+// 测试各种大小的分配都满足 16 字节对齐并且可以读写
+TEST_F(AllocatorTest, AllocateAlignment)
+{
+    std::vector<void *> vecMemory;
+    for (uint64_t uSize = 0; uSize <= 40000; uSize += (uSize < 1024 ? 1 : 97))
+    {
+        void *pMemory = m_pAllocator->allocate(uSize);
+        ASSERT_NE(pMemory, nullptr) << "size " << uSize;
+        EXPECT_EQ((uintptr_t)pMemory % 16, 0u) << "size " << uSize;
+        memset(pMemory, 0x5A, uSize);
+        vecMemory.push_back(pMemory);
+    }
+
+    for (auto pMemory : vecMemory)
+    {
+        m_pAllocator->free(pMemory);
+    }
+}
+
+// 测试同一大小的对象互不重叠，释放后可以复用
+TEST_F(AllocatorTest, SameSizeNoOverlap)
+{
+    const int kCount = 10000;
+    std::vector<uint64_t *> vecMemory;
+    for (int i = 0; i < kCount; i++)
+    {
+        auto pMemory = (uint64_t *)m_pAllocator->allocate(64);
+        ASSERT_NE(pMemory, nullptr);
+        for (int j = 0; j < 8; j++)
+        {
+            pMemory[j] = (uint64_t)i;
+        }
+        vecMemory.push_back(pMemory);
+    }
+
+    for (int i = 0; i < kCount; i++)
+    {
+        for (int j = 0; j < 8; j++)
+        {
+            ASSERT_EQ(vecMemory[i][j], (uint64_t)i);
+        }
+    }
+
+    for (auto pMemory : vecMemory)
+    {
+        m_pAllocator->free(pMemory);
+    }
+
+    void *pMemory = m_pAllocator->allocate(64);
+    ASSERT_NE(pMemory, nullptr);
+    m_pAllocator->free(pMemory);
+}
+
+// 测试大块和超大块内存
+TEST_F(AllocatorTest, LargeAndHuge)
+{
+    const uint64_t arrSizes[] = {32 * 1024 + 1, 100 * 1024, 1024 * 1024, 4 * 1024 * 1024, 64 * 1024 * 1024};
+    for (auto uSize : arrSizes)
+    {
+        auto pMemory = (uint8_t *)m_pAllocator->allocate(uSize);
+        ASSERT_NE(pMemory, nullptr) << "size " << uSize;
+        pMemory[0] = 1;
+        pMemory[uSize - 1] = 2;
+        m_pAllocator->free(pMemory);
+    }
+}
+
+// 测试可用大小不小于请求的大小并且可以写满，不属于该分配器的内存返回 0
+TEST_F(AllocatorTest, UsableSize)
+{
+    for (uint64_t uSize : {0ULL, 1ULL, 100ULL, 32768ULL, 100000ULL, 4ULL * 1024 * 1024})
+    {
+        void *pMemory = m_pAllocator->allocate(uSize);
+        ASSERT_NE(pMemory, nullptr);
+        uint64_t uUsableSize = m_pAllocator->getUsableSize(pMemory);
+        EXPECT_GE(uUsableSize, uSize);
+        memset(pMemory, 0x5A, uUsableSize);
+        m_pAllocator->free(pMemory);
+    }
+
+    EXPECT_EQ(m_pAllocator->getUsableSize(nullptr), 0u);
+    auto pOther = lldkCreateAllocator("test.UsableSize.other", 0);
+    ASSERT_NE(pOther, nullptr);
+    void *pMemory = pOther->allocate(64);
+    ASSERT_NE(pMemory, nullptr);
+    EXPECT_EQ(m_pAllocator->getUsableSize(pMemory), 0u);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kInvalidParam);
+    EXPECT_GE(pOther->getUsableSize(pMemory), 64u);
+    pOther->free(pMemory);
+    lldkDestroyAllocator(pOther);
+}
+
+// 测试 reAllocate 保留原有数据
+TEST_F(AllocatorTest, ReAllocateKeepsData)
+{
+    auto pMemory = (uint8_t *)m_pAllocator->reAllocate(nullptr, 100);
+    ASSERT_NE(pMemory, nullptr);
+    for (int i = 0; i < 100; i++)
+    {
+        pMemory[i] = (uint8_t)i;
+    }
+
+    const uint64_t arrSizes[] = {200, 5000, 100000, 3 * 1024 * 1024, 50};
+    for (auto uSize : arrSizes)
+    {
+        pMemory = (uint8_t *)m_pAllocator->reAllocate(pMemory, uSize);
+        ASSERT_NE(pMemory, nullptr);
+        for (int i = 0; i < 50; i++)
+        {
+            ASSERT_EQ(pMemory[i], (uint8_t)i) << "size " << uSize;
+        }
+    }
+    m_pAllocator->free(pMemory);
+}
+
+// 测试 reAllocate 原地扩展：同一大小类、相邻的空闲页、mremap 移动的大块
+TEST_F(AllocatorTest, ReAllocateInPlace)
+{
+    auto pSmall = (uint8_t *)m_pAllocator->allocate(100);
+    ASSERT_NE(pSmall, nullptr);
+    EXPECT_EQ(m_pAllocator->reAllocate(pSmall, 101), pSmall);
+    EXPECT_EQ(m_pAllocator->reAllocate(pSmall, 99), pSmall);
+
+    // 新的分配器的第一个块后面都是空闲页，可以原地扩展，收缩时归还尾部的页
+    auto pLarge = (uint8_t *)m_pAllocator->allocate(100000);
+    ASSERT_NE(pLarge, nullptr);
+    memset(pLarge, 0x5A, 100000);
+    EXPECT_EQ(m_pAllocator->reAllocate(pLarge, 500000), pLarge);
+    memset(pLarge + 100000, 0x5A, 400000);
+    EXPECT_EQ(m_pAllocator->reAllocate(pLarge, 70000), pLarge);
+    EXPECT_EQ(pLarge[69999], 0x5A);
+
+    // 超大块由 mremap 扩展，数据不经过拷贝保留下来
+    auto pHuge = (uint8_t *)m_pAllocator->allocate(8 * 1024 * 1024);
+    ASSERT_NE(pHuge, nullptr);
+    pHuge[0] = 1;
+    pHuge[8 * 1024 * 1024 - 1] = 2;
+    pHuge = (uint8_t *)m_pAllocator->reAllocate(pHuge, 64 * 1024 * 1024);
+    ASSERT_NE(pHuge, nullptr);
+    EXPECT_EQ(pHuge[0], 1);
+    EXPECT_EQ(pHuge[8 * 1024 * 1024 - 1], 2);
+    pHuge[64 * 1024 * 1024 - 1] = 3;
+
+    IAllocator::MemoryStats memoryStats;
+    ASSERT_EQ(m_pAllocator->getMemoryStats(&memoryStats), 0);
+    EXPECT_GE(memoryStats.uMappedSize, 64u * 1024 * 1024);
+    EXPECT_EQ(m_pAllocator->reAllocate(pHuge, 4 * 1024 * 1024), pHuge);
+    EXPECT_EQ(pHuge[0], 1);
+    ASSERT_EQ(m_pAllocator->getMemoryStats(&memoryStats), 0);
+    EXPECT_LT(memoryStats.uMappedSize, 16u * 1024 * 1024);
+
+    m_pAllocator->free(pSmall);
+    m_pAllocator->free(pLarge);
+    m_pAllocator->free(pHuge);
+
+    // 原地扩展和收缩的字节数计入统计，保持平衡
+    IAllocator::AllocateStats arrStats[16];
+    uint32_t uThreadCount = 16;
+    ASSERT_EQ(m_pAllocator->getAllocateStats(arrStats, &uThreadCount), 0);
+    uint64_t uAllocatedSize = 0, uFreedSize = 0;
+    for (uint32_t i = 0; i < uThreadCount; i++)
+    {
+        uAllocatedSize += arrStats[i].uAllocatedSize;
+        uFreedSize += arrStats[i].uFreedSize;
+    }
+    EXPECT_EQ(uAllocatedSize, uFreedSize);
+}
+
+// 测试预热：reserve 不计入统计，之后的小块与大块分配都不再映射新的内存
+TEST_F(AllocatorTest, Reserve)
+{
+    ASSERT_EQ(m_pAllocator->reserve(100, 1000), 0);
+    ASSERT_EQ(m_pAllocator->reserve(200000, 20), 0);
+
+    IAllocator::MemoryStats before;
+    ASSERT_EQ(m_pAllocator->getMemoryStats(&before), 0);
+    EXPECT_GE(before.uMappedSize, 3u * 2 * 1024 * 1024);
+
+    std::vector<void *> vecSmall(1000);
+    std::vector<void *> vecLarge(20);
+    for (auto &pMemory : vecSmall)
+    {
+        pMemory = m_pAllocator->allocate(100);
+        ASSERT_NE(pMemory, nullptr);
+    }
+    for (auto &pMemory : vecLarge)
+    {
+        pMemory = m_pAllocator->allocate(200000);
+        ASSERT_NE(pMemory, nullptr);
+    }
+
+    IAllocator::MemoryStats after;
+    ASSERT_EQ(m_pAllocator->getMemoryStats(&after), 0);
+    EXPECT_EQ(after.uMappedSize, before.uMappedSize);
+
+    IAllocator::AllocateStats stats;
+    uint32_t uThreadCount = 1;
+    ASSERT_EQ(m_pAllocator->getAllocateStats(&stats, &uThreadCount), 0);
+    EXPECT_EQ(stats.uAllocatedCount, 1020u);
+
+    // 释放后预留的空块保持映射
+    for (auto pMemory : vecSmall)
+    {
+        m_pAllocator->free(pMemory);
+    }
+    for (auto pMemory : vecLarge)
+    {
+        m_pAllocator->free(pMemory);
+    }
+    ASSERT_EQ(m_pAllocator->getMemoryStats(&after), 0);
+    EXPECT_EQ(after.uMappedSize, before.uMappedSize);
+
+    EXPECT_EQ(m_pAllocator->reserve(8 * 1024 * 1024, 1), -1);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kInvalidParam);
+}
+
+// 测试统计信息中分配和释放的字节数一致
+TEST_F(AllocatorTest, AllocateStatsBalanced)
+{
+    const uint64_t arrSizes[] = {1, 33, 500, 4000, 70000, 3 * 1024 * 1024};
+    for (auto uSize : arrSizes)
+    {
+        m_pAllocator->free(m_pAllocator->allocate(uSize));
+    }
+
+    IAllocator::AllocateStats arrStats[16];
+    uint32_t uThreadCount = 16;
+    ASSERT_EQ(m_pAllocator->getAllocateStats(arrStats, &uThreadCount), 0);
+    ASSERT_GE(uThreadCount, 1u);
+
+    uint64_t uAllocatedSize = 0, uFreedSize = 0, uAllocatedCount = 0, uFreedCount = 0;
+    for (uint32_t i = 0; i < uThreadCount; i++)
+    {
+        uAllocatedSize += arrStats[i].uAllocatedSize;
+        uFreedSize += arrStats[i].uFreedSize;
+        uAllocatedCount += arrStats[i].uAllocatedCount;
+        uFreedCount += arrStats[i].uFreedCount;
+    }
+    EXPECT_EQ(uAllocatedCount, 6u);
+    EXPECT_EQ(uAllocatedCount, uFreedCount);
+    EXPECT_EQ(uAllocatedSize, uFreedSize);
+}
+
+// 测试每个工作线程第一次分配时创建自己的线程缓存，统计按线程返回，退出的线程合并为 uTid 为 0 的一项
+TEST_F(AllocatorTest, AllocateStatsPerThread)
+{
+    const uint32_t kThreadCount = 4;
+    std::atomic<uint32_t> uReadyCount{0};
+    std::atomic<bool> bDone{false};
+    std::vector<std::thread> vecThreads;
+    for (uint32_t i = 0; i < kThreadCount; i++)
+    {
+        vecThreads.emplace_back([this, i, &uReadyCount, &bDone]() {
+            for (uint32_t j = 0; j <= i; j++)
+            {
+                m_pAllocator->free(m_pAllocator->allocate(64));
+            }
+            uReadyCount++;
+            while (!bDone.load())
+            {
+                std::this_thread::yield();
+            }
+        });
+    }
+    while (uReadyCount.load() < kThreadCount)
+    {
+        std::this_thread::yield();
+    }
+
+    IAllocator::AllocateStats arrStats[16];
+    uint32_t uThreadCount = 16;
+    ASSERT_EQ(m_pAllocator->getAllocateStats(arrStats, &uThreadCount), 0);
+    EXPECT_EQ(uThreadCount, kThreadCount);
+
+    std::vector<uint64_t> vecCounts;
+    for (uint32_t i = 0; i < uThreadCount; i++)
+    {
+        EXPECT_NE(arrStats[i].uTid, 0u);
+        EXPECT_EQ(arrStats[i].uAllocatedCount, arrStats[i].uFreedCount);
+        vecCounts.push_back(arrStats[i].uAllocatedCount);
+    }
+    std::sort(vecCounts.begin(), vecCounts.end());
+    EXPECT_EQ(vecCounts, std::vector<uint64_t>({1, 2, 3, 4}));
+
+    bDone = true;
+    for (auto &thread : vecThreads)
+    {
+        thread.join();
+    }
+
+    // 新线程复用退出线程留下的线程缓存，统计重新开始
+    std::thread([this]() {
+        m_pAllocator->free(m_pAllocator->allocate(64));
+    }).join();
+
+    uThreadCount = 16;
+    ASSERT_EQ(m_pAllocator->getAllocateStats(arrStats, &uThreadCount), 0);
+    ASSERT_EQ(uThreadCount, 1u);
+    EXPECT_EQ(arrStats[0].uTid, 0u);
+    EXPECT_EQ(arrStats[0].uAllocatedCount, 11u);
+    EXPECT_EQ(arrStats[0].uFreedCount, 11u);
+    EXPECT_EQ(arrStats[0].uAllocatedSize, arrStats[0].uFreedSize);
+}
+
+// 测试释放不属于该分配器的内存
+TEST_F(AllocatorTest, FreeForeignMemory)
+{
+    auto pOther = lldkCreateAllocator("test.FreeForeignMemory.other", 0);
+    ASSERT_NE(pOther, nullptr);
+
+    void *pMemory = pOther->allocate(64);
+    ASSERT_NE(pMemory, nullptr);
+
+    m_pAllocator->free(pMemory);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kInvalidParam);
+
+    pOther->free(pMemory);
+    lldkDestroyAllocator(pOther);
+
+    // 2MB 对齐的地址上没有映射的指针不会读到未映射的内存
+    const uint64_t uChunkSize = 2 * 1024 * 1024;
+    auto pRegion = (uint8_t *)mmap(nullptr, 2 * uChunkSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_NE(pRegion, MAP_FAILED);
+    auto pBase = (uint8_t *)(((uintptr_t)pRegion + uChunkSize - 1) & ~(uintptr_t)(uChunkSize - 1));
+    ASSERT_EQ(munmap(pBase, 4096), 0);
+    void *pUnmappedBase = pBase + 65536;
+
+    m_pAllocator->free(pUnmappedBase);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kInvalidParam);
+    EXPECT_EQ(m_pAllocator->reAllocate(pUnmappedBase, 100), nullptr);
+    EXPECT_EQ(m_pAllocator->getUsableSize(pUnmappedBase), 0u);
+    munmap(pRegion, 2 * uChunkSize);
+}
+
+// 测试生产者线程分配、消费者线程释放
+TEST_F(AllocatorTest, CrossThreadFree)
+{
+    const int kCount = 100000;
+    std::vector<void *> vecQueue;
+    std::mutex mutex;
+    std::atomic<bool> bDone{false};
+
+    std::thread producer([&]() {
+        for (int i = 0; i < kCount; i++)
+        {
+            auto pMemory = (uint32_t *)m_pAllocator->allocate(32 + (i % 8) * 64);
+            ASSERT_NE(pMemory, nullptr);
+            *pMemory = (uint32_t)i;
+            std::lock_guard<std::mutex> lock(mutex);
+            vecQueue.push_back(pMemory);
+        }
+        bDone = true;
+    });
+
+    std::thread consumer([&]() {
+        int iFreed = 0;
+        std::vector<void *> vecLocal;
+        while (iFreed < kCount)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                vecLocal.swap(vecQueue);
+            }
+            for (auto pMemory : vecLocal)
+            {
+                m_pAllocator->free(pMemory);
+                iFreed++;
+            }
+            vecLocal.clear();
+        }
+    });
+
+    producer.join();
+    consumer.join();
+    EXPECT_TRUE(bDone.load());
+
+    IAllocator::AllocateStats arrStats[16];
+    uint32_t uThreadCount = 16;
+    ASSERT_EQ(m_pAllocator->getAllocateStats(arrStats, &uThreadCount), 0);
+
+    uint64_t uAllocatedSize = 0, uFreedSize = 0, uAllocatedCount = 0, uFreedCount = 0;
+    for (uint32_t i = 0; i < uThreadCount; i++)
+    {
+        uAllocatedSize += arrStats[i].uAllocatedSize;
+        uFreedSize += arrStats[i].uFreedSize;
+        uAllocatedCount += arrStats[i].uAllocatedCount;
+        uFreedCount += arrStats[i].uFreedCount;
+    }
+    EXPECT_EQ(uAllocatedCount, (uint64_t)kCount);
+    EXPECT_EQ(uFreedCount, (uint64_t)kCount);
+    EXPECT_EQ(uAllocatedSize, uFreedSize);
+}
+
+// 测试分配线程退出后，其他线程释放的对象回到中心链表，空的页归还给页堆
+TEST_F(AllocatorTest, FreeAfterOwnerExit)
+{
+    const int kCount = 200000;
+    std::vector<void *> vecMemory(kCount);
+
+    // 主线程先有自己的缓存，不会接手退出线程留下的缓存
+    m_pAllocator->free(m_pAllocator->allocate(64));
+    std::thread producer([&]() {
+        for (int i = 0; i < kCount; i++)
+        {
+            vecMemory[i] = m_pAllocator->allocate(64);
+            ASSERT_NE(vecMemory[i], nullptr);
+        }
+    });
+    producer.join();
+
+    IAllocator::MemoryStats peakStats;
+    ASSERT_EQ(m_pAllocator->getMemoryStats(&peakStats), 0);
+    EXPECT_GE(peakStats.uMappedSize, (uint64_t)kCount * 64);
+
+    // 退出线程的缓存已经停用，释放不会积压在它的远程链表中
+    for (auto pMemory : vecMemory)
+    {
+        m_pAllocator->free(pMemory);
+    }
+
+    IAllocator::MemoryStats memoryStats;
+    ASSERT_EQ(m_pAllocator->getMemoryStats(&memoryStats), 0);
+    EXPECT_LT(memoryStats.uMappedSize, peakStats.uMappedSize / 2);
+}
+
+// 测试拥有 span 的线程仍然存活但不再分配时，其它线程释放的对象不会积压在它的远程链表中
+TEST_F(AllocatorTest, FreeToIdleOwner)
+{
+    const int kCount = 200000;
+    std::vector<void *> vecMemory(kCount);
+    std::atomic<bool> bAllocated{false};
+    std::atomic<bool> bFreed{false};
+
+    m_pAllocator->free(m_pAllocator->allocate(64));
+    std::thread producer([&]() {
+        for (int i = 0; i < kCount; i++)
+        {
+            vecMemory[i] = m_pAllocator->allocate(64);
+            ASSERT_NE(vecMemory[i], nullptr);
+        }
+        bAllocated = true;
+        while (!bFreed.load())
+        {
+            std::this_thread::yield();
+        }
+    });
+    while (!bAllocated.load())
+    {
+        std::this_thread::yield();
+    }
+
+    IAllocator::MemoryStats peakStats;
+    ASSERT_EQ(m_pAllocator->getMemoryStats(&peakStats), 0);
+    for (auto pMemory : vecMemory)
+    {
+        m_pAllocator->free(pMemory);
+    }
+
+    IAllocator::MemoryStats memoryStats;
+    ASSERT_EQ(m_pAllocator->getMemoryStats(&memoryStats), 0);
+    EXPECT_LT(memoryStats.uMappedSize, peakStats.uMappedSize / 2);
+    bFreed = true;
+    producer.join();
+}
+
+// 测试多线程各自分配释放
+TEST_F(AllocatorTest, MultiThreadChurn)
+{
+    std::vector<std::thread> vecThreads;
+    for (int t = 0; t < 4; t++)
+    {
+        vecThreads.emplace_back([this, t]() {
+            std::vector<uint64_t *> vecMemory;
+            for (int round = 0; round < 20; round++)
+            {
+                for (int i = 0; i < 1000; i++)
+                {
+                    auto pMemory = (uint64_t *)m_pAllocator->allocate(16 + (i % 32) * 16);
+                    ASSERT_NE(pMemory, nullptr);
+                    *pMemory = ((uint64_t)t << 32) | (uint64_t)i;
+                    vecMemory.push_back(pMemory);
+                }
+                for (size_t i = 0; i < vecMemory.size(); i++)
+                {
+                    ASSERT_EQ(*vecMemory[i], ((uint64_t)t << 32) | (uint64_t)i);
+                    m_pAllocator->free(vecMemory[i]);
+                }
+                vecMemory.clear();
+            }
+        });
+    }
+
+    for (auto &thread : vecThreads)
+    {
+        thread.join();
+    }
+}
+
+// 测试 uMaxSizeMB 预留的内存用尽后分配失败并返回 kNoMemory
+TEST(AllocatorBudget, FailFastPastBudget)
+{
+    auto pAllocator = lldkCreateAllocator("test.FailFastPastBudget", 8);
+    ASSERT_NE(pAllocator, nullptr);
+
+    std::vector<void *> vecMemory;
+    uint64_t uTotalSize = 0;
+    while (true)
+    {
+        void *pMemory = pAllocator->allocate(256 * 1024);
+        if (pMemory == nullptr)
+        {
+            EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kNoMemory);
+            break;
+        }
+        memset(pMemory, 0, 256 * 1024);
+        uTotalSize += 256 * 1024;
+        vecMemory.push_back(pMemory);
+        ASSERT_LE(uTotalSize, 8u * 1024 * 1024);
+    }
+    EXPECT_GT(uTotalSize, 0u);
+    EXPECT_EQ(pAllocator->allocate(16 * 1024 * 1024), nullptr);
+
+    for (auto pMemory : vecMemory)
+    {
+        pAllocator->free(pMemory);
+    }
+
+    // 释放后预留的内存可以再次使用
+    void *pMemory = pAllocator->allocate(256 * 1024);
+    EXPECT_NE(pMemory, nullptr);
+    pAllocator->free(pMemory);
+    lldkDestroyAllocator(pAllocator);
+}
+
+// 测试预先缺页的预留内存
+TEST(AllocatorBudget, Prefault)
+{
+    IAllocator::Config config {4, IAllocator::kConfigPrefault, 0};
+    auto pAllocator = lldkCreateAllocatorWithConfig("test.Prefault", &config);
+    ASSERT_NE(pAllocator, nullptr);
+
+    void *pMemory = pAllocator->allocate(1024);
+    EXPECT_NE(pMemory, nullptr);
+    pAllocator->free(pMemory);
+    lldkDestroyAllocator(pAllocator);
+
+    // 没有预留内存时不能预先缺页
+    config.uMaxSizeMB = 0;
+    EXPECT_EQ(lldkCreateAllocatorWithConfig("test.PrefaultNoBudget", &config), nullptr);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kInvalidParam);
+}
+
+// 测试按对齐要求分配：小对象、大块与独立映射都满足对齐
+TEST_F(AllocatorTest, AllocateAligned)
+{
+    std::vector<void *> vecMemory;
+    for (uint64_t uAlign = 1; uAlign <= IAllocator::kMaxAlignment; uAlign <<= 1)
+    {
+        for (uint64_t uSize : {0ULL, 1ULL, 24ULL, 100ULL, 1000ULL, 5000ULL, 40000ULL, 3000000ULL})
+        {
+            void *pMemory = m_pAllocator->allocateAligned(uSize, uAlign);
+            ASSERT_NE(pMemory, nullptr) << "size " << uSize << " align " << uAlign;
+            EXPECT_EQ((uintptr_t)pMemory % uAlign, 0u) << "size " << uSize << " align " << uAlign;
+            memset(pMemory, 0x5A, uSize);
+            vecMemory.push_back(pMemory);
+        }
+    }
+
+    for (auto pMemory : vecMemory)
+    {
+        m_pAllocator->free(pMemory);
+    }
+
+    EXPECT_EQ(m_pAllocator->allocateAligned(64, 48), nullptr);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kInvalidParam);
+    EXPECT_EQ(m_pAllocator->allocateAligned(64, IAllocator::kMaxAlignment << 1), nullptr);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kInvalidParam);
+
+    // 向对齐取整会回绕的大小返回空，不会返回一个很小的块
+    EXPECT_EQ(m_pAllocator->allocateAligned(UINT64_MAX - 30, 64), nullptr);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kNoMemory);
+    EXPECT_EQ(m_pAllocator->allocateAligned(UINT64_MAX - 100000, 4096), nullptr);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kNoMemory);
+
+    auto pCounter = m_pAllocator->newObject<CachelineCounter>();
+    ASSERT_NE(pCounter, nullptr);
+    EXPECT_EQ((uintptr_t)pCounter % LLDK_CACHELINE_SIZE, 0u);
+    m_pAllocator->deleteObject(pCounter);
+}
+
+// 测试带大小的释放：内存被复用且统计保持平衡
+TEST_F(AllocatorTest, SizedFree)
+{
+    for (uint64_t uSize : {1ULL, 16ULL, 100ULL, 1000ULL, 32768ULL, 100000ULL})
+    {
+        void *pMemory = m_pAllocator->allocate(uSize);
+        ASSERT_NE(pMemory, nullptr);
+        m_pAllocator->free(pMemory, uSize);
+        EXPECT_EQ(m_pAllocator->allocate(uSize), pMemory) << "size " << uSize;
+        m_pAllocator->free(pMemory, uSize);
+    }
+
+    IAllocator::AllocateStats stats;
+    uint32_t uThreadCount = 1;
+    ASSERT_EQ(m_pAllocator->getAllocateStats(&stats, &uThreadCount), 0);
+    ASSERT_EQ(uThreadCount, 1u);
+    EXPECT_EQ(stats.uAllocatedCount, stats.uFreedCount);
+    EXPECT_EQ(stats.uAllocatedSize, stats.uFreedSize);
+}
+
+// 测试带大小的释放同样检查外来指针，并把其他线程 span 的对象交回给所属线程
+TEST_F(AllocatorTest, SizedFreeRemote)
+{
+    uint64_t uForeign = 0;
+    m_pAllocator->free(&uForeign, sizeof(uForeign));
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kInvalidParam);
+
+    const int kCount = 1000;
+    std::vector<void *> vecFreed(kCount);
+    std::atomic<int> iStage{0};
+    int iReused = 0;
+    std::thread owner([&]() {
+        for (auto &pMemory : vecFreed)
+        {
+            pMemory = m_pAllocator->allocate(64);
+            ASSERT_NE(pMemory, nullptr);
+        }
+        iStage = 1;
+        while (iStage.load() != 2)
+        {
+            std::this_thread::yield();
+        }
+
+        // 所属线程补充时取回其他线程释放的对象
+        std::set<void *> setFreed(vecFreed.begin(), vecFreed.end());
+        std::vector<void *> vecMemory(kCount);
+        for (auto &pMemory : vecMemory)
+        {
+            pMemory = m_pAllocator->allocate(64);
+            iReused += setFreed.count(pMemory) != 0 ? 1 : 0;
+        }
+        for (auto pMemory : vecMemory)
+        {
+            m_pAllocator->free(pMemory, 64);
+        }
+    });
+
+    while (iStage.load() != 1)
+    {
+        std::this_thread::yield();
+    }
+    m_pAllocator->free(m_pAllocator->allocate(64), 64);
+    for (auto pMemory : vecFreed)
+    {
+        m_pAllocator->free(pMemory, 64);
+    }
+    iStage = 2;
+    owner.join();
+    EXPECT_GE(iReused, kCount / 2);
+}
+
+struct BaseObject
+{
+    virtual ~BaseObject() = default;
+    uint64_t uValue{0};
+};
+
+struct DerivedObject : public BaseObject
+{
+    uint8_t arrData[200];
+};
+
+// 测试通过基类指针删除派生类对象，按派生类的大小释放，统计保持平衡
+TEST_F(AllocatorTest, DeleteDerivedThroughBase)
+{
+    for (int i = 0; i < 100; i++)
+    {
+        BaseObject *pObject = m_pAllocator->newObject<DerivedObject>();
+        ASSERT_NE(pObject, nullptr);
+        m_pAllocator->deleteObject(pObject);
+    }
+
+    IAllocator::AllocateStats stats;
+    uint32_t uThreadCount = 1;
+    ASSERT_EQ(m_pAllocator->getAllocateStats(&stats, &uThreadCount), 0);
+    EXPECT_EQ(stats.uAllocatedCount, 100u);
+    EXPECT_EQ(stats.uFreedCount, 100u);
+    EXPECT_EQ(stats.uAllocatedSize, stats.uFreedSize);
+}
+
+// 测试批量分配与释放：块互不重叠，跨越多次补充，统计保持平衡
+TEST_F(AllocatorTest, AllocateBatch)
+{
+    for (uint64_t uSize : {0ULL, 24ULL, 256ULL, 4096ULL, 100000ULL})
+    {
+        std::vector<void *> vecMemory(1000);
+        ASSERT_EQ(m_pAllocator->allocateBatch(uSize, vecMemory.size(), vecMemory.data()), vecMemory.size());
+
+        std::set<void *> setMemory(vecMemory.begin(), vecMemory.end());
+        EXPECT_EQ(setMemory.size(), vecMemory.size()) << "size " << uSize;
+        for (auto pMemory : vecMemory)
+        {
+            ASSERT_NE(pMemory, nullptr);
+            EXPECT_EQ((uintptr_t)pMemory % IAllocator::kDefaultAlignment, 0u);
+            memset(pMemory, 0x5A, uSize);
+        }
+        m_pAllocator->freeBatch(vecMemory.data(), vecMemory.size());
+    }
+
+    // 批量分配的块可以逐个释放，反之亦然
+    void *arrMemory[3];
+    ASSERT_EQ(m_pAllocator->allocateBatch(64, 3, arrMemory), 3u);
+    m_pAllocator->free(arrMemory[0]);
+    m_pAllocator->free(arrMemory[1], 64);
+    arrMemory[0] = m_pAllocator->allocate(10);
+    arrMemory[1] = m_pAllocator->allocate(50000);
+    m_pAllocator->freeBatch(arrMemory, 3);
+
+    EXPECT_EQ(m_pAllocator->allocateBatch(64, 1, nullptr), 0u);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kInvalidParam);
+
+    IAllocator::AllocateStats stats;
+    uint32_t uThreadCount = 1;
+    ASSERT_EQ(m_pAllocator->getAllocateStats(&stats, &uThreadCount), 0);
+    ASSERT_EQ(uThreadCount, 1u);
+    EXPECT_EQ(stats.uAllocatedCount, stats.uFreedCount);
+    EXPECT_EQ(stats.uAllocatedSize, stats.uFreedSize);
+}
+
+// 测试预算耗尽时批量分配返回已分配的数量
+TEST(AllocatorBudget, AllocateBatchPastBudget)
+{
+    auto pAllocator = lldkCreateAllocator("test.AllocateBatchPastBudget", 4);
+    ASSERT_NE(pAllocator, nullptr);
+
+    std::vector<void *> vecMemory(8 * 1024);
+    uint64_t uAllocated = pAllocator->allocateBatch(1024, vecMemory.size(), vecMemory.data());
+    EXPECT_GT(uAllocated, 0u);
+    EXPECT_LT(uAllocated, vecMemory.size());
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kNoMemory);
+    pAllocator->freeBatch(vecMemory.data(), uAllocated);
+    lldkDestroyAllocator(pAllocator);
+}
+
+// 测试后台回收：空闲超过设定时间的空闲页归还给系统，再次分配时统计随之减少
+TEST(AllocatorBudget, Scavenge)
+{
+    IAllocator::Config config {0, 0, 20};
+    auto pAllocator = lldkCreateAllocatorWithConfig("test.Scavenge", &config);
+    ASSERT_NE(pAllocator, nullptr);
+
+    const uint64_t kSize = 1 << 20;
+    auto pMemory = (uint8_t *)pAllocator->allocate(kSize);
+    ASSERT_NE(pMemory, nullptr);
+    memset(pMemory, 0x5A, kSize);
+    pAllocator->free(pMemory);
+
+    IAllocator::MemoryStats stats;
+    for (uint32_t i = 0; i < 200; i++)
+    {
+        ASSERT_EQ(pAllocator->getMemoryStats(&stats), 0);
+        if (stats.uScavengedSize >= kSize)
+        {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_GE(stats.uScavengedSize, kSize);
+    EXPECT_GE(stats.uTotalScavengedSize, stats.uScavengedSize);
+    EXPECT_LE(stats.uScavengedSize, stats.uMappedSize);
+
+    // 归还的页再次使用时重新缺页，内容为 0
+    auto pAgain = (uint8_t *)pAllocator->allocate(kSize);
+    ASSERT_NE(pAgain, nullptr);
+    if (pAgain == pMemory)
+    {
+        EXPECT_EQ(pAgain[0], 0);
+        EXPECT_EQ(pAgain[kSize - 1], 0);
+    }
+
+    IAllocator::MemoryStats statsAgain;
+    ASSERT_EQ(pAllocator->getMemoryStats(&statsAgain), 0);
+    EXPECT_LT(statsAgain.uScavengedSize, stats.uScavengedSize);
+    pAllocator->free(pAgain);
+    lldkDestroyAllocator(pAllocator);
+
+    // 最近释放的页不会被回收
+    config.uScavengeIdleMs = 60000;
+    pAllocator = lldkCreateAllocatorWithConfig("test.ScavengeIdle", &config);
+    ASSERT_NE(pAllocator, nullptr);
+    pAllocator->free(pAllocator->allocate(kSize));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(pAllocator->getMemoryStats(&stats), 0);
+    EXPECT_EQ(stats.uScavengedSize, 0u);
+    lldkDestroyAllocator(pAllocator);
+
+    // 预先缺页或锁定的内存不能回收
+    IAllocator::Config prefaultConfig {4, IAllocator::kConfigPrefault, 20};
+    EXPECT_EQ(lldkCreateAllocatorWithConfig("test.ScavengePrefault", &prefaultConfig), nullptr);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kInvalidParam);
+}
+
+// 测试大页配置：没有预留大页时回退到透明大页，统计值保持自洽
+TEST(AllocatorBudget, HugePage)
+{
+    for (uint64_t uMaxSizeMB : {0ULL, 8ULL})
+    {
+        IAllocator::Config config {uMaxSizeMB, IAllocator::kConfigHugePage, 0};
+        auto pAllocator = lldkCreateAllocatorWithConfig("test.HugePage", &config);
+        ASSERT_NE(pAllocator, nullptr);
+
+        void *pSmall = pAllocator->allocate(64);
+        void *pLarge = pAllocator->allocate(256 * 1024);
+        ASSERT_NE(pSmall, nullptr);
+        ASSERT_NE(pLarge, nullptr);
+        memset(pLarge, 0x5A, 256 * 1024);
+
+        IAllocator::MemoryStats stats;
+        ASSERT_EQ(pAllocator->getMemoryStats(&stats), 0);
+        EXPECT_EQ(stats.uReservedSize, uMaxSizeMB << 20);
+        EXPECT_GT(stats.uMappedSize, 0u);
+        EXPECT_LE(stats.uHugeTlbSize, stats.uMappedSize);
+        EXPECT_LE(stats.uTransparentHugeSize, stats.uMappedSize + stats.uReservedSize);
+
+        pAllocator->free(pSmall);
+        pAllocator->free(pLarge);
+        lldkDestroyAllocator(pAllocator);
+    }
+
+    EXPECT_EQ(lldkGetAllocatorSingleton()->getMemoryStats(nullptr), -1);
+}
+
+// 测试绑定 NUMA 节点的分配器：单节点机器上退化为不绑定，未知节点创建失败
+TEST(AllocatorBudget, NumaNode)
+{
+    IAllocator::Config config {0, 0, 0};
+    for (int32_t iNumaNode : {(int32_t)IAllocator::kNumaNodeAny, (int32_t)IAllocator::kNumaNodeLocal, 0})
+    {
+        for (uint64_t uMaxSizeMB : {0ULL, 4ULL})
+        {
+            config.uMaxSizeMB = uMaxSizeMB;
+            auto pAllocator = lldkCreateNumaAllocator("test.NumaNode", &config, iNumaNode);
+            ASSERT_NE(pAllocator, nullptr) << "node " << iNumaNode;
+
+            void *pMemory = pAllocator->allocate(128 * 1024);
+            ASSERT_NE(pMemory, nullptr);
+            memset(pMemory, 0x5A, 128 * 1024);
+            pAllocator->free(pMemory);
+            lldkDestroyAllocator(pAllocator);
+        }
+    }
+
+    EXPECT_EQ(lldkCreateNumaAllocator("test.NumaNode", &config, 1 << 20), nullptr);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kInvalidParam);
+    EXPECT_EQ(lldkCreateNumaAllocator("test.NumaNode", &config, -3), nullptr);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kInvalidParam);
+}
+
+// 测试库内部分配的统计：多线程并发分配释放后各计数的增量准确
+TEST(AllocatorInternal, ShardedStats)
+{
+    IAllocator::AllocateStats statsBefore;
+    ASSERT_EQ(__lldkGetAllocateStats(&statsBefore), 0);
+
+    constexpr int32_t kThreadCount = 8;
+    constexpr int32_t kLoopCount = 10000;
+    std::vector<std::thread> vecThreads;
+    for (int32_t i = 0; i < kThreadCount; i++)
+    {
+        vecThreads.emplace_back([]() {
+            for (int32_t j = 0; j < kLoopCount; j++)
+            {
+                void *pMemory = __lldkAllocate(24);
+                ASSERT_NE(pMemory, nullptr);
+                __lldkFree(pMemory);
+            }
+        });
+    }
+    for (auto &thread : vecThreads)
+    {
+        thread.join();
+    }
+
+    IAllocator::AllocateStats statsAfter;
+    ASSERT_EQ(__lldkGetAllocateStats(&statsAfter), 0);
+    EXPECT_EQ(statsAfter.uAllocatedCount - statsBefore.uAllocatedCount, (uint64_t)kThreadCount * kLoopCount);
+    EXPECT_EQ(statsAfter.uAllocatedSize - statsBefore.uAllocatedSize, (uint64_t)kThreadCount * kLoopCount * 24);
+    EXPECT_EQ(statsAfter.uFreedCount - statsBefore.uFreedCount, (uint64_t)kThreadCount * kLoopCount);
+    EXPECT_EQ(statsAfter.uFreedSize - statsBefore.uFreedSize, (uint64_t)kThreadCount * kLoopCount * 24);
+    EXPECT_EQ(__lldkGetAllocateStats(nullptr), -1);
+}
+
+// 测试分配直方图：按 log2 统计请求大小与存活时间，未开启时查询失败
+TEST(AllocatorBudget, Histogram)
+{
+    IAllocator::Config config {0, IAllocator::kConfigHistogram, 0};
+    auto pAllocator = lldkCreateAllocatorWithConfig("test.Histogram", &config);
+    ASSERT_NE(pAllocator, nullptr);
+
+    std::vector<std::pair<void *, uint64_t>> vecMemory;
+    for (uint64_t uSize : {0ULL, 1ULL, 8ULL, 100ULL, 32760ULL, 32768ULL, 100000ULL, 3000000ULL})
+    {
+        void *pMemory = pAllocator->allocate(uSize);
+        ASSERT_NE(pMemory, nullptr);
+        // 可用大小不包括记录分配时间的字节，写满可用大小后分配时间仍然完整
+        uint64_t uUsableSize = pAllocator->getUsableSize(pMemory);
+        EXPECT_GE(uUsableSize, uSize);
+        memset(pMemory, 0x5A, uUsableSize);
+        vecMemory.emplace_back(pMemory, uSize);
+    }
+
+    auto pCounter = pAllocator->newObject<CachelineCounter>();
+    ASSERT_NE(pCounter, nullptr);
+    EXPECT_EQ((uintptr_t)pCounter % LLDK_CACHELINE_SIZE, 0u);
+    pCounter->uValue = ~0ULL;
+
+    // 加上记录分配时间的字节会回绕的大小返回空，不会变成一个小块
+    EXPECT_EQ(pAllocator->allocate(UINT64_MAX), nullptr);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kNoMemory);
+    EXPECT_EQ(pAllocator->reAllocate(vecMemory[0].first, UINT64_MAX - 4), nullptr);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kNoMemory);
+    EXPECT_EQ(pAllocator->reserve(UINT64_MAX, 1), -1);
+
+    IAllocator::AllocateHistogram histogram;
+    ASSERT_EQ(pAllocator->getAllocateHistogram(&histogram), 0);
+    EXPECT_EQ(histogram.arrSizeCounts[0], 1u);
+    EXPECT_EQ(histogram.arrSizeCounts[1], 1u);
+    EXPECT_EQ(histogram.arrSizeCounts[4], 1u);
+    EXPECT_EQ(histogram.arrSizeCounts[7], 2u);
+    EXPECT_EQ(histogram.arrSizeCounts[15], 1u);
+    EXPECT_EQ(histogram.arrSizeCounts[16], 1u);
+    EXPECT_EQ(histogram.arrSizeCounts[17], 1u);
+    EXPECT_EQ(histogram.arrSizeCounts[22], 1u);
+
+    for (size_t i = 0; i < vecMemory.size(); i++)
+    {
+        // 一半使用带大小的释放
+        if (i % 2 == 0)
+        {
+            pAllocator->free(vecMemory[i].first, vecMemory[i].second);
+        }
+        else
+        {
+            pAllocator->free(vecMemory[i].first);
+        }
+    }
+    pAllocator->deleteObject(pCounter);
+
+    ASSERT_EQ(pAllocator->getAllocateHistogram(&histogram), 0);
+    uint64_t uLifetimeCount = 0;
+    for (uint32_t i = 0; i < IAllocator::kHistogramBucketCount; i++)
+    {
+        uLifetimeCount += histogram.arrLifetimeCounts[i];
+    }
+    EXPECT_EQ(uLifetimeCount, vecMemory.size() + 1);
+    // 写满请求的大小不会覆盖分配时间，生命周期不会因为时间被覆盖而变成 0
+    EXPECT_EQ(histogram.arrLifetimeCounts[0], 0u);
+
+    IAllocator::AllocateStats stats;
+    uint32_t uThreadCount = 1;
+    ASSERT_EQ(pAllocator->getAllocateStats(&stats, &uThreadCount), 0);
+    EXPECT_EQ(stats.uAllocatedSize, stats.uFreedSize);
+    lldkDestroyAllocator(pAllocator);
+
+    auto pPlainAllocator = lldkCreateAllocator("test.NoHistogram", 0);
+    ASSERT_NE(pPlainAllocator, nullptr);
+    EXPECT_EQ(pPlainAllocator->getAllocateHistogram(&histogram), -1);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kInvalidState);
+    lldkDestroyAllocator(pPlainAllocator);
+}
+
+// 读取整个文件的内容
+static std::string readFile(const std::string &sFileName)
+{
+    std::string sContent;
+    auto pFile = fopen(sFileName.c_str(), "r");
+    if (pFile != nullptr)
+    {
+        char arrBuffer[4096];
+        size_t uRead = 0;
+        while ((uRead = fread(arrBuffer, 1, sizeof(arrBuffer), pFile)) > 0)
+        {
+            sContent.append(arrBuffer, uRead);
+        }
+        fclose(pFile);
+    }
+    return sContent;
+}
+
+// 测试堆采样：采样间隔为 1 时每次分配都被采样，可以导出 pprof 与折叠栈两种格式
+TEST_F(AllocatorTest, HeapProfile)
+{
+    std::string sFileName = "/tmp/lldk_test_heap_profile." + std::to_string(getpid());
+    EXPECT_EQ(m_pAllocator->dumpHeapProfile(nullptr, IAllocator::kProfilePprof), -1);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kInvalidParam);
+
+    ASSERT_EQ(m_pAllocator->setSampleInterval(1), 0);
+    std::vector<void *> vecMemory;
+    for (int32_t i = 0; i < 100; i++)
+    {
+        vecMemory.push_back(m_pAllocator->allocate(1000));
+    }
+    ASSERT_EQ(m_pAllocator->setSampleInterval(0), 0);
+    vecMemory.push_back(m_pAllocator->allocate(1000));
+    for (auto pMemory : vecMemory)
+    {
+        m_pAllocator->free(pMemory);
+    }
+
+    ASSERT_EQ(m_pAllocator->dumpHeapProfile(sFileName.c_str(), IAllocator::kProfilePprof), 0);
+    std::string sContent = readFile(sFileName);
+    EXPECT_EQ(sContent.find("heap profile:      0:        0 [   100:   100000] @ heap_v2/1\n"), 0u) << sContent;
+    EXPECT_NE(sContent.find("\nMAPPED_LIBRARIES:\n"), std::string::npos);
+
+    ASSERT_EQ(m_pAllocator->dumpHeapProfile(sFileName.c_str(), IAllocator::kProfileCollapsed), 0);
+    sContent = readFile(sFileName);
+    ASSERT_FALSE(sContent.empty());
+    uint64_t uTotalWeight = 0;
+    size_t uLineStart = 0;
+    while (uLineStart < sContent.size())
+    {
+        size_t uLineEnd = sContent.find('\n', uLineStart);
+        ASSERT_NE(uLineEnd, std::string::npos);
+        size_t uSpace = sContent.rfind(' ', uLineEnd);
+        ASSERT_GT(uSpace, uLineStart);
+        uTotalWeight += std::stoull(sContent.substr(uSpace + 1, uLineEnd - uSpace - 1));
+        uLineStart = uLineEnd + 1;
+    }
+    EXPECT_EQ(uTotalWeight, 100000u);
+    remove(sFileName.c_str());
+}
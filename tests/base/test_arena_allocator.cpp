@@ -0,0 +1,210 @@
+#include "gtest/gtest.h"
+#include "lldk/base/arena_allocator.h"
+#include "lldk/common/error_code.h"
+#include <cstring>
+
+using namespace lldk::base;
+
+// 测试辅助类：每个用例使用块大小为 4KB 的 arena 分配器
+class ArenaAllocatorTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        m_pArena = lldkCreateArenaAllocator("test.arena", nullptr, 4096);
+        ASSERT_NE(m_pArena, nullptr);
+    }
+
+    void TearDown() override
+    {
+        lldkDestroyArenaAllocator(m_pArena);
+    }
+
+    IArenaAllocator *m_pArena{nullptr};
+};
+
+// 测试分配的内存连续递增、16 字节对齐且互不重叠，每个分配前有 16 字节记录大小
+TEST_F(ArenaAllocatorTest, BumpAllocate)
+{
+    auto pFirst = (uint8_t *)m_pArena->allocate(10);
+    auto pSecond = (uint8_t *)m_pArena->allocate(100);
+    auto pThird = (uint8_t *)m_pArena->allocate(0);
+    ASSERT_NE(pFirst, nullptr);
+    ASSERT_NE(pSecond, nullptr);
+    ASSERT_NE(pThird, nullptr);
+    EXPECT_EQ((uintptr_t)pFirst % 16, 0u);
+    EXPECT_EQ(pSecond, pFirst + 16 + 16);
+    EXPECT_EQ(pThird, pSecond + 112 + 16);
+
+    // 超过块大小的分配使用单独的块
+    auto pLarge = (uint8_t *)m_pArena->allocate(10000);
+    ASSERT_NE(pLarge, nullptr);
+    memset(pLarge, 0x5A, 10000);
+
+    IAllocator::MemoryStats stats;
+    ASSERT_EQ(m_pArena->getMemoryStats(&stats), 0);
+    EXPECT_GE(stats.uMappedSize, 4096u + 10000u);
+}
+
+// 测试 reset 后复用同一个块，free 不做任何事
+TEST_F(ArenaAllocatorTest, ResetReusesBlocks)
+{
+    void *pFirst = m_pArena->allocate(64);
+    m_pArena->free(pFirst);
+    EXPECT_NE(m_pArena->allocate(64), pFirst);
+
+    for (int32_t i = 0; i < 200; i++)
+    {
+        ASSERT_NE(m_pArena->allocate(100), nullptr);
+    }
+
+    IAllocator::MemoryStats statsBefore;
+    ASSERT_EQ(m_pArena->getMemoryStats(&statsBefore), 0);
+
+    m_pArena->reset();
+    EXPECT_EQ(m_pArena->allocate(64), pFirst);
+    for (int32_t i = 0; i < 200; i++)
+    {
+        ASSERT_NE(m_pArena->allocate(100), nullptr);
+    }
+
+    IAllocator::MemoryStats statsAfter;
+    ASSERT_EQ(m_pArena->getMemoryStats(&statsAfter), 0);
+    EXPECT_EQ(statsAfter.uMappedSize, statsBefore.uMappedSize);
+
+    IAllocator::AllocateStats allocateStats;
+    uint32_t uThreadCount = 1;
+    m_pArena->reset();
+    ASSERT_EQ(m_pArena->getAllocateStats(&allocateStats, &uThreadCount), 0);
+    EXPECT_EQ(uThreadCount, 1u);
+    EXPECT_EQ(allocateStats.uAllocatedCount, 403u);
+    EXPECT_EQ(allocateStats.uFreedCount, allocateStats.uAllocatedCount);
+    EXPECT_EQ(allocateStats.uFreedSize, allocateStats.uAllocatedSize);
+}
+
+// 测试回退到标记位置，跨块的标记同样有效
+TEST_F(ArenaAllocatorTest, RewindToMarker)
+{
+    ASSERT_NE(m_pArena->allocate(32), nullptr);
+    auto marker = m_pArena->getMarker();
+    void *pAfterMarker = m_pArena->allocate(32);
+    for (int32_t i = 0; i < 100; i++)
+    {
+        ASSERT_NE(m_pArena->allocate(256), nullptr);
+    }
+
+    m_pArena->rewind(marker);
+    EXPECT_EQ(m_pArena->allocate(32), pAfterMarker);
+
+    IAllocator::AllocateStats stats;
+    uint32_t uThreadCount = 1;
+    ASSERT_EQ(m_pArena->getAllocateStats(&stats, &uThreadCount), 0);
+    EXPECT_EQ(stats.uAllocatedCount - stats.uFreedCount, 2u);
+}
+
+// 测试最近一次分配原地扩展，其它分配复制数据
+TEST_F(ArenaAllocatorTest, ReAllocate)
+{
+    auto pFirst = (char *)m_pArena->allocate(16);
+    strcpy(pFirst, "hello arena");
+    auto pGrown = (char *)m_pArena->reAllocate(pFirst, 1024);
+    EXPECT_EQ(pGrown, pFirst);
+
+    ASSERT_NE(m_pArena->allocate(16), nullptr);
+    auto pMoved = (char *)m_pArena->reAllocate(pFirst, 2048);
+    ASSERT_NE(pMoved, nullptr);
+    EXPECT_NE(pMoved, pFirst);
+    EXPECT_STREQ(pMoved, "hello arena");
+
+    // 不是最近一次的分配缩小时原地保留，扩大时只复制原分配的 32 字节，不读到相邻的分配
+    auto pSmall = (uint8_t *)m_pArena->allocate(32);
+    ASSERT_NE(pSmall, nullptr);
+    memset(pSmall, 0x11, 32);
+    auto pNeighbour = (uint8_t *)m_pArena->allocate(64);
+    ASSERT_NE(pNeighbour, nullptr);
+    memset(pNeighbour, 0x22, 64);
+    EXPECT_EQ(m_pArena->reAllocate(pSmall, 20), pSmall);
+    EXPECT_EQ(m_pArena->getUsableSize(pSmall), 32u);
+
+    auto pGrownSmall = (uint8_t *)m_pArena->reAllocate(pSmall, 256);
+    ASSERT_NE(pGrownSmall, nullptr);
+    for (int32_t i = 0; i < 32; i++)
+    {
+        ASSERT_EQ(pGrownSmall[i], 0x11);
+    }
+
+    int32_t iForeign = 0;
+    EXPECT_EQ(m_pArena->reAllocate(&iForeign, 16), nullptr);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kInvalidParam);
+    EXPECT_EQ(m_pArena->getUsableSize(&iForeign), 0u);
+}
+
+// 测试按对齐要求分配，包括当前块剩余空间不足时换块
+TEST_F(ArenaAllocatorTest, AllocateAligned)
+{
+    for (uint64_t uAlign : {8ULL, 64ULL, 256ULL, 4096ULL})
+    {
+        for (int32_t i = 0; i < 20; i++)
+        {
+            ASSERT_NE(m_pArena->allocate(24), nullptr);
+            auto pMemory = m_pArena->allocateAligned(100, uAlign);
+            ASSERT_NE(pMemory, nullptr);
+            EXPECT_EQ((uintptr_t)pMemory % uAlign, 0u) << "align " << uAlign;
+            memset(pMemory, 0x5A, 100);
+            m_pArena->free(pMemory, 100);
+        }
+    }
+}
+
+
+// 测试批量分配在当前块内连续切分，放不下时换块
+TEST_F(ArenaAllocatorTest, AllocateBatch)
+{
+    void *arrMemory[300];
+    ASSERT_EQ(m_pArena->allocateBatch(20, 300, arrMemory), 300u);
+    for (uint32_t i = 1; i < 300; i++)
+    {
+        ASSERT_NE(arrMemory[i], nullptr);
+        if (arrMemory[i] != (uint8_t *)arrMemory[i - 1] + 48)
+        {
+            // 4KB 的块放得下 85 个 32 字节加 16 字节记录的块
+            EXPECT_EQ(i % 85, 0u);
+        }
+    }
+    m_pArena->freeBatch(arrMemory, 300);
+
+    IAllocator::AllocateStats stats;
+    uint32_t uThreadCount = 1;
+    ASSERT_EQ(m_pArena->getAllocateStats(&stats, &uThreadCount), 0);
+    EXPECT_EQ(stats.uAllocatedCount, 300u);
+    EXPECT_EQ(stats.uAllocatedSize, 300u * 32);
+    EXPECT_EQ(stats.uFreedCount, 0u);
+}
+
+// 测试预热：reserve 之后的分配不再申请新的块
+TEST_F(ArenaAllocatorTest, Reserve)
+{
+    ASSERT_NE(m_pArena->allocate(100), nullptr);
+    ASSERT_EQ(m_pArena->reserve(48, 1000), 0);
+
+    IAllocator::MemoryStats before;
+    ASSERT_EQ(m_pArena->getMemoryStats(&before), 0);
+    EXPECT_GE(before.uMappedSize, 1000u * 48);
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        ASSERT_NE(m_pArena->allocate(48), nullptr);
+    }
+
+    IAllocator::MemoryStats after;
+    ASSERT_EQ(m_pArena->getMemoryStats(&after), 0);
+    EXPECT_EQ(after.uMappedSize, before.uMappedSize);
+}
+
+// 测试非法参数
+TEST(ArenaAllocator, InvalidParam)
+{
+    EXPECT_EQ(lldkCreateArenaAllocator(nullptr, nullptr, 4096), nullptr);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kInvalidParam);
+    EXPECT_EQ(lldkCreateArenaAllocator("test.arena", nullptr, 0), nullptr);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kInvalidParam);
+}
@@ -0,0 +1,122 @@
+#include "gtest/gtest.h"
+#include "lldk/base/object_pool.h"
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace lldk::base;
+
+struct PoolObject
+{
+    PoolObject(uint64_t uId, const std::string &sName) : uId(uId), sName(sName) { s_iAliveCount++; }
+    ~PoolObject() { s_iAliveCount--; }
+
+    uint64_t uId;
+    std::string sName;
+    static int32_t s_iAliveCount;
+};
+
+int32_t PoolObject::s_iAliveCount = 0;
+
+struct ThrowingObject
+{
+    ThrowingObject() { throw std::runtime_error("construct failed"); }
+};
+
+// 测试对象的构造、析构与槽位复用
+TEST(LldkObjectPool, NewAndDeleteObject)
+{
+    LldkObjectPool<PoolObject> pool;
+    auto pObject = pool.newObject(1, "order");
+    ASSERT_NE(pObject, nullptr);
+    EXPECT_EQ(pObject->uId, 1u);
+    EXPECT_EQ(pObject->sName, "order");
+    EXPECT_EQ(PoolObject::s_iAliveCount, 1);
+    EXPECT_EQ(pool.getUsedCount(), 1u);
+
+    pool.deleteObject(pObject);
+    EXPECT_EQ(PoolObject::s_iAliveCount, 0);
+    EXPECT_EQ(pool.getUsedCount(), 0u);
+
+    // 最近释放的槽位最先被复用
+    auto pReused = pool.newObject(2, "event");
+    EXPECT_EQ(pReused, pObject);
+    pool.deleteObject(pReused);
+}
+
+// 测试跨多个块的增长，所有对象互不重叠且满足对齐
+TEST(LldkObjectPool, ChunkedGrowth)
+{
+    LldkObjectPool<PoolObject> pool(nullptr, 8);
+    std::vector<PoolObject *> vecObjects;
+    std::set<PoolObject *> setObjects;
+    for (uint64_t i = 0; i < 100; i++)
+    {
+        auto pObject = pool.newObject(i, std::to_string(i));
+        ASSERT_NE(pObject, nullptr);
+        EXPECT_EQ((uintptr_t)pObject % alignof(PoolObject), 0u);
+        EXPECT_TRUE(setObjects.insert(pObject).second);
+        vecObjects.push_back(pObject);
+    }
+    EXPECT_EQ(pool.getCapacity(), 104u);
+
+    for (uint64_t i = 0; i < vecObjects.size(); i++)
+    {
+        EXPECT_EQ(vecObjects[i]->uId, i);
+        EXPECT_EQ(vecObjects[i]->sName, std::to_string(i));
+        pool.deleteObject(vecObjects[i]);
+    }
+    EXPECT_EQ(PoolObject::s_iAliveCount, 0);
+    EXPECT_EQ(pool.getCapacity(), 104u);
+}
+
+// 测试固定容量：超过容量后分配失败，释放后可以再次分配
+TEST(LldkObjectPool, FixedCapacity)
+{
+    LldkObjectPool<uint64_t> pool(nullptr, 4, 10);
+    std::vector<uint64_t *> vecObjects;
+    for (uint64_t i = 0; i < 10; i++)
+    {
+        auto pObject = pool.newObject(i);
+        ASSERT_NE(pObject, nullptr);
+        vecObjects.push_back(pObject);
+    }
+
+    EXPECT_EQ(pool.newObject(10), nullptr);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kNoMemory);
+    EXPECT_EQ(pool.getCapacity(), 10u);
+
+    pool.deleteObject(vecObjects.back());
+    vecObjects.pop_back();
+    auto pObject = pool.newObject(11);
+    ASSERT_NE(pObject, nullptr);
+    EXPECT_EQ(*pObject, 11u);
+}
+
+// 测试构造函数抛出异常时槽位被归还
+TEST(LldkObjectPool, ConstructorThrows)
+{
+    LldkObjectPool<ThrowingObject> pool;
+    EXPECT_THROW(pool.newObject(), std::runtime_error);
+    EXPECT_EQ(pool.getUsedCount(), 0u);
+}
+
+// 测试使用指定的分配器获取内存块
+TEST(LldkObjectPool, CustomAllocator)
+{
+    auto pAllocator = lldkCreateAllocator("test.ObjectPool", 0);
+    ASSERT_NE(pAllocator, nullptr);
+    {
+        LldkObjectPool<PoolObject> pool(pAllocator, 16);
+        for (uint64_t i = 0; i < 40; i++)
+        {
+            ASSERT_NE(pool.newObject(i, "channel"), nullptr);
+        }
+
+        IAllocator::AllocateStats stats;
+        uint32_t uThreadCount = 1;
+        ASSERT_EQ(pAllocator->getAllocateStats(&stats, &uThreadCount), 0);
+        EXPECT_EQ(stats.uAllocatedCount, 3u);
+    }
+    lldkDestroyAllocator(pAllocator);
+}
@@ -0,0 +1,304 @@
+#include "gtest/gtest.h"
+#include "lldk/base/shm_allocator.h"
+#include "lldk/common/error_code.h"
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace lldk::base;
+
+// 测试辅助类：每个用例创建独立命名的 8MB 共享内存区域，结束时删除名字
+class ShmAllocatorTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        m_sName = std::string("lldk.test.") + std::to_string(getpid()) + "." +
+                  ::testing::UnitTest::GetInstance()->current_test_info()->name();
+        lldkUnlinkShmAllocator(m_sName.c_str());
+        m_pShmAllocator = lldkCreateShmAllocator(m_sName.c_str(), 8);
+        ASSERT_NE(m_pShmAllocator, nullptr);
+    }
+
+    void TearDown() override
+    {
+        if (m_pShmAllocator != nullptr)
+        {
+            lldkDestroyShmAllocator(m_pShmAllocator);
+        }
+        lldkUnlinkShmAllocator(m_sName.c_str());
+    }
+
+    std::string m_sName;
+    IShmAllocator *m_pShmAllocator{nullptr};
+};
+
+// 测试各种大小的分配互不重叠，释放后复用，统计保持平衡
+TEST_F(ShmAllocatorTest, AllocateAndFree)
+{
+    std::vector<void *> vecMemory;
+    std::set<uint64_t> setOffsets;
+    for (uint64_t uSize : {0ULL, 1ULL, 24ULL, 100ULL, 1000ULL, 5000ULL, 32768ULL, 40000ULL, 300000ULL})
+    {
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            void *pMemory = m_pShmAllocator->allocate(uSize);
+            ASSERT_NE(pMemory, nullptr) << "size " << uSize;
+            EXPECT_EQ((uintptr_t)pMemory % IAllocator::kDefaultAlignment, 0u);
+            EXPECT_GE(m_pShmAllocator->getUsableSize(pMemory), uSize);
+            memset(pMemory, 0x5A, uSize);
+            EXPECT_TRUE(setOffsets.insert(m_pShmAllocator->toOffset(pMemory)).second);
+            vecMemory.push_back(pMemory);
+        }
+    }
+
+    for (auto pMemory : vecMemory)
+    {
+        m_pShmAllocator->free(pMemory);
+    }
+
+    // 大块释放后页面归还，同样大小的分配复用同一块
+    void *pLarge = m_pShmAllocator->allocate(300000);
+    ASSERT_NE(pLarge, nullptr);
+    m_pShmAllocator->free(pLarge);
+    EXPECT_EQ(m_pShmAllocator->allocate(300000), pLarge);
+    m_pShmAllocator->free(pLarge);
+
+    IAllocator::AllocateStats stats;
+    uint32_t uCount = 1;
+    ASSERT_EQ(m_pShmAllocator->getAllocateStats(&stats, &uCount), 0);
+    ASSERT_EQ(uCount, 1u);
+    EXPECT_EQ(stats.uTid, (uint64_t)getpid());
+    EXPECT_EQ(stats.uAllocatedCount, stats.uFreedCount);
+    EXPECT_EQ(stats.uAllocatedSize, stats.uFreedSize);
+
+    int iValue = 0;
+    m_pShmAllocator->free(&iValue);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kInvalidParam);
+}
+
+// 测试区域耗尽时分配失败，释放后可以再次分配
+TEST_F(ShmAllocatorTest, Exhausted)
+{
+    std::vector<void *> vecMemory(256);
+    uint64_t uAllocated = m_pShmAllocator->allocateBatch(64 * 1024, vecMemory.size(), vecMemory.data());
+    EXPECT_GT(uAllocated, 64u);
+    EXPECT_LT(uAllocated, vecMemory.size());
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kNoMemory);
+
+    IAllocator::MemoryStats memoryStats;
+    ASSERT_EQ(m_pShmAllocator->getMemoryStats(&memoryStats), 0);
+    EXPECT_EQ(memoryStats.uReservedSize, 8u << 20);
+    EXPECT_EQ(memoryStats.uMappedSize, uAllocated * 64 * 1024);
+
+    // 释放相邻的页面后合并，可以分配更大的块
+    m_pShmAllocator->freeBatch(vecMemory.data(), uAllocated);
+    void *pMemory = m_pShmAllocator->allocate(uAllocated * 64 * 1024);
+    EXPECT_NE(pMemory, nullptr);
+    m_pShmAllocator->free(pMemory);
+}
+
+// 测试超大的尺寸被拒绝，页数取整不会回绕成零页
+TEST_F(ShmAllocatorTest, HugeSize)
+{
+    EXPECT_EQ(m_pShmAllocator->allocate(UINT64_MAX), nullptr);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kNoMemory);
+    EXPECT_EQ(m_pShmAllocator->allocate(UINT64_MAX - 100), nullptr);
+    EXPECT_EQ(m_pShmAllocator->allocateAligned(UINT64_MAX, 64), nullptr);
+
+    void *pMemory = nullptr;
+    EXPECT_EQ(m_pShmAllocator->allocateBatch(UINT64_MAX, 1, &pMemory), 0u);
+    EXPECT_NE(m_pShmAllocator->reserve(UINT64_MAX, 1), 0);
+
+    auto pBlock = m_pShmAllocator->allocate(100);
+    ASSERT_NE(pBlock, nullptr);
+    EXPECT_EQ(m_pShmAllocator->reAllocate(pBlock, UINT64_MAX), nullptr);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kNoMemory);
+    m_pShmAllocator->free(pBlock);
+
+    IAllocator::AllocateStats stats;
+    uint32_t uCount = 1;
+    ASSERT_EQ(m_pShmAllocator->getAllocateStats(&stats, &uCount), 0);
+    EXPECT_EQ(stats.uAllocatedCount, 1u);
+    EXPECT_EQ(stats.uAllocatedSize, stats.uFreedSize);
+}
+
+// 测试释放对象中间的指针被拒绝，之后分配的块不会与已有的块重叠
+TEST_F(ShmAllocatorTest, FreeInsideObject)
+{
+    for (uint64_t uSize : {64ULL, 20000ULL})
+    {
+        std::vector<char *> vecMemory;
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            auto pMemory = (char *)m_pShmAllocator->allocate(uSize);
+            ASSERT_NE(pMemory, nullptr);
+            memset(pMemory, i, uSize);
+            vecMemory.push_back(pMemory);
+        }
+
+        for (auto pMemory : vecMemory)
+        {
+            m_pShmAllocator->free(pMemory + 8);
+            EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kInvalidParam) << "size " << uSize;
+            EXPECT_EQ(m_pShmAllocator->getUsableSize(pMemory + 8), 0u);
+            EXPECT_EQ(m_pShmAllocator->reAllocate(pMemory + 8, uSize * 2), nullptr);
+        }
+
+        // 被拒绝的释放没有进入空闲链表，新的块都落在已有的块之外
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            auto pMemory = (char *)m_pShmAllocator->allocate(uSize);
+            ASSERT_NE(pMemory, nullptr);
+            for (auto pOld : vecMemory)
+            {
+                EXPECT_TRUE(pMemory + uSize <= pOld || pOld + uSize <= pMemory) << "size " << uSize;
+            }
+            memset(pMemory, 0xFF, uSize);
+            vecMemory.push_back(pMemory);
+        }
+
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            EXPECT_EQ(vecMemory[i][uSize - 1], (char)i);
+        }
+        for (auto pMemory : vecMemory)
+        {
+            m_pShmAllocator->free(pMemory);
+        }
+    }
+}
+
+// 测试按对齐分配与原地扩展
+TEST_F(ShmAllocatorTest, AlignedAndReAllocate)
+{
+    for (uint64_t uAlign = 1; uAlign <= IAllocator::kMaxAlignment; uAlign <<= 1)
+    {
+        void *pMemory = m_pShmAllocator->allocateAligned(100, uAlign);
+        ASSERT_NE(pMemory, nullptr);
+        EXPECT_EQ((uintptr_t)pMemory % uAlign, 0u) << "align " << uAlign;
+        m_pShmAllocator->free(pMemory);
+    }
+
+    auto pMemory = (char *)m_pShmAllocator->allocate(20);
+    ASSERT_NE(pMemory, nullptr);
+    strcpy(pMemory, "hello shm");
+    EXPECT_EQ(m_pShmAllocator->reAllocate(pMemory, 30), pMemory);
+    auto pNewMemory = (char *)m_pShmAllocator->reAllocate(pMemory, 100000);
+    ASSERT_NE(pNewMemory, nullptr);
+    EXPECT_STREQ(pNewMemory, "hello shm");
+    m_pShmAllocator->free(pNewMemory);
+}
+
+// 测试预热：reserve 不计入统计，之后的分配不再切分新的页
+TEST_F(ShmAllocatorTest, Reserve)
+{
+    ASSERT_EQ(m_pShmAllocator->reserve(100, 1000), 0);
+
+    IAllocator::MemoryStats before;
+    ASSERT_EQ(m_pShmAllocator->getMemoryStats(&before), 0);
+    std::vector<void *> vecMemory(1000);
+    ASSERT_EQ(m_pShmAllocator->allocateBatch(100, vecMemory.size(), vecMemory.data()), vecMemory.size());
+
+    IAllocator::MemoryStats after;
+    ASSERT_EQ(m_pShmAllocator->getMemoryStats(&after), 0);
+    EXPECT_EQ(after.uMappedSize, before.uMappedSize);
+    m_pShmAllocator->freeBatch(vecMemory.data(), vecMemory.size());
+
+    IAllocator::AllocateStats stats;
+    uint32_t uCount = 1;
+    ASSERT_EQ(m_pShmAllocator->getAllocateStats(&stats, &uCount), 0);
+    EXPECT_EQ(stats.uAllocatedCount, 1000u);
+
+    EXPECT_EQ(m_pShmAllocator->reserve(64 * 1024, 1000), -1);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kNoMemory);
+}
+
+// 测试同一进程再次附加：映射地址不同，偏移量相同
+TEST_F(ShmAllocatorTest, AttachInProcess)
+{
+    EXPECT_EQ(lldkCreateShmAllocator(m_sName.c_str(), 8), nullptr);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kInvalidParam);
+
+    auto pAttached = lldkAttachShmAllocator(m_sName.c_str());
+    ASSERT_NE(pAttached, nullptr);
+
+    auto pMessage = (char *)m_pShmAllocator->allocate(64);
+    ASSERT_NE(pMessage, nullptr);
+    strcpy(pMessage, "zero copy");
+    m_pShmAllocator->setRootOffset(m_pShmAllocator->toOffset(pMessage));
+
+    auto pRead = (char *)pAttached->fromOffset(pAttached->getRootOffset());
+    ASSERT_NE(pRead, nullptr);
+    EXPECT_NE(pRead, pMessage);
+    EXPECT_STREQ(pRead, "zero copy");
+
+    // 从另一个映射释放
+    pAttached->free(pRead);
+    EXPECT_EQ(m_pShmAllocator->allocate(64), pMessage);
+    m_pShmAllocator->free(pMessage);
+    lldkDestroyShmAllocator(pAttached);
+
+    EXPECT_EQ(lldkAttachShmAllocator("lldk.test.not.exist"), nullptr);
+    EXPECT_EQ(lldkGetErrorCode(), lldk::ErrorCode::kInvalidParam);
+    EXPECT_EQ(m_pShmAllocator->fromOffset(IShmAllocator::kNullOffset), nullptr);
+    EXPECT_EQ(m_pShmAllocator->toOffset(nullptr), IShmAllocator::kNullOffset);
+}
+
+// 测试跨进程：子进程分配并写入消息，父进程按偏移量原地读取并释放
+TEST_F(ShmAllocatorTest, CrossProcess)
+{
+    const uint32_t kMessageCount = 1000;
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0)
+    {
+        auto pShmAllocator = lldkAttachShmAllocator(m_sName.c_str());
+        if (pShmAllocator == nullptr)
+        {
+            _exit(1);
+        }
+
+        auto pOffsets = (uint64_t *)pShmAllocator->allocate(kMessageCount * sizeof(uint64_t));
+        for (uint32_t i = 0; i < kMessageCount; i++)
+        {
+            auto pMessage = (char *)pShmAllocator->allocate(32);
+            if (pOffsets == nullptr || pMessage == nullptr)
+            {
+                _exit(2);
+            }
+            snprintf(pMessage, 32, "message %u", i);
+            pOffsets[i] = pShmAllocator->toOffset(pMessage);
+        }
+        pShmAllocator->setRootOffset(pShmAllocator->toOffset(pOffsets));
+        lldkDestroyShmAllocator(pShmAllocator);
+        _exit(0);
+    }
+
+    int iStatus = 0;
+    ASSERT_EQ(waitpid(pid, &iStatus, 0), pid);
+    ASSERT_TRUE(WIFEXITED(iStatus));
+    ASSERT_EQ(WEXITSTATUS(iStatus), 0);
+
+    auto pOffsets = (uint64_t *)m_pShmAllocator->fromOffset(m_pShmAllocator->getRootOffset());
+    ASSERT_NE(pOffsets, nullptr);
+    for (uint32_t i = 0; i < kMessageCount; i++)
+    {
+        auto pMessage = (char *)m_pShmAllocator->fromOffset(pOffsets[i]);
+        ASSERT_NE(pMessage, nullptr);
+        EXPECT_EQ(std::string(pMessage), "message " + std::to_string(i));
+        m_pShmAllocator->free(pMessage);
+    }
+    m_pShmAllocator->free(pOffsets);
+
+    // 每个附加过的进程一条统计，合计保持平衡
+    IAllocator::AllocateStats arrStats[4];
+    uint32_t uCount = 4;
+    ASSERT_EQ(m_pShmAllocator->getAllocateStats(arrStats, &uCount), 0);
+    ASSERT_EQ(uCount, 2u);
+    EXPECT_EQ(arrStats[0].uAllocatedCount + arrStats[1].uAllocatedCount, arrStats[0].uFreedCount + arrStats[1].uFreedCount);
+    EXPECT_EQ(arrStats[0].uAllocatedSize + arrStats[1].uAllocatedSize, arrStats[0].uFreedSize + arrStats[1].uFreedSize);
+}
@@ -0,0 +1,116 @@
+#include "gtest/gtest.h"
+#include "lldk/base/stl_allocator.h"
+#include "lldk/base/arena_allocator.h"
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace lldk::base;
+
+struct alignas(LLDK_CACHELINE_SIZE) AlignedElement
+{
+    uint64_t uValue;
+};
+
+// 测试辅助类：每个用例使用独立的分配器，结束时检查分配与释放平衡
+class StlAllocatorTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        std::string sName = std::string("test.stl.") + ::testing::UnitTest::GetInstance()->current_test_info()->name();
+        m_pAllocator = lldkCreateAllocator(sName.c_str(), 0);
+        ASSERT_NE(m_pAllocator, nullptr);
+    }
+
+    void TearDown() override
+    {
+        IAllocator::AllocateStats stats;
+        uint32_t uThreadCount = 1;
+        ASSERT_EQ(m_pAllocator->getAllocateStats(&stats, &uThreadCount), 0);
+        EXPECT_EQ(stats.uAllocatedCount, stats.uFreedCount);
+        EXPECT_EQ(stats.uAllocatedSize, stats.uFreedSize);
+        lldkDestroyAllocator(m_pAllocator);
+    }
+
+    uint64_t getAllocatedCount()
+    {
+        IAllocator::AllocateStats stats;
+        uint32_t uThreadCount = 1;
+        m_pAllocator->getAllocateStats(&stats, &uThreadCount);
+        return stats.uAllocatedCount;
+    }
+
+    IAllocator *m_pAllocator{nullptr};
+};
+
+// 测试 vector 的扩容通过指定的分配器
+TEST_F(StlAllocatorTest, Vector)
+{
+    std::vector<uint64_t, LldkStlAllocator<uint64_t>> vecValues{LldkStlAllocator<uint64_t>(m_pAllocator)};
+    for (uint64_t i = 0; i < 10000; i++)
+    {
+        vecValues.push_back(i);
+    }
+    EXPECT_GT(getAllocatedCount(), 1u);
+    for (uint64_t i = 0; i < vecValues.size(); i++)
+    {
+        ASSERT_EQ(vecValues[i], i);
+    }
+}
+
+// 测试 list 与 map 的节点经过 rebind 后仍使用同一个分配器
+TEST_F(StlAllocatorTest, NodeContainers)
+{
+    std::list<std::string, LldkStlAllocator<std::string>> listValues{LldkStlAllocator<std::string>(m_pAllocator)};
+    using MapAlloc = LldkStlAllocator<std::pair<const uint64_t, uint64_t>>;
+    std::map<uint64_t, uint64_t, std::less<uint64_t>, MapAlloc> mapValues{std::less<uint64_t>(), MapAlloc(m_pAllocator)};
+    for (uint64_t i = 0; i < 1000; i++)
+    {
+        listValues.push_back(std::to_string(i));
+        mapValues[i] = i * 2;
+    }
+    EXPECT_GE(getAllocatedCount(), 2000u);
+    EXPECT_EQ(listValues.get_allocator().getAllocator(), m_pAllocator);
+    EXPECT_EQ(mapValues.at(500), 1000u);
+
+    // 拷贝与移动沿用同一个分配器
+    auto listCopy = listValues;
+    EXPECT_EQ(listCopy.get_allocator(), listValues.get_allocator());
+    auto mapMoved = std::move(mapValues);
+    EXPECT_EQ(mapMoved.size(), 1000u);
+}
+
+// 测试超过默认对齐的元素按其对齐分配
+TEST_F(StlAllocatorTest, OverAligned)
+{
+    std::vector<AlignedElement, LldkStlAllocator<AlignedElement>> vecValues{LldkStlAllocator<AlignedElement>(m_pAllocator)};
+    for (uint64_t i = 0; i < 100; i++)
+    {
+        vecValues.push_back(AlignedElement{i});
+        ASSERT_EQ((uintptr_t)vecValues.data() % LLDK_CACHELINE_SIZE, 0u);
+    }
+}
+
+// 测试转发到 arena 分配器，容器析构时不释放任何内存
+TEST(StlAllocator, ArenaAllocator)
+{
+    auto pArena = lldkCreateArenaAllocator("test.stl.arena", nullptr, 64 * 1024);
+    ASSERT_NE(pArena, nullptr);
+    {
+        std::map<int32_t, int32_t, std::less<int32_t>, LldkStlAllocator<std::pair<const int32_t, int32_t>>> mapValues{
+            std::less<int32_t>(), LldkStlAllocator<std::pair<const int32_t, int32_t>>(pArena)};
+        for (int32_t i = 0; i < 1000; i++)
+        {
+            mapValues[i] = i;
+        }
+        EXPECT_EQ(mapValues.size(), 1000u);
+    }
+    pArena->reset();
+    lldkDestroyArenaAllocator(pArena);
+
+    LldkStlAllocator<int32_t> defaultAllocator;
+    EXPECT_EQ(defaultAllocator.getAllocator(), lldkGetAllocatorSingleton());
+    EXPECT_THROW(defaultAllocator.allocate(defaultAllocator.max_size() + 1), std::bad_alloc);
+}
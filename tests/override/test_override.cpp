@@ -0,0 +1,243 @@
+#include "gtest/gtest.h"
+#include "lldk/base/allocator.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <malloc.h>
+#include <unistd.h>
+
+using namespace lldk::base;
+
+// 汇总全局分配器各线程的统计，查询本身分配的内存在返回前已经释放，比较在用的大小与个数
+static IAllocator::AllocateStats getTotalStats()
+{
+    static IAllocator::AllocateStats s_arrStats[1024];
+    IAllocator::AllocateStats total;
+    memset(&total, 0, sizeof(total));
+
+    uint32_t uCount = sizeof(s_arrStats) / sizeof(s_arrStats[0]);
+    EXPECT_EQ(lldkGetAllocatorSingleton()->getAllocateStats(s_arrStats, &uCount), 0);
+    for (uint32_t i = 0; i < uCount; i++)
+    {
+        total.uAllocatedSize += s_arrStats[i].uAllocatedSize;
+        total.uAllocatedCount += s_arrStats[i].uAllocatedCount;
+        total.uFreedSize += s_arrStats[i].uFreedSize;
+        total.uFreedCount += s_arrStats[i].uFreedCount;
+    }
+    return total;
+}
+
+static int64_t getInUseCount(const IAllocator::AllocateStats &stats)
+{
+    return (int64_t)(stats.uAllocatedCount - stats.uFreedCount);
+}
+
+static int64_t getInUseSize(const IAllocator::AllocateStats &stats)
+{
+    return (int64_t)(stats.uAllocatedSize - stats.uFreedSize);
+}
+
+// 测试 new/delete 经过全局分配器
+TEST(OverrideTest, NewDelete)
+{
+    auto before = getTotalStats();
+    auto pArray = new uint64_t[1000];
+    auto pValue = new uint64_t(42);
+    auto after = getTotalStats();
+    EXPECT_EQ(getInUseCount(after) - getInUseCount(before), 2);
+    EXPECT_GE(getInUseSize(after) - getInUseSize(before), (int64_t)(1001 * sizeof(uint64_t)));
+
+    pArray[999] = *pValue;
+    delete[] pArray;
+    delete pValue;
+    after = getTotalStats();
+    EXPECT_EQ(getInUseCount(after), getInUseCount(before));
+    EXPECT_EQ(getInUseSize(after), getInUseSize(before));
+
+    auto pNoThrow = new (std::nothrow) char[100];
+    ASSERT_NE(pNoThrow, nullptr);
+    delete[] pNoThrow;
+
+    // 超过地址空间的请求抛出 bad_alloc，nothrow 版本返回空
+    EXPECT_THROW(new char[(size_t)1 << 62], std::bad_alloc);
+    EXPECT_EQ(new (std::nothrow) char[(size_t)1 << 62], nullptr);
+}
+
+// 测试标准容器的分配与释放保持平衡
+TEST(OverrideTest, Containers)
+{
+    auto before = getTotalStats();
+    {
+        std::vector<std::string> vecStrings;
+        std::map<uint32_t, std::unique_ptr<std::string>> mapStrings;
+        for (uint32_t i = 0; i < 10000; i++)
+        {
+            vecStrings.push_back(std::string(i % 200 + 20, 'a'));
+            mapStrings[i].reset(new std::string(std::to_string(i) + std::string(64, 'b')));
+        }
+        EXPECT_EQ(*mapStrings[1234], "1234" + std::string(64, 'b'));
+    }
+    auto after = getTotalStats();
+    EXPECT_GT(after.uAllocatedCount - before.uAllocatedCount, 20000u);
+    EXPECT_EQ(getInUseCount(after), getInUseCount(before));
+    EXPECT_EQ(getInUseSize(after), getInUseSize(before));
+}
+
+// 测试一个线程分配、另一个线程释放
+TEST(OverrideTest, CrossThread)
+{
+    const uint32_t kCount = 100000;
+    std::vector<std::string *> vecStrings(kCount);
+    std::thread producer([&vecStrings]() {
+        for (uint32_t i = 0; i < kCount; i++)
+        {
+            vecStrings[i] = new std::string(std::to_string(i) + std::string(40, 'c'));
+        }
+    });
+    producer.join();
+
+    std::thread consumer([&vecStrings]() {
+        for (uint32_t i = 0; i < kCount; i++)
+        {
+            delete vecStrings[i];
+        }
+    });
+    consumer.join();
+}
+
+// 测试反复创建和回收线程，分配器为线程内部结构的嵌套分配在线程退出后被重新使用，不会耗尽
+TEST(OverrideTest, ThreadChurn)
+{
+    for (uint32_t i = 0; i < 20000; i++)
+    {
+        std::thread thread([i]() {
+            delete new std::string(std::to_string(i) + std::string(100, 't'));
+        });
+        thread.join();
+    }
+
+    // 之后的线程仍然有自己的线程缓存，分配计入统计
+    std::thread thread([]() {
+        auto before = getTotalStats();
+        auto pBuffer = new char[100];
+        auto after = getTotalStats();
+        EXPECT_EQ(getInUseCount(after) - getInUseCount(before), 1);
+        delete[] pBuffer;
+    });
+    thread.join();
+}
+
+// 测试对全局分配器每次分配都采样，记录栈时不再经过它分配，也不会递归或丢失样本
+TEST(OverrideTest, HeapProfile)
+{
+    const uint32_t kCount = 100000;
+    auto pAllocator = lldkGetAllocatorSingleton();
+    ASSERT_EQ(pAllocator->setSampleInterval(1), 0);
+    std::thread thread([]() {
+        for (uint32_t i = 0; i < kCount; i++)
+        {
+            delete new std::string(std::to_string(i) + std::string(100, 'p'));
+        }
+    });
+    thread.join();
+    ASSERT_EQ(pAllocator->setSampleInterval(0), 0);
+
+    std::string sFileName = "/tmp/lldk_test_override_profile." + std::to_string(getpid());
+    ASSERT_EQ(pAllocator->dumpHeapProfile(sFileName.c_str(), IAllocator::kProfilePprof), 0);
+    std::unique_ptr<FILE, int (*)(FILE *)> pFile(fopen(sFileName.c_str(), "r"), fclose);
+    ASSERT_NE(pFile, nullptr);
+    unsigned long long uCount = 0;
+    ASSERT_EQ(fscanf(pFile.get(), "heap profile: %*d: %*d [ %llu:", &uCount), 1);
+    EXPECT_GE(uCount, kCount);
+    unlink(sFileName.c_str());
+}
+
+// 测试采样仍然打开时导出，导出过程中的分配被采样也不会死锁
+TEST(OverrideTest, HeapProfileWhileSampling)
+{
+    auto pAllocator = lldkGetAllocatorSingleton();
+    ASSERT_EQ(pAllocator->setSampleInterval(64), 0);
+    std::vector<std::string *> vecStrings;
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        vecStrings.push_back(new std::string(std::to_string(i) + std::string(100, 's')));
+    }
+
+    std::string sFileName = "/tmp/lldk_test_override_profile_sampling." + std::to_string(getpid());
+    EXPECT_EQ(pAllocator->dumpHeapProfile(sFileName.c_str(), IAllocator::kProfileCollapsed), 0);
+    EXPECT_EQ(pAllocator->dumpHeapProfile(sFileName.c_str(), IAllocator::kProfilePprof), 0);
+    ASSERT_EQ(pAllocator->setSampleInterval(0), 0);
+    for (auto pString : vecStrings)
+    {
+        delete pString;
+    }
+    unlink(sFileName.c_str());
+}
+
+#ifdef __cpp_aligned_new
+// 测试超过默认对齐的类型按 alignof 分配
+TEST(OverrideTest, AlignedNew)
+{
+    struct alignas(256) AlignedBlock
+    {
+        uint8_t arrData[300];
+    };
+
+    std::vector<AlignedBlock *> vecBlocks;
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        auto pBlock = new AlignedBlock();
+        EXPECT_EQ((uintptr_t)pBlock % alignof(AlignedBlock), 0u);
+        vecBlocks.push_back(pBlock);
+    }
+    for (auto pBlock : vecBlocks)
+    {
+        delete pBlock;
+    }
+}
+#endif // __cpp_aligned_new
+
+#ifdef LLDK_OVERRIDE_MALLOC
+// 测试 malloc 系列函数经过全局分配器
+TEST(OverrideTest, Malloc)
+{
+    auto before = getTotalStats();
+    auto pMemory = (char *)malloc(100);
+    ASSERT_NE(pMemory, nullptr);
+    EXPECT_GE(malloc_usable_size(pMemory), 100u);
+    strcpy(pMemory, "lldk malloc");
+    auto after = getTotalStats();
+    EXPECT_EQ(getInUseCount(after) - getInUseCount(before), 1);
+
+    pMemory = (char *)realloc(pMemory, 100000);
+    ASSERT_NE(pMemory, nullptr);
+    EXPECT_STREQ(pMemory, "lldk malloc");
+    EXPECT_GE(malloc_usable_size(pMemory), 100000u);
+    free(pMemory);
+
+    auto pZero = (uint64_t *)calloc(1000, sizeof(uint64_t));
+    ASSERT_NE(pZero, nullptr);
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        EXPECT_EQ(pZero[i], 0u);
+    }
+    free(pZero);
+
+    void *pAligned = nullptr;
+    ASSERT_EQ(posix_memalign(&pAligned, 4096, 5000), 0);
+    EXPECT_EQ((uintptr_t)pAligned % 4096, 0u);
+    free(pAligned);
+    EXPECT_EQ(posix_memalign(&pAligned, 3, 5000), EINVAL);
+
+    volatile size_t uHugeCount = (size_t)1 << 40;
+    EXPECT_EQ(calloc(uHugeCount, uHugeCount), nullptr);
+    EXPECT_EQ(errno, ENOMEM);
+    EXPECT_EQ(realloc(malloc(10), 0), nullptr);
+    free(nullptr);
+}
+#endif // LLDK_OVERRIDE_MALLOC
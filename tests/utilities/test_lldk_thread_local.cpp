@@ -1,12 +1,14 @@
 #include "gtest/gtest.h"
 #include "lldk_thread_local.h"
 #include <thread>
+#include <chrono>
 #include <vector>
 #include <atomic>
 #include <memory>
 #include <string>
 #include <cstring>
 #include <algorithm>
+#include <functional>
 
 using namespace lldk::utilities;
 
@@ -106,6 +108,29 @@ struct DestroyStringFunc
     }
 };
 
+// 线程闩，计数减到 0 之前 wait 一直等待，用于让线程在检查完成前保持存活
+class ThreadLatch
+{
+public:
+    explicit ThreadLatch(int count) : m_count(count) {}
+
+    void arrive()
+    {
+        m_count--;
+    }
+
+    void wait() const
+    {
+        while (m_count.load() > 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    std::atomic<int> m_count;
+};
+
 // ============================================================================
 // 1. 基本功能测试
 // ============================================================================
@@ -143,16 +168,21 @@ TEST(LldkThreadLocal, DifferentThreadsDifferentObjects)
     std::vector<TestObject*> objects;
     std::vector<std::thread> threads;
     std::mutex mutex;
+    ThreadLatch latch(5); // 线程退出会释放对象，全部获取后再退出
     
     // 创建多个线程，每个线程获取对象
     for (int i = 0; i < 5; i++)
     {
-        threads.emplace_back([&threadLocal, &objects, &mutex]() {
+        threads.emplace_back([&threadLocal, &objects, &mutex, &latch]() {
             TestObject* obj = threadLocal.get();
-            ASSERT_NE(obj, nullptr);
+            EXPECT_NE(obj, nullptr);
             
-            std::lock_guard<std::mutex> lock(mutex);
-            objects.push_back(obj);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                objects.push_back(obj);
+            }
+            latch.arrive();
+            latch.wait();
         });
     }
     
@@ -218,20 +248,25 @@ TEST(LldkThreadLocal, MultipleInstancesMultiThread)
     std::vector<std::pair<TestObject*, TestObject*>> results;
     std::vector<std::thread> threads;
     std::mutex mutex;
+    ThreadLatch latch(3); // 线程退出会释放对象，全部获取后再退出
     
     // 创建多个线程，每个线程获取两个实例的对象
     for (int i = 0; i < 3; i++)
     {
-        threads.emplace_back([&threadLocal1, &threadLocal2, &results, &mutex]() {
+        threads.emplace_back([&threadLocal1, &threadLocal2, &results, &mutex, &latch]() {
             TestObject* obj1 = threadLocal1.get();
             TestObject* obj2 = threadLocal2.get();
             
-            ASSERT_NE(obj1, nullptr);
-            ASSERT_NE(obj2, nullptr);
+            EXPECT_NE(obj1, nullptr);
+            EXPECT_NE(obj2, nullptr);
             EXPECT_NE(obj1, obj2);
             
-            std::lock_guard<std::mutex> lock(mutex);
-            results.push_back({obj1, obj2});
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                results.push_back({obj1, obj2});
+            }
+            latch.arrive();
+            latch.wait();
         });
     }
     
@@ -258,6 +293,46 @@ TEST(LldkThreadLocal, MultipleInstancesMultiThread)
     EXPECT_EQ(TestObject::getConstructorCount(), 6);
 }
 
+// 测试带状态的创建函数对象，每个线程第一次访问时用该实例的函数对象创建
+TEST(LldkThreadLocal, FactoryWithState)
+{
+    TestObject::resetCounters();
+
+    {
+        using ThreadLocal = LldkThreadLocal<TestObject, CreateTestObjectWithValueFunc, DestroyTestObjectFunc>;
+
+        ThreadLocal threadLocal1(CreateTestObjectWithValueFunc(7));
+        ThreadLocal threadLocal2(CreateTestObjectWithValueFunc(9));
+        EXPECT_EQ(TestObject::getConstructorCount(), 0); // 构造时不创建对象
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; i++)
+        {
+            threads.emplace_back([&threadLocal1, &threadLocal2]() {
+                EXPECT_EQ(threadLocal1.peek(), nullptr);
+                TestObject* obj1 = threadLocal1.get();
+                TestObject* obj2 = threadLocal2.get();
+                ASSERT_NE(obj1, nullptr);
+                ASSERT_NE(obj2, nullptr);
+                EXPECT_EQ(obj1->getValue(), 7);
+                EXPECT_EQ(obj2->getValue(), 9);
+                EXPECT_EQ(threadLocal1.peek(), obj1);
+            });
+        }
+
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+
+        // 线程退出时通过销毁函数对象释放该线程的对象
+        EXPECT_EQ(TestObject::getConstructorCount(), 8);
+        EXPECT_EQ(TestObject::getDestructorCount(), 8);
+    }
+
+    EXPECT_EQ(TestObject::getDestructorCount(), 8);
+}
+
 // ============================================================================
 // 3. 生命周期测试
 // ============================================================================
@@ -312,14 +387,16 @@ TEST(LldkThreadLocal, LifecycleMultiThread)
             t.join();
         }
         
+        // 线程退出时，该线程的对象被销毁
         EXPECT_EQ(TestObject::getConstructorCount(), 5);
-        EXPECT_EQ(TestObject::getDestructorCount(), 0);
+        EXPECT_EQ(TestObject::getDestructorCount(), 5);
         
-        // threadLocal 销毁时，所有线程的对象都应该被销毁
+        // 主线程的对象在 threadLocal 销毁时被销毁
+        ASSERT_NE(threadLocal.get(), nullptr);
     }
     
     // 验证所有对象已被销毁
-    EXPECT_EQ(TestObject::getDestructorCount(), 5);
+    EXPECT_EQ(TestObject::getDestructorCount(), 6);
 }
 
 // 测试线程局部变量的生命周期与线程一致
@@ -350,9 +427,9 @@ TEST(LldkThreadLocal, ThreadLocalLifecycle)
         EXPECT_EQ(TestObject::getConstructorCount(), 2);
     }
     
-    // 子线程结束后，子线程的对象应该被销毁（通过LldkThreadLocal的析构函数）
-    // 但主线程的对象仍然存在
-    EXPECT_EQ(TestObject::getDestructorCount(), 0); // 对象在threadLocal销毁时才会被销毁
+    // 子线程结束后，子线程的对象应该被销毁（线程退出时通过销毁函数对象）
+    // 但主线程的对象仍然存在，在threadLocal销毁时才会被销毁
+    EXPECT_EQ(TestObject::getDestructorCount(), 1);
 }
 
 // ============================================================================
@@ -371,22 +448,21 @@ TEST(LldkThreadLocal, Foreach)
     std::vector<std::thread> threads;
     std::vector<TestObject*> collectedObjects;
     std::mutex mutex;
+    ThreadLatch ready(5);
+    ThreadLatch done(1);
     
-    // 创建多个线程，每个线程获取对象并设置不同的值
+    // 创建多个线程，每个线程获取对象并设置不同的值，foreach 完成后再退出
     for (int i = 0; i < 5; i++)
     {
-        threads.emplace_back([&threadLocal, i]() {
+        threads.emplace_back([&threadLocal, &ready, &done, i]() {
             TestObject* obj = threadLocal.get();
-            ASSERT_NE(obj, nullptr);
+            EXPECT_NE(obj, nullptr);
             obj->setValue(i * 10);
+            ready.arrive();
+            done.wait();
         });
     }
-    
-    // 等待所有线程完成
-    for (auto& t : threads)
-    {
-        t.join();
-    }
+    ready.wait();
     
     // 使用 foreach 收集所有对象
     int result = threadLocal.foreach(std::function<int32_t(TestObject*)>([&collectedObjects, &mutex](TestObject* obj) {
@@ -404,6 +480,20 @@ TEST(LldkThreadLocal, Foreach)
     {
         values.push_back(obj->getValue());
     }
+    
+    done.arrive();
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    
+    // 线程退出后 foreach 不再访问它们的对象
+    int count = 0;
+    EXPECT_EQ(threadLocal.foreach([&count](TestObject*) {
+        count++;
+        return 0;
+    }), 0);
+    EXPECT_EQ(count, 0);
     std::sort(values.begin(), values.end());
     std::vector<int> expected = {0, 10, 20, 30, 40};
     EXPECT_EQ(values, expected);
@@ -456,7 +546,7 @@ struct CreateNullFunc
 
 TEST(LldkThreadLocal, CreateFuncReturnsNullptr)
 {
-    using ThreadLocal = LldkThreadLocal<TestObject>;
+    using ThreadLocal = LldkThreadLocal<TestObject, CreateNullFunc, DestroyTestObjectFunc>;
     
     ThreadLocal threadLocal;
     
@@ -475,23 +565,40 @@ TEST(LldkThreadLocal, InstanceIdExhausted)
 {
     using ThreadLocal = LldkThreadLocal<TestObject>;
     
+    const size_t uMaxInstanceId = LldkThreadLocalBase::kMaxInstanceId;
     std::vector<std::unique_ptr<ThreadLocal>> instances;
+    instances.reserve(uMaxInstanceId);
     
-    // 创建第一个实例，应该成功
-    instances.emplace_back(new ThreadLocal());
-    EXPECT_NE(instances.back(), nullptr);
-    
-    // 创建第二个实例，应该成功
-    instances.emplace_back(new ThreadLocal());
-    EXPECT_NE(instances.back(), nullptr);
+    // 用完全部 kMaxInstanceId 个 id，进程里其它模块可能已经占用了少量 id
+    bool bExhausted = false;
+    for (size_t i = 0; i <= uMaxInstanceId; i++)
+    {
+        try
+        {
+            instances.emplace_back(new ThreadLocal());
+        }
+        catch (const std::runtime_error &)
+        {
+            bExhausted = true;
+            break;
+        }
+    }
+    ASSERT_TRUE(bExhausted);
+    EXPECT_LE(instances.size(), uMaxInstanceId);
+    EXPECT_GE(instances.size(), uMaxInstanceId - 16);
     
-    // 尝试创建第三个实例，应该抛出异常
+    // 第 kMaxInstanceId + 1 个 id 应该抛出异常
     EXPECT_THROW(
         {
             instances.emplace_back(new ThreadLocal());
         },
         std::runtime_error
     );
+    
+    // 释放一个实例后 id 可以被重新使用
+    instances.pop_back();
+    EXPECT_NO_THROW(instances.emplace_back(new ThreadLocal()));
+    instances.clear();
 }
 
 // 测试销毁后重新创建
@@ -524,6 +631,76 @@ TEST(LldkThreadLocal, DestroyAndRecreate)
     EXPECT_EQ(TestObject::getDestructorCount(), 2);
 }
 
+// 测试超过一个块的实例数，每个线程只访问部分实例
+TEST(LldkThreadLocal, ManyInstances)
+{
+    using ThreadLocal = LldkThreadLocal<int64_t>;
+    const int kInstanceCount = 5000;
+    const int kThreadCount = 4;
+
+    std::vector<std::unique_ptr<ThreadLocal>> instances;
+    for (int i = 0; i < kInstanceCount; i++)
+    {
+        instances.emplace_back(new ThreadLocal());
+    }
+
+    // 线程 t 只访问下标与 t 同余的实例，值保持到所有线程检查完
+    ThreadLatch done(kThreadCount);
+    ThreadLatch checked(1);
+    std::atomic<int> errorCount{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreadCount; t++)
+    {
+        threads.emplace_back([&, t]() {
+            for (int i = t; i < kInstanceCount; i += kThreadCount)
+            {
+                int64_t* pValue = instances[i]->get();
+                if (pValue == nullptr)
+                {
+                    errorCount++;
+                    continue;
+                }
+                *pValue = i;
+            }
+            for (int i = 0; i < kInstanceCount; i++)
+            {
+                int64_t* pValue = instances[i]->peek();
+                if ((i % kThreadCount == t) ? (pValue == nullptr || *pValue != i) : (pValue != nullptr))
+                {
+                    errorCount++;
+                }
+            }
+            done.arrive();
+            checked.wait();
+        });
+    }
+
+    done.wait();
+    EXPECT_EQ(errorCount.load(), 0);
+
+    // 每个实例只有一个线程的存储
+    for (int i = 0; i < kInstanceCount; i += 97)
+    {
+        int count = 0;
+        int64_t sum = 0;
+        EXPECT_EQ(instances[i]->foreach([&](int64_t* pValue) {
+            count++;
+            sum += *pValue;
+            return 0;
+        }), 0);
+        EXPECT_EQ(count, 1);
+        EXPECT_EQ(sum, i);
+    }
+
+    // 线程存活时销毁一半实例，其余的在线程退出时释放
+    instances.resize(kInstanceCount / 2);
+    checked.arrive();
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
 // ============================================================================
 // 7. 复杂类型测试
 // ============================================================================
@@ -531,7 +708,7 @@ TEST(LldkThreadLocal, DestroyAndRecreate)
 // 测试字符串类型
 TEST(LldkThreadLocal, StringType)
 {
-    using StringThreadLocal = LldkThreadLocal<std::string>;
+    using StringThreadLocal = LldkThreadLocal<std::string, CreateStringFunc, DestroyStringFunc>;
     
     StringThreadLocal threadLocal;
     
@@ -582,7 +759,7 @@ struct DestroyCustomDataFunc
 
 TEST(LldkThreadLocal, CustomType)
 {
-    using CustomThreadLocal = LldkThreadLocal<CustomData>;
+    using CustomThreadLocal = LldkThreadLocal<CustomData, CreateCustomDataFunc, DestroyCustomDataFunc>;
     
     CustomThreadLocal threadLocal;
     
@@ -660,33 +837,33 @@ TEST(LldkThreadLocal, ComprehensiveScenario)
     
     std::vector<std::thread> threads;
     std::atomic<int> threadCount{0};
+    ThreadLatch done(1);
     
-    // 创建多个线程
+    // 创建多个线程，foreach 完成后再退出
     for (int i = 0; i < 5; i++)
     {
-        threads.emplace_back([&threadLocal1, &threadLocal2, &threadCount, i]() {
+        threads.emplace_back([&threadLocal1, &threadLocal2, &threadCount, &done, i]() {
             TestObject* obj1 = threadLocal1.get();
             TestObject* obj2 = threadLocal2.get();
             
-            ASSERT_NE(obj1, nullptr);
-            ASSERT_NE(obj2, nullptr);
+            EXPECT_NE(obj1, nullptr);
+            EXPECT_NE(obj2, nullptr);
             EXPECT_NE(obj1, obj2);
             
             obj1->setValue(i * 10);
             obj2->setValue(i * 20);
             
             threadCount++;
+            done.wait();
         });
     }
     
-    // 等待所有线程完成
-    for (auto& t : threads)
+    // 等待所有线程获取对象
+    while (threadCount.load() < 5)
     {
-        t.join();
+        std::this_thread::yield();
     }
     
-    EXPECT_EQ(threadCount.load(), 5);
-    
     // 使用 foreach 验证所有对象
     std::atomic<int> count1{0};
     std::atomic<int> count2{0};
@@ -705,6 +882,13 @@ TEST(LldkThreadLocal, ComprehensiveScenario)
     
     EXPECT_EQ(count1.load(), 5);
     EXPECT_EQ(count2.load(), 5);
+    
+    done.arrive();
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    EXPECT_EQ(TestObject::getDestructorCount(), 10);
 }
 
 // ============================================================================
@@ -804,25 +988,25 @@ TEST(LldkThreadLocal, ForeachPartial)
     
     ThreadLocal threadLocal;
     
-    // 只在部分线程中获取对象
+    // 只在部分线程中获取对象，foreach 完成后线程再退出
     std::vector<std::thread> threads;
+    ThreadLatch ready(5);
+    ThreadLatch done(1);
     
     for (int i = 0; i < 5; i++)
     {
-        threads.emplace_back([&threadLocal, i]() {
+        threads.emplace_back([&threadLocal, &ready, &done, i]() {
             if (i % 2 == 0) // 只在偶数索引的线程中获取对象
             {
                 TestObject* obj = threadLocal.get();
-                ASSERT_NE(obj, nullptr);
+                EXPECT_NE(obj, nullptr);
                 obj->setValue(i);
             }
+            ready.arrive();
+            done.wait();
         });
     }
-    
-    for (auto& t : threads)
-    {
-        t.join();
-    }
+    ready.wait();
     
     // 使用 foreach 收集对象
     std::vector<int> values;
@@ -833,9 +1017,310 @@ TEST(LldkThreadLocal, ForeachPartial)
         return 0;
     }));
     
+    done.arrive();
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    
     // 应该收集到3个对象（索引0, 2, 4）
     EXPECT_EQ(values.size(), 3);
     std::sort(values.begin(), values.end());
     std::vector<int> expected = {0, 2, 4};
     EXPECT_EQ(values, expected);
 }
+
+// 测试 foreach 与线程启动、退出并发进行，foreach 接受普通 lambda，遍历中途停止返回 -1
+TEST(LldkThreadLocal, ForeachWhileThreadsStartAndExit)
+{
+    TestObject::resetCounters();
+
+    using ThreadLocal = LldkThreadLocal<TestObject>;
+
+    ThreadLocal threadLocal;
+
+    std::atomic<bool> stop{false};
+    std::thread reader([&threadLocal, &stop]() {
+        while (!stop.load())
+        {
+            int count = 0;
+            EXPECT_EQ(threadLocal.foreach([&count](TestObject* obj) {
+                // 退出中的线程等遍历结束才销毁对象
+                EXPECT_GE(obj->getValue(), 0);
+                count++;
+                return 0;
+            }), 0);
+            EXPECT_LE(count, 10);
+        }
+    });
+
+    for (int round = 0; round < 20; round++)
+    {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 10; i++)
+        {
+            threads.emplace_back([&threadLocal, i]() {
+                TestObject* obj = threadLocal.get();
+                ASSERT_NE(obj, nullptr);
+                obj->setValue(i);
+            });
+        }
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+    }
+    stop = true;
+    reader.join();
+    EXPECT_EQ(TestObject::getDestructorCount(), 200);
+
+    ThreadLatch ready(8);
+    ThreadLatch done(1);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; i++)
+    {
+        threads.emplace_back([&threadLocal, &ready, &done]() {
+            EXPECT_NE(threadLocal.get(), nullptr);
+            ready.arrive();
+            done.wait();
+        });
+    }
+    ready.wait();
+
+    int count = 0;
+    EXPECT_EQ(threadLocal.foreach([&count](TestObject* obj) {
+        (void)obj;
+        return ++count == 5 ? 1 : 0;
+    }), -1);
+    EXPECT_EQ(count, 5);
+
+    done.arrive();
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+}
+
+// 测试 foreach 回调中创建和销毁实例时，退出中的线程不会与遍历互相等待
+TEST(LldkThreadLocal, ForeachCreateInstanceWhileThreadExits)
+{
+    TestObject::resetCounters();
+
+    using ThreadLocal = LldkThreadLocal<TestObject>;
+
+    ThreadLocal threadLocal;
+    ThreadLatch ready(1);
+    ThreadLatch exit(1);
+    std::thread thread([&threadLocal, &ready, &exit]() {
+        EXPECT_NE(threadLocal.get(), nullptr);
+        ready.arrive();
+        exit.wait();
+    });
+    ready.wait();
+
+    int count = 0;
+    EXPECT_EQ(threadLocal.foreach([&count, &exit](TestObject* obj) {
+        (void)obj;
+        count++;
+        // 让线程退出并等它进入对遍历的等待，再在回调中创建实例
+        exit.arrive();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        ThreadLocal other;
+        EXPECT_NE(other.get(), nullptr);
+        return 0;
+    }), 0);
+    EXPECT_EQ(count, 1);
+
+    thread.join();
+    EXPECT_EQ(TestObject::getDestructorCount(), 2);
+}
+
+// 线程退出时销毁对象的同时创建并使用另一个实例
+struct DestroyWithNestedInstanceFunc
+{
+    std::atomic<int>* created;
+
+    explicit DestroyWithNestedInstanceFunc(std::atomic<int>* c = nullptr) : created(c) {}
+
+    void operator()(TestObject* obj) const
+    {
+        LldkThreadLocal<TestObject> nested;
+        if (nested.peek() == nullptr && created != nullptr)
+        {
+            (*created)++;
+        }
+        LldkThreadLocalDestroyFunc<TestObject>()(obj);
+    }
+};
+
+// 测试释放函数中创建和销毁实例不会与实例锁死锁
+TEST(LldkThreadLocal, ReleaseCreatesInstance)
+{
+    TestObject::resetCounters();
+
+    using ThreadLocal = LldkThreadLocal<TestObject, LldkThreadLocalCreateFunc<TestObject>, DestroyWithNestedInstanceFunc>;
+
+    std::atomic<int> created{0};
+    {
+        ThreadLocal threadLocal{LldkThreadLocalCreateFunc<TestObject>(), DestroyWithNestedInstanceFunc(&created)};
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; i++)
+        {
+            threads.emplace_back([&threadLocal]() {
+                EXPECT_NE(threadLocal.get(), nullptr);
+            });
+        }
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+        EXPECT_EQ(created.load(), 4);
+
+        // 主线程的对象在实例销毁时释放
+        EXPECT_NE(threadLocal.get(), nullptr);
+    }
+    EXPECT_EQ(created.load(), 5);
+    EXPECT_EQ(TestObject::getDestructorCount(), 5);
+}
+
+// 用于测试的计数器，线程退出时合并到汇总中
+struct CounterSum
+{
+    std::atomic<int64_t> total{0};
+    std::atomic<int> retired{0};
+};
+
+struct RetireCounterFunc
+{
+    CounterSum* sum;
+
+    explicit RetireCounterFunc(CounterSum* s = nullptr) : sum(s) {}
+
+    void operator()(int64_t* value) const
+    {
+        sum->total += *value;
+        sum->retired++;
+    }
+};
+
+// 测试线程退出时先合并再销毁，合并后的汇总加上存活线程的值保持总数正确
+TEST(LldkThreadLocal, RetireOnThreadExit)
+{
+    CounterSum sum;
+    using ThreadLocal = LldkThreadLocal<int64_t, LldkThreadLocalCreateFunc<int64_t>, LldkThreadLocalDestroyFunc<int64_t>, RetireCounterFunc>;
+
+    {
+        ThreadLocal threadLocal{LldkThreadLocalCreateFunc<int64_t>(), LldkThreadLocalDestroyFunc<int64_t>(), RetireCounterFunc(&sum)};
+        *threadLocal.get() = 1000;
+
+        std::vector<std::thread> threads;
+        for (int i = 1; i <= 10; i++)
+        {
+            threads.emplace_back([&threadLocal, i]() {
+                for (int j = 0; j < i; j++)
+                {
+                    (*threadLocal.get())++;
+                }
+            });
+        }
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+
+        EXPECT_EQ(sum.retired.load(), 10);
+        EXPECT_EQ(sum.total.load(), 55);
+
+        int64_t live = 0;
+        threadLocal.foreach([&live](int64_t* value) {
+            live += *value;
+            return 0;
+        });
+        EXPECT_EQ(live, 1000);
+    }
+
+    // 实例销毁时存活线程的值只销毁，不合并
+    EXPECT_EQ(sum.retired.load(), 10);
+}
+
+// 测试 combine 归约存活线程的值，初值带上已退出线程的汇总
+TEST(LldkThreadLocal, Combine)
+{
+    CounterSum sum;
+    using ThreadLocal = LldkThreadLocal<int64_t, LldkThreadLocalCreateFunc<int64_t>, LldkThreadLocalDestroyFunc<int64_t>, RetireCounterFunc>;
+    ThreadLocal threadLocal{LldkThreadLocalCreateFunc<int64_t>(), LldkThreadLocalDestroyFunc<int64_t>(), RetireCounterFunc(&sum)};
+
+    // 没有线程创建存储时返回初值
+    EXPECT_EQ(threadLocal.combine(std::plus<int64_t>()), 0);
+    EXPECT_EQ(threadLocal.combine(std::plus<int64_t>(), 7), 7);
+
+    // 5 个线程存活，5 个线程退出
+    ThreadLatch ready(5);
+    ThreadLatch done(1);
+    std::vector<std::thread> threads;
+    for (int i = 1; i <= 10; i++)
+    {
+        threads.emplace_back([&threadLocal, &ready, &done, i]() {
+            for (int j = 0; j < i; j++)
+            {
+                (*threadLocal.get())++;
+            }
+            if (i % 2 == 0)
+            {
+                ready.arrive();
+                done.wait();
+            }
+        });
+    }
+    ready.wait();
+    while (sum.retired.load() != 5)
+    {
+        std::this_thread::yield();
+    }
+
+    // 存活线程的值为 2 + 4 + 6 + 8 + 10，已退出线程的值为 1 + 3 + 5 + 7 + 9
+    EXPECT_EQ(threadLocal.combine(std::plus<int64_t>()), 30);
+    EXPECT_EQ(threadLocal.combine(std::plus<int64_t>(), sum.total.load()), 55);
+    EXPECT_EQ(threadLocal.combine([](int64_t a, int64_t b) { return std::max(a, b); }), 10);
+
+    int count = 0;
+    EXPECT_EQ(threadLocal.combineEach([&count](const int64_t& value) {
+        EXPECT_EQ(value % 2, 0);
+        count++;
+    }), 0);
+    EXPECT_EQ(count, 5);
+
+    std::function<void(const int64_t&)> emptyFunc;
+    EXPECT_EQ(threadLocal.combineEach(emptyFunc), -1);
+
+    done.arrive();
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+}
+
+// 测试默认工厂创建的存储按缓存行对齐，不同实例的存储不共享缓存行
+TEST(LldkThreadLocal, StoragePaddedToCacheline)
+{
+    struct alignas(128) WideObject
+    {
+        int64_t values[3];
+    };
+
+    LldkThreadLocal<int64_t> first;
+    LldkThreadLocal<int64_t> second;
+    LldkThreadLocal<WideObject> wide;
+
+    auto pFirst = first.get();
+    auto pSecond = second.get();
+    auto pWide = wide.get();
+    ASSERT_NE(pFirst, nullptr);
+    ASSERT_NE(pSecond, nullptr);
+    ASSERT_NE(pWide, nullptr);
+
+    EXPECT_EQ((uintptr_t)pFirst % LLDK_CACHELINE_SIZE, 0u);
+    EXPECT_EQ((uintptr_t)pSecond % LLDK_CACHELINE_SIZE, 0u);
+    EXPECT_NE((uintptr_t)pFirst / LLDK_CACHELINE_SIZE, (uintptr_t)pSecond / LLDK_CACHELINE_SIZE);
+    EXPECT_EQ((uintptr_t)pWide % alignof(WideObject), 0u);
+}
@@ -1,5 +1,6 @@
 #include "gtest/gtest.h"
 #include "lldk_unordered_map.h"
+#include "lldk/base/stl_allocator.h"
 #include <string>
 #include <cstring>
 #include <vector>
@@ -407,6 +408,32 @@ TEST(LldkUnorderedMap, StringKey)
     EXPECT_EQ(map.size(), 3);
 }
 
+// 测试删除缓存中的长字符串键时不读取已释放的节点，在 ASan 下会报告释放后使用
+TEST(LldkUnorderedMap, EraseCachedStringKey)
+{
+    LldkUnorderedMap<std::string, int, std::hash<std::string>, 4> map;
+
+    std::vector<std::string> keys;
+    for (int i = 0; i < 100; i++)
+    {
+        keys.push_back(std::string(64, 'a' + i % 26) + std::to_string(i));
+        EXPECT_TRUE(map.insert(keys.back(), i));
+    }
+
+    for (int i = 0; i < 100; i++)
+    {
+        ASSERT_NE(map.find(keys[i]), nullptr);
+        map.erase(keys[i]);
+        EXPECT_FALSE(map.contains(keys[i]));
+        if (i + 1 < 100)
+        {
+            ASSERT_NE(map.find(keys[i + 1]), nullptr);
+            EXPECT_EQ(*map.find(keys[i + 1]), i + 1);
+        }
+    }
+    EXPECT_TRUE(map.empty());
+}
+
 // 测试字符串值类型
 TEST(LldkUnorderedMap, StringValue)
 {
@@ -1094,3 +1121,61 @@ TEST(LldkUnorderedMap, CacheUpdateAfterMiss)
     EXPECT_TRUE(map.contains(1));
     EXPECT_TRUE(map.contains(2));
 }
+
+// 测试使用 LldkStlAllocator 时节点从指定的分配器分配
+TEST(LldkUnorderedMap, StlAllocator)
+{
+    using Alloc = lldk::base::LldkStlAllocator<std::pair<const std::string, int>>;
+    auto pAllocator = lldkCreateAllocator("test.UnorderedMapStlAllocator", 0);
+    ASSERT_NE(pAllocator, nullptr);
+    {
+        LldkUnorderedMap<std::string, int, std::hash<std::string>, 64, Alloc> map{Alloc(pAllocator)};
+        for (int i = 0; i < 100; i++)
+        {
+            EXPECT_TRUE(map.insert(std::to_string(i), i));
+        }
+        map.erase("7");
+        EXPECT_FALSE(map.contains("7"));
+        ASSERT_NE(map.find("42"), nullptr);
+        EXPECT_EQ(*map.find("42"), 42);
+        EXPECT_EQ(map.size(), 99u);
+
+        lldk::base::IAllocator::AllocateStats stats;
+        uint32_t uThreadCount = 1;
+        ASSERT_EQ(pAllocator->getAllocateStats(&stats, &uThreadCount), 0);
+        EXPECT_GE(stats.uAllocatedCount, 100u);
+    }
+
+    lldk::base::IAllocator::AllocateStats stats;
+    uint32_t uThreadCount = 1;
+    ASSERT_EQ(pAllocator->getAllocateStats(&stats, &uThreadCount), 0);
+    EXPECT_EQ(stats.uAllocatedCount, stats.uFreedCount);
+    EXPECT_EQ(stats.uAllocatedSize, stats.uFreedSize);
+    lldkDestroyAllocator(pAllocator);
+}
+
+// 测试默认的节点从分配器单例分配
+TEST(LldkUnorderedMap, DefaultAllocator)
+{
+    using Map = LldkUnorderedMap<int, int, std::hash<int>>;
+    static_assert(std::is_same<Map::MapType::allocator_type,
+                               lldk::base::LldkStlAllocator<std::pair<const int, int>>>::value,
+                  "the nodes should come from the allocator singleton by default");
+
+    auto pAllocator = lldkGetAllocatorSingleton();
+    ASSERT_NE(pAllocator, nullptr);
+    lldk::base::IAllocator::AllocateStats before;
+    uint32_t uThreadCount = 1;
+    ASSERT_EQ(pAllocator->getAllocateStats(&before, &uThreadCount), 0);
+
+    Map map;
+    for (int i = 0; i < 100; i++)
+    {
+        EXPECT_TRUE(map.insert(i, i));
+    }
+
+    lldk::base::IAllocator::AllocateStats after;
+    uThreadCount = 1;
+    ASSERT_EQ(pAllocator->getAllocateStats(&after, &uThreadCount), 0);
+    EXPECT_GE(after.uAllocatedCount - before.uAllocatedCount, 100u);
+}